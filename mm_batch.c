@@ -0,0 +1,160 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_batch.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Batch programming of many slots with overlapped cycles.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mm_eeprom.h"
+#include "mm_verify.h"
+#include "mm_xfer.h"
+#include "mm_batch.h"
+
+/******************************* mm_batch_init *****************************/
+/**   Set up a batch without per-unit fields.
+ *---------------------------------------------------------------------------
+ *  \param b			\OUT batch
+ *  \param image		\IN template, must stay valid
+ *  \param nwords		\IN template size
+ *  \param flags		\IN MM_PROG_AUTOERASE
+ ****************************************************************************/
+void mm_batch_init( MM_BATCH *b, const uint16_t *image, int nwords,
+					uint32_t flags )
+{
+	memset( b, 0, sizeof(*b) );
+	b->image      = image;
+	b->nwords     = nwords;
+	b->flags      = flags;
+	b->serialWord = -1;
+	b->chksum     = nwords > MM_EE_CHKSUM &&
+		mm_verify_crc( image ) == image[MM_EE_CHKSUM];
+}
+
+/******************************* mm_batch_unit *****************************/
+/**   Build the image of one unit.
+ *---------------------------------------------------------------------------
+ *  \param b			\IN batch
+ *  \param unit			\IN unit number (0=first programmed slot)
+ *  \param img			\OUT image, b->nwords words
+ *  \param serial		\OUT serial number of the unit (0 without)
+ *  \return 0=ok, 1=no serial number left or image too short
+ ****************************************************************************/
+int mm_batch_unit( const MM_BATCH *b, int unit, uint16_t *img,
+				   uint32_t *serial )
+{
+	memcpy( img, b->image, b->nwords * sizeof(uint16_t) );
+	*serial = 0;
+
+	if( b->serialWord >= 0 ){
+		if( b->serialWord + 1 >= b->nwords )
+			return 1;
+		if( b->serialList ){
+			if( unit >= b->nserial )
+				return 1;
+			*serial = b->serialList[unit];
+		}
+		else
+			*serial = b->serial + (uint32_t)unit;
+		img[b->serialWord]     = (uint16_t)(*serial >> 16);
+		img[b->serialWord + 1] = (uint16_t)*serial;
+	}
+
+	if( b->chksum )
+		img[MM_EE_CHKSUM] = mm_verify_crc( img );
+	return 0;
+}
+
+/******************************* mm_batch_run ******************************/
+/**   Program all mapped slots, overlapping their erase/write cycles.
+ *
+ *    The units are numbered in slot order. Every slot is verified by its
+ *    transaction; the result is stored in MM_SCAN_SLOT.progErr, .progRep
+ *    and .serial (slots with .programmed set). Nothing is programmed if
+ *    a unit image can't be built. The number of slots is not limited,
+ *    all transactions hold their slot lock at the same time.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param b			\IN batch
+ *  \return number of failed slots, -1=error (errno: EINVAL=not enough
+ *          serial numbers or image too short, ENOMEM)
+ ****************************************************************************/
+int mm_batch_run( MM_SCAN *scan, const MM_BATCH *b )
+{
+	uint16_t img[MM_EE_WORDS];
+	MM_XFER *xfer, **xp;
+	MM_SCAN_SLOT *slot;
+	int i, n, failed;
+
+	if( b->nwords < 1 || b->nwords > MM_EE_WORDS ){
+		errno = EINVAL;
+		return -1;
+	}
+	for( i=0, n=0; i<scan->nslots; i++ )
+		if( scan->slot[i].mapped &&
+			mm_batch_unit( b, n++, img, &scan->slot[i].serial ) ){
+			errno = EINVAL;
+			return -1;
+		}
+
+	xfer = calloc( n ? n : 1, sizeof(*xfer) );
+	xp   = calloc( n ? n : 1, sizeof(*xp) );
+	if( !xfer || !xp ){
+		free( xfer );
+		free( xp );
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for( i=0, n=0; i<scan->nslots; i++ ){
+		slot = &scan->slot[i];
+		if( !slot->mapped )
+			continue;
+		mm_batch_unit( b, n, img, &slot->serial );
+		mm_xfer_program( &xfer[n], slot->base, 0, img, b->nwords, b->flags );
+		mm_xfer_set_timing( &xfer[n], &slot->timing, 0 );
+		xp[n] = &xfer[n];
+		n++;
+	}
+
+	failed = mm_xfer_run( xp, n );
+
+	for( i=0, n=0; i<scan->nslots; i++ ){
+		slot = &scan->slot[i];
+		if( !slot->mapped )
+			continue;
+		slot->programmed = 1;
+		slot->progErr    = xfer[n].err;
+		slot->progRep    = xfer[n].rep;
+		slot->stats.progNs += xfer[n].rep.totalNs;
+		mm_query_init( &slot->query );		/* words have changed */
+		n++;
+	}
+
+	free( xfer );
+	free( xp );
+	return failed;
+}
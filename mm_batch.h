@@ -0,0 +1,63 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_batch.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Batch programming of many slots with overlapped cycles.
+ *
+ *               Every mapped slot of a scan list gets its own copy of an
+ *               image template, with per-unit fields (serial number)
+ *               filled in. All slots are programmed from one thread with
+ *               non-blocking transactions (see mm_xfer.h): while the
+ *               EEPROM of one slot runs its erase/write cycle the others
+ *               are served, so N slots take about as long as the one
+ *               with the most words to change.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_BATCH_H
+#define _MM_BATCH_H
+
+#include <stdint.h>
+#include "mm_scan.h"
+
+/** image template and per-unit fields */
+typedef struct MM_BATCH {
+	const uint16_t *image;		/**< template */
+	int       nwords;			/**< template size */
+	uint32_t  flags;			/**< MM_PROG_AUTOERASE */
+	int       serialWord;		/**< serial number in words n (high) and
+									 n+1 (low), -1=keep template */
+	uint32_t  serial;			/**< serial of the first unit, counted up */
+	const uint32_t *serialList;	/**< serials by unit instead of counting */
+	int       nserial;			/**< entries of serialList */
+	int       chksum;			/**< keep MM_EE_CHKSUM valid, set by
+									 mm_batch_init() if the template has
+									 a valid checksum */
+} MM_BATCH;
+
+void mm_batch_init( MM_BATCH *b, const uint16_t *image, int nwords,
+					uint32_t flags );
+int mm_batch_unit( const MM_BATCH *b, int unit, uint16_t *img,
+				   uint32_t *serial );
+int mm_batch_run( MM_SCAN *scan, const MM_BATCH *b );
+
+#endif /* _MM_BATCH_H */
@@ -0,0 +1,404 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_bench.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Benchmarks of the identification and programming paths.
+ *
+ *               Runs against the simulated EEPROM by default, with --hw
+ *               against real slots. Every benchmark is repeated and the
+ *               best run is reported, one "<name> <value>" line each
+ *               (or JSON). The text output can be stored as a baseline
+ *               and compared against later (--baseline).
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include "mm_eeprom.h"
+#include "mm_sim.h"
+#include "mm_scan.h"
+#include "mm_timing.h"
+#include "mm_stats.h"
+
+#define BENCH_MAX		64		/* max. number of results */
+#define BENCH_SLOTS		8		/* simulated carriers for scan benchmarks */
+#define BENCH_WORD		63		/* word written by the write benchmark */
+
+/** one result */
+typedef struct {
+	char   name[48];
+	double value;
+} BENCH_RES;
+
+static BENCH_RES G_res[BENCH_MAX];
+static int G_nres;
+static int G_reps = 5;			/* repetitions, best one counts */
+static int G_iter = 200;		/* operations per repetition */
+
+/******************************* usage *************************************/
+/**   Print program usage.
+ ****************************************************************************/
+static void usage( void )
+{
+	printf("--------------------------------------------\n");
+	printf("mm_bench [options]\n");
+	printf("Options:\n");
+	printf("  --hw=<addr>           benchmark real slot <addr> (repeatable,\n");
+	printf("                        the first one for the micro benchmarks)\n");
+	printf("  --hw-write            also run write benchmarks on hardware\n");
+	printf("                        (rewrites word %d with its contents)\n",
+		   BENCH_WORD);
+	printf("  --carriers=<n>        simulated carriers to scan (%d)\n",
+		   BENCH_SLOTS / 2);
+	printf("  --bit-ns=<ns>         half bit period (sim: 0, hw: %d)\n",
+		   MM_HALF_NS_DEFAULT);
+	printf("  --iter=<n>            operations per run (%d)\n", G_iter);
+	printf("  --reps=<n>            runs per benchmark (%d)\n", G_reps);
+	printf("  --json                JSON output\n");
+	printf("  --baseline=<file>     compare with stored text output\n");
+	printf("  --tolerance=<pct>     allowed slowdown (10)\n");
+	printf("--------------------------------------------\n");
+}
+
+/******************************* bench_add *********************************/
+/**   Store a result.
+ *---------------------------------------------------------------------------
+ *  \param name			\IN result name (<bench>.<unit>)
+ *  \param value		\IN value, lower is better
+ ****************************************************************************/
+static void bench_add( const char *name, double value )
+{
+	if( G_nres == BENCH_MAX )
+		return;
+	snprintf( G_res[G_nres].name, sizeof(G_res[0].name), "%s", name );
+	G_res[G_nres++].value = value;
+}
+
+/** operation under test */
+typedef void (*BENCH_FN)( uintptr_t base, void *arg );
+
+/******************************* bench_run *********************************/
+/**   Run an operation G_iter times per repetition, keep the best run.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN slot
+ *  \param fn			\IN operation
+ *  \param arg			\IN argument of fn
+ *  \param iter			\IN operations per run
+ *  \param best			\OUT counters of the best run
+ *  \return duration of the best run (ns)
+ ****************************************************************************/
+static uint64_t bench_run( uintptr_t base, BENCH_FN fn, void *arg, int iter,
+						   MM_STATS *best )
+{
+	MM_STATS st;
+	uint64_t t0, t, min = ~0ULL;
+	int r, i;
+
+	for( r=0; r<G_reps; r++ ){
+		memset( &st, 0, sizeof(st) );
+		mm_stats_set( &st );
+		t0 = mm_time_ns();
+		for( i=0; i<iter; i++ )
+			fn( base, arg );
+		t = mm_time_ns() - t0;
+		mm_stats_set( NULL );
+		if( t < min ){
+			min = t;
+			*best = st;
+		}
+	}
+	return min;
+}
+
+static void op_read_all( uintptr_t base, void *arg )
+{
+	m_read_range( base, 0, MM_EE_WORDS, (uint16_t *)arg );
+}
+
+static void op_read( uintptr_t base, void *arg )
+{
+	(void)arg;
+	(void)m_read( base, 1 );
+}
+
+static void op_mread( uintptr_t base, void *arg )
+{
+	m_mread( (uint8_t *)base, (uint16_t *)arg );
+}
+
+static void op_getmodinfo( uintptr_t base, void *arg )
+{
+	uint32_t modtype, devid, devrev;
+	char devname[MM_DEVNAME_LEN];
+
+	(void)arg;
+	m_getmodinfo( base, &modtype, &devid, &devrev, devname );
+}
+
+static void op_write( uintptr_t base, void *arg )
+{
+	m_write( (uint8_t *)base, BENCH_WORD, *(uint16_t *)arg );
+}
+
+/******************************* bench_micro *******************************/
+/**   Benchmarks of the single slot access functions.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN slot
+ *  \param write		\IN run write benchmarks
+ ****************************************************************************/
+static void bench_micro( uintptr_t base, int write )
+{
+	uint16_t buf[MM_EE_WORDS], w;
+	MM_STATS st;
+	uint64_t ns;
+	int iter;
+
+	/* sequential read of the whole EEPROM: bit and word costs */
+	iter = G_iter / 10 ? G_iter / 10 : 1;
+	ns = bench_run( base, op_read_all, buf, iter, &st );
+	bench_add( "clock.ns_per_bit", (double)ns / st.clocks );
+	bench_add( "read_seq.us_per_word", (double)ns / st.words / 1000 );
+	bench_add( "read_seq.mmio_per_word",
+			   (double)(st.reads + st.writes) / st.words );
+
+	ns = bench_run( base, op_read, NULL, G_iter, &st );
+	bench_add( "m_read.us_per_word", (double)ns / st.words / 1000 );
+	bench_add( "m_read.mmio_per_word",
+			   (double)(st.reads + st.writes) / st.words );
+
+	ns = bench_run( base, op_mread, buf, iter, &st );
+	bench_add( "m_mread.us_per_image", (double)ns / iter / 1000 );
+	bench_add( "m_mread.us_per_word", (double)ns / st.words / 1000 );
+
+	ns = bench_run( base, op_getmodinfo, NULL, G_iter, &st );
+	bench_add( "m_getmodinfo.us_per_call", (double)ns / G_iter / 1000 );
+	bench_add( "m_getmodinfo.mmio_per_call",
+			   (double)(st.reads + st.writes) / G_iter );
+
+	if( write ){
+		w = (uint16_t)m_read( base, BENCH_WORD );
+		iter = G_iter / 20 ? G_iter / 20 : 1;
+		ns = bench_run( base, op_write, &w, iter, &st );
+		bench_add( "m_write.us_per_word", (double)ns / iter / 1000 );
+		bench_add( "m_write.mmio_per_word",
+				   (double)(st.reads + st.writes) / iter );
+	}
+}
+
+/******************************* bench_scan ********************************/
+/**   Whole carrier scans with the different scan strategies.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN mapped slots
+ ****************************************************************************/
+static void bench_scan( MM_SCAN *scan )
+{
+	static const char *name[] = { "scan_seq", "scan_parallel",
+								  "scan_lockstep" };
+	char key[48];
+	uint64_t t0, t, min;
+	int mode, r, i, n = 0;
+
+	for( i=0; i<scan->nslots; i++ )
+		if( scan->slot[i].mapped )
+			n++;
+	if( !n )
+		return;
+
+	for( mode=0; mode<3; mode++ ){
+		for( min=~0ULL, r=0; r<G_reps; r++ ){
+			for( i=0; i<scan->nslots; i++ )
+				scan->slot[i].done = 0;
+			t0 = mm_time_ns();
+			if( mode == 0 )
+				mm_scan_run( scan );
+			else if( mode == 1 )
+				mm_scan_run_parallel( scan, scan->nslots, 2 );
+			else
+				mm_scan_run_lockstep( scan );
+			t = mm_time_ns() - t0;
+			if( t < min )
+				min = t;
+		}
+		snprintf( key, sizeof(key), "%s.ms_per_slot", name[mode] );
+		bench_add( key, (double)min / n / 1e6 );
+	}
+}
+
+/******************************* bench_compare *****************************/
+/**   Compare the results with a baseline file.
+ *---------------------------------------------------------------------------
+ *  \param path			\IN baseline (text output of mm_bench)
+ *  \param tol			\IN allowed slowdown in percent
+ *  \return number of regressions, -1 if the file can't be read
+ ****************************************************************************/
+static int bench_compare( const char *path, double tol )
+{
+	char line[128], name[48];
+	double base;
+	FILE *fp;
+	int i, bad = 0;
+
+	if( !(fp = fopen( path, "r" )) )
+		return -1;
+
+	printf("# compared with %s (tolerance %.0f%%)\n", path, tol);
+	while( fgets( line, sizeof(line), fp ) ){
+		if( line[0] == '#' || sscanf( line, "%47s %lf", name, &base ) != 2 )
+			continue;
+		for( i=0; i<G_nres && strcmp( G_res[i].name, name ); i++ )
+			;
+		if( i == G_nres || base <= 0 )
+			continue;
+		if( G_res[i].value > base * (1 + tol / 100) ){
+			printf("REGRESSION %s %.4g (baseline %.4g, %+.1f%%)\n", name,
+				   G_res[i].value, base, (G_res[i].value / base - 1) * 100);
+			bad++;
+		}
+	}
+	fclose( fp );
+	return bad;
+}
+
+/******************************* main **************************************/
+/**   Program main function.
+ ****************************************************************************/
+int main( int argc, char **argv )
+{
+	static const struct option longopts[] = {
+		{ "hw",			required_argument,	NULL, 'H' },
+		{ "hw-write",	no_argument,		NULL, 'W' },
+		{ "carriers",	required_argument,	NULL, 'c' },
+		{ "bit-ns",		required_argument,	NULL, 'B' },
+		{ "iter",		required_argument,	NULL, 'i' },
+		{ "reps",		required_argument,	NULL, 'r' },
+		{ "json",		no_argument,		NULL, 'J' },
+		{ "baseline",	required_argument,	NULL, 'b' },
+		{ "tolerance",	required_argument,	NULL, 't' },
+		{ "help",		no_argument,		NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	uint16_t image[MM_EE_WORDS] = { MOD_ID_MAGIC, 0x0048 };	/* M72 */
+	MM_SIM_DEV *simDev[2 * BENCH_SLOTS];
+	MM_TIMING timing = { 0, 1, MM_ACCESS_F204 };
+	MM_SCAN scan;
+	const char *baseline = NULL;
+	double tol = 10;
+	int opt, i, hw = 0, hwWrite = 0, carriers = BENCH_SLOTS / 2;
+	int json = 0, bitNs = -1, nsim = 0, bad = 0;
+
+	mm_timing_calibrate();
+	mm_scan_init( &scan );
+	while( (opt = getopt_long( argc, argv, "h", longopts, NULL )) != -1 ){
+		switch( opt ){
+		case 'H':
+			if( mm_scan_add( &scan, strtoull( optarg, NULL, 16 ) ) )
+				return 1;
+			hw = 1;
+			break;
+		case 'W':
+			hwWrite = 1;
+			break;
+		case 'c':
+			carriers = atoi( optarg );
+			if( carriers < 1 || carriers > BENCH_SLOTS )
+				carriers = BENCH_SLOTS;
+			break;
+		case 'B':
+			bitNs = atoi( optarg );
+			break;
+		case 'i':
+			G_iter = atoi( optarg ) > 0 ? atoi( optarg ) : 1;
+			break;
+		case 'r':
+			G_reps = atoi( optarg ) > 0 ? atoi( optarg ) : 1;
+			break;
+		case 'J':
+			json = 1;
+			break;
+		case 'b':
+			baseline = optarg;
+			break;
+		case 't':
+			tol = atof( optarg );
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	/* the simulation has no timing limits: measure the software path */
+	timing.halfNs = bitNs >= 0 ? (uint32_t)bitNs :
+		(hw ? MM_HALF_NS_DEFAULT : 0);
+	mm_timing_set_default( &timing );
+
+	if( !hw ){
+		for( i=0; i<carriers; i++ ){
+			mm_scan_add_carrier( &scan, 0x10000000 + i * 0x1000 );
+		}
+		for( i=0; i<scan.nslots; i++ ){
+			if( !(simDev[nsim] = mm_sim_create( image, MM_EE_WORDS )) ||
+				mm_sim_attach( simDev[nsim], scan.slot[i].phys ) )
+				return 1;
+			mm_sim_set_busy( simDev[nsim++], 0 );
+		}
+		mm_bus_set( &MM_BusSim );
+	}
+	for( i=0; i<scan.nslots; i++ )
+		scan.slot[i].timing = timing;
+
+	if( mm_scan_map( &scan, !hw ) == 0 || !scan.slot[0].mapped ){
+		printf("Can't map slot 0x%llx\n", (unsigned long long)scan.slot[0].phys);
+		return 1;
+	}
+
+	bench_micro( scan.slot[0].base, !hw || hwWrite );
+	bench_scan( &scan );
+
+	if( json ){
+		printf("{ \"bus\": \"%s\", \"bit_ns\": %u, \"slots\": %d",
+			   mm_bus_get()->name, timing.halfNs, scan.nslots);
+		for( i=0; i<G_nres; i++ )
+			printf(",\n  \"%s\": %.4g", G_res[i].name, G_res[i].value);
+		printf(" }\n");
+	}
+	else {
+		printf("# mm_bench bus=%s bit_ns=%u slots=%d\n",
+			   mm_bus_get()->name, timing.halfNs, scan.nslots);
+		for( i=0; i<G_nres; i++ )
+			printf("%s %.4g\n", G_res[i].name, G_res[i].value);
+	}
+
+	if( baseline && (bad = bench_compare( baseline, tol )) < 0 ){
+		printf("Can't read baseline %s\n", baseline);
+		bad = 1;
+	}
+
+	mm_scan_exit( &scan );
+	for( i=0; i<nsim; i++ )
+		mm_sim_destroy( simDev[i] );
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_cache.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Persistent cache of M-Module identification results.
+ *
+ *               The cache is a text file with one line per slot:
+ *
+ *               <phys> <modtype> <devid> <devrev> <w0> <w1> <w2> <w8> <fp> [<name>]
+ *
+ *               All numbers are hex, <fp> is a fingerprint of the raw
+ *               words so damaged lines are dropped on load. The file is
+ *               replaced atomically (write temp file, rename).
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mm_cache.h"
+
+#define CACHE_HEADER	"# mm_ident cache v1"
+
+/******************************* mm_cache_fp *******************************/
+/**   Fingerprint (FNV-1a) of the raw id words.
+ *---------------------------------------------------------------------------
+ *  \param words		\IN words 0, 1, 2, 8
+ *  \return fingerprint
+ ****************************************************************************/
+uint32_t mm_cache_fp( const uint16_t *words )
+{
+	uint32_t h = 2166136261u;
+	int i;
+
+	for( i=0; i<4; i++ ){
+		h = (h ^ (words[i] >> 8)) * 16777619u;
+		h = (h ^ (words[i] & 0xff)) * 16777619u;
+	}
+	return h;
+}
+
+/******************************* mm_cache_load *****************************/
+/**   Load the cache file.
+ *
+ *    A missing file gives an empty cache.
+ *---------------------------------------------------------------------------
+ *  \param cache		\OUT cache
+ *  \param path			\IN cache file (NULL=MM_CACHE_FILE)
+ *  \return 0=ok, -1=out of memory
+ ****************************************************************************/
+int mm_cache_load( MM_CACHE *cache, const char *path )
+{
+	char line[256];
+	unsigned long long phys;
+	unsigned int v[9];
+	MM_CACHE_ENT ent;
+	FILE *fp;
+	int n, pos;
+
+	memset( cache, 0, sizeof(*cache) );
+	if( !(cache->path = strdup( path ? path : MM_CACHE_FILE )) )
+		return -1;
+
+	if( !(fp = fopen( cache->path, "r" )) )
+		return 0;
+
+	while( fgets( line, sizeof(line), fp ) ){
+		if( line[0] == '#' )
+			continue;
+		pos = 0;
+		n = sscanf( line, "%llx %x %x %x %x %x %x %x %x %n",
+					&phys, &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7],
+					&v[8], &pos );
+		if( n != 9 )
+			continue;
+
+		memset( &ent, 0, sizeof(ent) );
+		ent.phys     = phys;
+		ent.modtype  = v[1];
+		ent.devid    = v[2];
+		ent.devrev   = v[3];
+		ent.words[0] = (uint16_t)v[4];
+		ent.words[1] = (uint16_t)v[5];
+		ent.words[2] = (uint16_t)v[6];
+		ent.words[3] = (uint16_t)v[7];
+		ent.fp       = v[8];
+		if( ent.fp != mm_cache_fp( ent.words ) )
+			continue;				/* damaged */
+
+		sscanf( line + pos, "%24s", ent.devname );
+		if( mm_cache_put( cache, &ent ) ){
+			fclose( fp );
+			return -1;
+		}
+	}
+	fclose( fp );
+	cache->dirty = 0;
+	return 0;
+}
+
+/******************************* mm_cache_find *****************************/
+/**   Look up a slot.
+ *---------------------------------------------------------------------------
+ *  \param cache		\IN cache
+ *  \param phys			\IN slot address
+ *  \return entry or NULL
+ ****************************************************************************/
+MM_CACHE_ENT *mm_cache_find( MM_CACHE *cache, uint64_t phys )
+{
+	int i;
+
+	for( i=0; i<cache->n; i++ )
+		if( cache->ent[i].phys == phys )
+			return &cache->ent[i];
+	return NULL;
+}
+
+/******************************* mm_cache_put ******************************/
+/**   Add or replace the entry of a slot.
+ *---------------------------------------------------------------------------
+ *  \param cache		\IN cache
+ *  \param ent			\IN entry (fp is computed)
+ *  \return 0=ok, -1=out of memory
+ ****************************************************************************/
+int mm_cache_put( MM_CACHE *cache, const MM_CACHE_ENT *ent )
+{
+	MM_CACHE_ENT *e = mm_cache_find( cache, ent->phys );
+
+	if( !e ){
+		if( cache->n == cache->max ){
+			int max = cache->max ? 2 * cache->max : 16;
+
+			if( !(e = realloc( cache->ent, max * sizeof(*e) )) )
+				return -1;
+			cache->ent = e;
+			cache->max = max;
+		}
+		e = &cache->ent[cache->n++];
+	}
+	else if( !memcmp( e->words, ent->words, sizeof(e->words) ) &&
+			 !strcmp( e->devname, ent->devname ) &&
+			 e->modtype == ent->modtype )
+		return 0;					/* unchanged */
+
+	*e = *ent;
+	e->devname[MM_CACHE_NAME_LEN-1] = '\0';
+	e->fp = mm_cache_fp( e->words );
+	cache->dirty = 1;
+	return 0;
+}
+
+/******************************* mm_cache_save *****************************/
+/**   Write the cache file if it changed.
+ *
+ *    The directory of the file is created if necessary.
+ *---------------------------------------------------------------------------
+ *  \param cache		\IN cache
+ *  \return 0=ok, -1=error
+ ****************************************************************************/
+int mm_cache_save( MM_CACHE *cache )
+{
+	char tmp[512], *p;
+	MM_CACHE_ENT *e;
+	FILE *fp;
+	int i, err;
+
+	if( !cache->dirty )
+		return 0;
+
+	/* create directory */
+	snprintf( tmp, sizeof(tmp), "%s", cache->path );
+	if( (p = strrchr( tmp, '/' )) && p != tmp ){
+		*p = '\0';
+		mkdir( tmp, 0755 );
+	}
+
+	snprintf( tmp, sizeof(tmp), "%s.%d", cache->path, (int)getpid() );
+	if( !(fp = fopen( tmp, "w" )) )
+		return -1;
+
+	fprintf( fp, "%s\n", CACHE_HEADER );
+	for( i=0; i<cache->n; i++ ){
+		e = &cache->ent[i];
+		fprintf( fp, "%08llx %x %08x %08x %04x %04x %04x %04x %08x %s\n",
+				 (unsigned long long)e->phys, e->modtype, e->devid, e->devrev,
+				 e->words[0], e->words[1], e->words[2], e->words[3],
+				 e->fp, e->devname );
+	}
+
+	err = ferror( fp );
+	if( fclose( fp ) || err || rename( tmp, cache->path ) ){
+		unlink( tmp );
+		return -1;
+	}
+	cache->dirty = 0;
+	return 0;
+}
+
+/******************************* mm_cache_exit *****************************/
+/**   Free the cache (does not save it).
+ *---------------------------------------------------------------------------
+ *  \param cache		\IN cache
+ ****************************************************************************/
+void mm_cache_exit( MM_CACHE *cache )
+{
+	free( cache->ent );
+	free( cache->path );
+	memset( cache, 0, sizeof(*cache) );
+}
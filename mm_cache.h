@@ -0,0 +1,64 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_cache.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Persistent cache of M-Module identification results.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_CACHE_H
+#define _MM_CACHE_H
+
+#include <stdint.h>
+
+#define MM_CACHE_FILE		"/run/mm_ident/cache"	/* default cache file */
+#define MM_CACHE_CHECK_WORD	1		/* word compared by the fast check */
+#define MM_CACHE_NAME_LEN	25
+
+/** cached result of one slot */
+typedef struct MM_CACHE_ENT {
+	uint64_t phys;				/**< slot address (carrier BAR + offset) */
+	uint32_t modtype;			/**< m_getmodinfo() results */
+	uint32_t devid;
+	uint32_t devrev;
+	char     devname[MM_CACHE_NAME_LEN];
+	uint16_t words[4];			/**< raw words 0, 1, 2, 8 */
+	uint32_t fp;				/**< fingerprint of words */
+} MM_CACHE_ENT;
+
+/** cache contents */
+typedef struct MM_CACHE {
+	char         *path;			/**< cache file */
+	MM_CACHE_ENT *ent;
+	int           n;
+	int           max;
+	int           dirty;		/**< changed since loaded */
+} MM_CACHE;
+
+uint32_t mm_cache_fp( const uint16_t *words );
+int mm_cache_load( MM_CACHE *cache, const char *path );
+MM_CACHE_ENT *mm_cache_find( MM_CACHE *cache, uint64_t phys );
+int mm_cache_put( MM_CACHE *cache, const MM_CACHE_ENT *ent );
+int mm_cache_save( MM_CACHE *cache );
+void mm_cache_exit( MM_CACHE *cache );
+
+#endif /* _MM_CACHE_H */
@@ -0,0 +1,124 @@
+#!/bin/sh
+#
+# Regression check of mm_ident against the simulated EEPROM.
+#
+# Runs mm_ident --sim with the fault injection options and compares the
+# output with mm_check.exp. Durations and the temporary directory are
+# replaced by 'N' and 'TMP' first.
+#
+#   mm_check.sh [<mm_ident>]        check (default ./mm_ident)
+#   mm_check.sh -u [<mm_ident>]     write the output to mm_check.exp
+#
+# Copyright 2014-2020, MEN Mikro Elektronik GmbH
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+#
+
+update=0
+if [ "$1" = "-u" ]; then
+	update=1
+	shift
+fi
+IDENT=${1:-./mm_ident}
+EXP=$(dirname "$0")/mm_check.exp
+
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+# 16 word image, M72 with CRC-16 in word 15
+printf '%s\n' 5346 0048 0000 0000 0000 0000 0000 0000 \
+	0000 0000 0000 0000 0000 0000 0000 a94a > "$TMP/m72.img"
+
+run() {
+	echo "### mm_ident $*"
+	"$IDENT" "$@" 2>&1
+	echo "### exit $?"
+}
+
+# mm_ident with a CSV report
+run_report() {
+	run "$@" --report="$TMP/report.csv"
+	cat "$TMP/report.csv"
+}
+
+# drop the result of --verify, the errors depend on the timing
+no_cnt() {
+	sed -e '/^Verify: /d' -e 's/, Verify: .*//'
+}
+
+# module type and name of the first inventory record
+inv_rec() {
+	echo "modtype $(od -An -tu4 -j80 -N4 "$1" | tr -d ' ')," \
+		"name $(dd if="$1" bs=1 skip=108 count=32 2>/dev/null | tr -d '\000')"
+}
+
+A=c0400200
+B=c0400600
+
+# 20 carriers with 2 slots, more than a thread can lock with mm_lock_try()
+MANY=
+for c in 10 11 12 13 14 15 16 17 18 19 20 21 22 23 24 25 26 27 28 29; do
+	MANY="$MANY c0${c}0200 c0${c}0600"
+done
+
+# 64 words, all differ from M72
+i=0
+while [ $i -lt 64 ]; do
+	printf '%04x\n' $((0x1000 + i))
+	i=$((i + 1))
+done > "$TMP/w64.img"
+
+{
+	# identification and read faults
+	run --sim $A
+	run --sim --sim-fault=stuck0 $A
+	run --sim --sim-fault=stuck1 $A
+	run --sim --sim-fault=nodummy $A
+	run --sim --sim-fault=flip=1:0x10 $A
+	run --sim --sim-fault=flip=1:0x10:1 --verify $A
+	run --sim --sim-fault=flip=1:0x10 --verify $A
+	run --sim="$TMP/m72.img" --verify $A
+	run --sim="$TMP/m72.img" --sim-fault=flip=1:0x10:1 --verify $A
+	run --sim --sim-tpd=2000 $A
+	run --sim --sim-tpd=2000 --bit-ns=2500 $A
+
+	# --verify reads fast only where errors are detected: at a DO delay
+	# above its period queries, programming and daemon probes still work
+	run --sim --sim-tpd=400 --verify $A | no_cnt
+	run --sim --sim-tpd=400 --verify --query=type,modid $A
+	run_report --sim --sim-tpd=400 --verify --program="$TMP/m72.img" \
+		$A $B | no_cnt
+	echo "### mm_ident --sim --sim-tpd=400 --verify --daemon $A"
+	"$IDENT" --sim --sim-tpd=400 --verify --daemon="$TMP/sock" \
+		--inventory="$TMP/inv" --interval=20 --full-every=2 $A >/dev/null &
+	sleep 1
+	inv_rec "$TMP/inv"
+	kill $!
+	wait $!
+	echo "### exit $?"
+
+	# programming, the image differs from M72 in the checksum word
+	run_report --sim --program="$TMP/m72.img" $A $B
+	run_report --sim --program="$TMP/m72.img" --serial=100 $A $B
+	run_report --sim --program="$TMP/m72.img" --sim-fault=nowrite $A $B
+	run_report --sim --program="$TMP/m72.img" --sim-fault=busystuck $A $B
+
+	# all slots at a time, each one takes longer than the lock timeout
+	# (and the default one)
+	run --sim --program="$TMP/w64.img" --sim-busy=8000 --lock-timeout=100 \
+		$MANY
+} | sed -e "s|$TMP/|TMP/|g" -e 's/[0-9][0-9]* us/N us/g' \
+	-e 's/,[0-9][0-9]*$/,N/' > "$TMP/out"
+
+if [ $update = 1 ]; then
+	cp "$TMP/out" "$EXP"
+	exit 0
+fi
+if ! diff -u "$EXP" "$TMP/out"; then
+	echo "mm_check: FAILED"
+	exit 1
+fi
+echo "mm_check: ok"
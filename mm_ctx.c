@@ -0,0 +1,368 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_ctx.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief libmmident: per-slot context API.
+ *
+ *               A context maps the page(s) of one slot with a pointer
+ *               sized address, so slots above 4 GB work. Every call runs
+ *               with the context's timing and statistics and restores
+ *               those of the calling thread afterwards.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mm_ctx.h"
+#include "mm_lock.h"
+
+/** slot context */
+struct MM_CTX {
+	uintptr_t  base;			/* address passed to m_read() & co. */
+	void      *map;				/* own mapping or NULL */
+	size_t     mapLen;
+	MM_TIMING  timing;
+	MM_STATS  *stats;			/* NULL=don't count */
+	MM_QUERY   query;			/* words read by mm_ctx_query() */
+};
+
+/** timing/statistics of the calling thread while a context is in use */
+typedef struct {
+	const MM_TIMING *timing;
+	MM_STATS        *stats;
+} CTX_SAVE;
+
+static pthread_once_t G_calOnce = PTHREAD_ONCE_INIT;
+
+/******************************* _ctx_new **********************************/
+/**   Allocate a context with the default timing.
+ *---------------------------------------------------------------------------
+ *  \return context or NULL (errno set)
+ ****************************************************************************/
+static MM_CTX *_ctx_new( void )
+{
+	MM_CTX *ctx;
+
+	pthread_once( &G_calOnce, mm_timing_calibrate );
+	if( !(ctx = calloc( 1, sizeof(*ctx) )) )
+		return NULL;
+	ctx->timing = *mm_timing_get();
+	return ctx;
+}
+
+/******************************* _ctx_map **********************************/
+/**   Map the slot at 'offset' of a file (/dev/mem or resource file).
+ *---------------------------------------------------------------------------
+ *  \param ctxP			\OUT new context
+ *  \param path			\IN file to map
+ *  \param offset		\IN slot offset in file
+ *  \return 0=ok, -1=error (errno set)
+ ****************************************************************************/
+static int _ctx_map( MM_CTX **ctxP, const char *path, uint64_t offset )
+{
+	uint64_t pagesize = (uint64_t)getpagesize();
+	uint64_t pageoff = offset & ~(pagesize-1);
+	MM_CTX *ctx;
+	void *vmem;
+	int fd, e;
+
+	*ctxP = NULL;
+	if( !(ctx = _ctx_new()) )
+		return -1;
+
+	ctx->mapLen = (size_t)(((offset - pageoff) + MODREG + 4 + pagesize - 1) &
+						   ~(pagesize-1));
+	if( (fd = open( path, O_RDWR|O_SYNC )) < 0 )
+		goto ERR;
+	vmem = mmap( 0, ctx->mapLen, PROT_READ|PROT_WRITE, MAP_SHARED, fd,
+				 (off_t)pageoff );
+	e = errno;
+	close( fd );
+	errno = e;
+	if( vmem == MAP_FAILED )
+		goto ERR;
+
+	ctx->map  = vmem;
+	ctx->base = (uintptr_t)vmem + (uintptr_t)(offset - pageoff);
+	*ctxP = ctx;
+	return 0;
+
+ERR:
+	e = errno;
+	free( ctx );
+	errno = e;
+	return -1;
+}
+
+/******************************* mm_ctx_open *******************************/
+/**   Open a slot by physical address (mapped through /dev/mem).
+ *
+ *    If locking is enabled (mm_lock_init()), the slot is attached to its
+ *    lock. Slots opened otherwise can be attached with mm_lock_attach().
+ *---------------------------------------------------------------------------
+ *  \param ctxP			\OUT new context
+ *  \param phys			\IN physical slot address (BAR + slot offset)
+ *  \return 0=ok, -1=error (errno set)
+ ****************************************************************************/
+int mm_ctx_open( MM_CTX **ctxP, uint64_t phys )
+{
+	if( _ctx_map( ctxP, "/dev/mem", phys ) )
+		return -1;
+	mm_lock_attach( (*ctxP)->base, phys );
+	return 0;
+}
+
+/******************************* mm_ctx_open_res ***************************/
+/**   Open a slot through a sysfs PCI resource file.
+ *
+ *    Works with kernel lockdown, where /dev/mem is not accessible.
+ *---------------------------------------------------------------------------
+ *  \param ctxP			\OUT new context
+ *  \param res			\IN resource file of the carrier BAR
+ *  \param offset		\IN slot offset in BAR (e.g. MM_F204_SLOT0)
+ *  \return 0=ok, -1=error (errno set)
+ ****************************************************************************/
+int mm_ctx_open_res( MM_CTX **ctxP, const char *res, uint64_t offset )
+{
+	return _ctx_map( ctxP, res, offset );
+}
+
+/******************************* mm_ctx_open_base **************************/
+/**   Open a slot at an address that is already accessible.
+ *
+ *    For slots mapped by the caller or the simulation backend
+ *    (base = address the device is attached at).
+ *---------------------------------------------------------------------------
+ *  \param ctxP			\OUT new context
+ *  \param base			\IN address passed to the bus backend
+ *  \return 0=ok, -1=error (errno set)
+ ****************************************************************************/
+int mm_ctx_open_base( MM_CTX **ctxP, uintptr_t base )
+{
+	if( !(*ctxP = _ctx_new()) )
+		return -1;
+	(*ctxP)->base = base;
+	return 0;
+}
+
+/******************************* mm_ctx_close ******************************/
+/**   Unmap the slot and free the context.
+ *---------------------------------------------------------------------------
+ *  \param ctx			\IN context (NULL is ignored)
+ ****************************************************************************/
+void mm_ctx_close( MM_CTX *ctx )
+{
+	if( !ctx )
+		return;
+	mm_lock_detach( ctx->base );
+	if( ctx->map )
+		munmap( ctx->map, ctx->mapLen );
+	free( ctx );
+}
+
+/******************************* mm_ctx_base *******************************/
+/**   Get the address to use with m_read() & co.
+ *---------------------------------------------------------------------------
+ *  \param ctx			\IN context
+ *  \return base address
+ ****************************************************************************/
+uintptr_t mm_ctx_base( const MM_CTX *ctx )
+{
+	return ctx->base;
+}
+
+/******************************* mm_ctx_set_timing *************************/
+/**   Set the bit timing of a slot.
+ *---------------------------------------------------------------------------
+ *  \param ctx			\IN context
+ *  \param tm			\IN timing
+ ****************************************************************************/
+void mm_ctx_set_timing( MM_CTX *ctx, const MM_TIMING *tm )
+{
+	ctx->timing = *tm;
+}
+
+/******************************* mm_ctx_get_timing *************************/
+/**   Get the bit timing of a slot.
+ *---------------------------------------------------------------------------
+ *  \param ctx			\IN context
+ *  \param tm			\OUT timing
+ ****************************************************************************/
+void mm_ctx_get_timing( const MM_CTX *ctx, MM_TIMING *tm )
+{
+	*tm = ctx->timing;
+}
+
+/******************************* mm_ctx_set_stats **************************/
+/**   Count the accesses to a slot.
+ *---------------------------------------------------------------------------
+ *  \param ctx			\IN context
+ *  \param st			\IN statistics (must stay valid), NULL=off
+ ****************************************************************************/
+void mm_ctx_set_stats( MM_CTX *ctx, MM_STATS *st )
+{
+	ctx->stats = st;
+}
+
+/******************************* _ctx_enter ********************************/
+/**   Let the calling thread use the timing and statistics of a context.
+ *---------------------------------------------------------------------------
+ *  \param ctx			\IN context
+ *  \param save			\OUT settings of the thread
+ ****************************************************************************/
+static void _ctx_enter( MM_CTX *ctx, CTX_SAVE *save )
+{
+	save->timing = mm_timing_get();
+	save->stats  = mm_stats_get();
+	mm_timing_set( &ctx->timing );
+	mm_stats_set( ctx->stats );
+}
+
+/******************************* _ctx_leave ********************************/
+/**   Restore the timing and statistics of the calling thread.
+ *---------------------------------------------------------------------------
+ *  \param save			\IN settings saved by _ctx_enter()
+ ****************************************************************************/
+static void _ctx_leave( const CTX_SAVE *save )
+{
+	mm_timing_set( save->timing );
+	mm_stats_set( save->stats );
+}
+
+/******************************* mm_ctx_autotune ***************************/
+/**   Find the fastest reliable bit period and use it from now on.
+ *
+ *    See mm_autotune(). The timing is unchanged if tuning fails.
+ *---------------------------------------------------------------------------
+ *  \param ctx			\IN context
+ *  \param tune			\OUT result (may be NULL)
+ *  \return 0=ok, 1=no stable EEPROM contents
+ ****************************************************************************/
+int mm_ctx_autotune( MM_CTX *ctx, MM_TUNE *tune )
+{
+	CTX_SAVE save;
+	MM_TUNE t;
+	int err;
+
+	_ctx_enter( ctx, &save );
+	err = mm_autotune( ctx->base, &ctx->timing, &t );
+	_ctx_leave( &save );
+
+	if( !err )
+		ctx->timing.halfNs = t.halfNs;
+	if( tune )
+		*tune = t;
+	return err;
+}
+
+/******************************* mm_ctx_ident ******************************/
+/**   Identify the module in a slot.
+ *
+ *    See m_getmodinfo() for the meaning of the results.
+ *---------------------------------------------------------------------------
+ *  \param ctx			\IN context
+ *  \param id			\OUT result
+ *  \return 0=ok, 1=error
+ ****************************************************************************/
+int mm_ctx_ident( MM_CTX *ctx, MM_IDENT *id )
+{
+	CTX_SAVE save;
+	int err;
+
+	memset( id, 0, sizeof(*id) );
+	_ctx_enter( ctx, &save );
+	err = m_getmodinfo_probe( ctx->base, id->words, &id->probe, &id->modtype,
+							  &id->devid, &id->devrev, id->devname );
+	_ctx_leave( &save );
+	return err;
+}
+
+/******************************* mm_ctx_read *******************************/
+/**   Read consecutive EEPROM words, see m_read_range().
+ *---------------------------------------------------------------------------
+ *  \param ctx			\IN context
+ *  \param first		\IN index of first word
+ *  \param count		\IN number of words (first+count <= MM_EE_WORDS)
+ *  \param buf			\OUT words
+ *  \return 0=ok, 1=error
+ ****************************************************************************/
+int mm_ctx_read( MM_CTX *ctx, uint8_t first, uint8_t count, uint16_t *buf )
+{
+	CTX_SAVE save;
+	int err;
+
+	_ctx_enter( ctx, &save );
+	err = m_read_range( ctx->base, first, count, buf );
+	_ctx_leave( &save );
+	return err;
+}
+
+/******************************* mm_ctx_query ******************************/
+/**   Get fields of the EEPROM, see mm_query().
+ *
+ *    Words are read once per context, mm_ctx_program() forgets them.
+ *---------------------------------------------------------------------------
+ *  \param ctx			\IN context
+ *  \param fields		\IN MM_QF_xxx flags
+ *  \param res			\OUT result
+ *  \return 0=ok, 1=error
+ ****************************************************************************/
+int mm_ctx_query( MM_CTX *ctx, uint32_t fields, MM_QUERY_RES *res )
+{
+	CTX_SAVE save;
+	int err;
+
+	_ctx_enter( ctx, &save );
+	err = mm_query( &ctx->query, ctx->base, fields, res );
+	_ctx_leave( &save );
+	return err;
+}
+
+/******************************* mm_ctx_program ****************************/
+/**   Program an image into the EEPROM, see m_program().
+ *---------------------------------------------------------------------------
+ *  \param ctx			\IN context
+ *  \param image		\IN words to program, starting at word 0
+ *  \param nwords		\IN number of words
+ *  \param flags		\IN MM_PROG_xxx flags
+ *  \param rep			\OUT report (may be NULL)
+ *  \return MM_PROG_OK or MM_PROG_xxx error
+ ****************************************************************************/
+int mm_ctx_program( MM_CTX *ctx, const uint16_t *image, int nwords,
+					uint32_t flags, MM_PROG_REPORT *rep )
+{
+	CTX_SAVE save;
+	int err;
+
+	_ctx_enter( ctx, &save );
+	err = m_program( ctx->base, image, nwords, flags, rep );
+	_ctx_leave( &save );
+	mm_query_init( &ctx->query );
+	return err;
+}
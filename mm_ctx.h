@@ -0,0 +1,79 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_ctx.h
+ *
+ *      \author  awe
+ *
+ *       \brief  libmmident: per-slot context API.
+ *
+ *               An MM_CTX owns the mapping of one M-Module slot and its
+ *               bit timing. Results are returned in structs, nothing is
+ *               printed. Link with -lmmident -pthread.
+ *
+ *               MM_CTX *ctx;
+ *               MM_IDENT id;
+ *
+ *               if( mm_ctx_open( &ctx, 0xc0400200 ) == 0 ){
+ *                   if( mm_ctx_ident( ctx, &id ) == 0 )
+ *                       use id.devname, id.devid ...
+ *                   mm_ctx_close( ctx );
+ *               }
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_CTX_H
+#define _MM_CTX_H
+
+#include <stdint.h>
+#include "mm_eeprom.h"
+#include "mm_timing.h"
+#include "mm_stats.h"
+#include "mm_query.h"
+
+#define MM_IDENT_NAME_LEN	25	/* size of MM_IDENT.devname */
+
+/** identification result */
+typedef struct MM_IDENT {
+	uint32_t modtype;			/**< 0, MODCOM_MOD_MEN, MODCOM_MOD_THIRD */
+	uint32_t devid;				/**< (magic-id << 16) | mod-id */
+	uint32_t devrev;			/**< (layout-rev << 16) | product-variant */
+	char     devname[MM_IDENT_NAME_LEN];	/**< e.g. "M72" */
+	uint16_t words[4];			/**< raw words 0, 1, 2, 8 */
+	int      probe;				/**< MM_PROBE_xxx, e.g. empty slot */
+} MM_IDENT;
+
+typedef struct MM_CTX MM_CTX;
+
+int mm_ctx_open( MM_CTX **ctxP, uint64_t phys );
+int mm_ctx_open_res( MM_CTX **ctxP, const char *res, uint64_t offset );
+int mm_ctx_open_base( MM_CTX **ctxP, uintptr_t base );
+void mm_ctx_close( MM_CTX *ctx );
+uintptr_t mm_ctx_base( const MM_CTX *ctx );
+void mm_ctx_set_timing( MM_CTX *ctx, const MM_TIMING *tm );
+void mm_ctx_get_timing( const MM_CTX *ctx, MM_TIMING *tm );
+void mm_ctx_set_stats( MM_CTX *ctx, MM_STATS *st );
+int mm_ctx_autotune( MM_CTX *ctx, MM_TUNE *tune );
+int mm_ctx_ident( MM_CTX *ctx, MM_IDENT *id );
+int mm_ctx_read( MM_CTX *ctx, uint8_t first, uint8_t count, uint16_t *buf );
+int mm_ctx_query( MM_CTX *ctx, uint32_t fields, MM_QUERY_RES *res );
+int mm_ctx_program( MM_CTX *ctx, const uint16_t *image, int nwords,
+					uint32_t flags, MM_PROG_REPORT *rep );
+
+#endif /* _MM_CTX_H */
@@ -0,0 +1,617 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_daemon.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Inventory daemon.
+ *
+ *               The carriers stay mapped and the last identification
+ *               result of every slot is kept in memory. Clients connect
+ *               to a Unix stream socket and send one command per line:
+ *
+ *               list         all slots, terminated by an empty line
+ *               get <addr>   one slot
+ *               probe        full re-read of all slots now
+ *               status       probe counters
+ *               watch        keep the connection open and receive a
+ *                            "change" line whenever a slot changes
+ *
+ *               Slot lines look like the output of mm_ident plus the
+ *               number of changes seen ("Gen"). Queries are answered from
+ *               memory by the main thread; a probe thread re-reads the
+ *               slots in the background: normally only magic-id and
+ *               mod-id (one 2 word sequential read), every n-th time or
+ *               on a mismatch the complete id.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE				/* accept4(), pipe2() */
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mm_eeprom.h"
+#include "mm_timing.h"
+#include "mm_daemon.h"
+
+#define DAEMON_LINE		256		/* max. length of a command/slot line */
+#define DAEMON_POLL_MS	200		/* check for stop request */
+#define DAEMON_OUT_MAX	(1024 * 1024)	/* max. unsent bytes of a client */
+
+/** connected client */
+typedef struct {
+	int  fd;					/* -1=unused */
+	int  watch;					/* receives change events */
+	int  len;					/* bytes in line */
+	char line[DAEMON_LINE];		/* partial command line */
+	char  *out;					/* unsent output */
+	size_t outLen;				/* bytes in out */
+	size_t outMax;				/* size of out */
+} DAEMON_CLIENT;
+
+/** daemon state */
+typedef struct {
+	MM_SCAN             *scan;
+	const MM_DAEMON_CFG *cfg;
+	pthread_mutex_t      lock;		/* slot results, gen, probeNow, quit */
+	pthread_cond_t       cond;
+	uint32_t            *gen;		/* per slot: number of changes */
+	int                  probeNow;	/* full probe requested */
+	int                  quit;
+	int                  evPipe[2];	/* change events: probe -> main thread */
+	uint32_t             dropped;	/* events lost (pipe full) */
+	uint64_t             rounds;	/* probe rounds */
+	DAEMON_CLIENT        client[MM_DAEMON_CLIENTS];
+} DAEMON;
+
+/******************************* mm_daemon_cfg_init ************************/
+/**   Default daemon configuration.
+ *---------------------------------------------------------------------------
+ *  \param cfg			\OUT configuration
+ ****************************************************************************/
+void mm_daemon_cfg_init( MM_DAEMON_CFG *cfg )
+{
+	cfg->sockPath   = NULL;
+	cfg->intervalMs = MM_DAEMON_INTERVAL_MS;
+	cfg->fullEvery  = MM_DAEMON_FULL_EVERY;
+	cfg->inv        = NULL;
+}
+
+/******************************* _daemon_fmt *******************************/
+/**   Format the result of a slot (daemon locked).
+ *---------------------------------------------------------------------------
+ *  \param d			\IN daemon
+ *  \param i			\IN slot index
+ *  \param buf			\OUT line incl. newline
+ *  \param size			\IN size of buf
+ *  \return length of line
+ ****************************************************************************/
+static int _daemon_fmt( DAEMON *d, int i, char *buf, int size )
+{
+	MM_SCAN_SLOT *slot = &d->scan->slot[i];
+	int n;
+
+	n = snprintf( buf, size, "0x%08llx: ", (unsigned long long)slot->phys );
+	if( !slot->mapped )
+		n += snprintf( buf + n, size - n, "Can't map slot" );
+	else if( slot->err )
+		n += snprintf( buf + n, size - n, "Error reading modinfo" );
+	else
+		n += snprintf( buf + n, size - n,
+					   "Type: 0x%04x, ID: 0x%04x, Rev: 0x%04x, Name: %s",
+					   slot->modtype, (uint16_t)slot->devid,
+					   (uint16_t)slot->devrev, slot->devname );
+	if( slot->mapped && !slot->err && slot->probe != MM_PROBE_PRESENT )
+		n += snprintf( buf + n, size - n, slot->probe == MM_PROBE_EMPTY ?
+					   ", Empty" : ", DO stuck low" );
+	n += snprintf( buf + n, size - n, ", Gen: %u\n", d->gen[i] );
+	return n < size ? n : size - 1;
+}
+
+/******************************* _daemon_probe *****************************/
+/**   Re-probe one slot, raise a change event if its identity changed.
+ *---------------------------------------------------------------------------
+ *  \param d			\IN daemon
+ *  \param i			\IN slot index
+ *  \param full			\IN read the complete id, not only words 0/1
+ ****************************************************************************/
+static void _daemon_probe( DAEMON *d, int i, int full )
+{
+	MM_SCAN_SLOT *slot = &d->scan->slot[i];
+	uint16_t words[4];
+	uint32_t modtype, devid, devrev;
+	char devname[MM_DEVNAME_LEN], ev[DAEMON_LINE];
+	int err, n, same, probe;
+
+	mm_timing_set( &slot->timing );
+	if( !full && slot->probe != MM_PROBE_PRESENT ){
+		/* empty slot: only check that it still is */
+		probe = m_probe( slot->base );
+		if( probe == MM_PROBE_BUSY ){
+			mm_timing_set( NULL );		/* try again next round */
+			return;
+		}
+		pthread_mutex_lock( &d->lock );
+		same = !slot->err && probe == slot->probe;
+		pthread_mutex_unlock( &d->lock );
+		if( same ){
+			mm_timing_set( NULL );
+			return;
+		}
+	}
+	else if( !full ){
+		err = m_read_range( slot->base, 0, 2, words );
+		pthread_mutex_lock( &d->lock );
+		same = !err && !slot->err &&
+			words[0] == slot->words[0] && words[1] == slot->words[1];
+		pthread_mutex_unlock( &d->lock );
+		if( same ){
+			mm_timing_set( NULL );
+			return;
+		}
+	}
+	err = m_getmodinfo_probe( slot->base, words, &probe, &modtype, &devid,
+							  &devrev, devname );
+	mm_timing_set( NULL );
+	if( probe == MM_PROBE_BUSY )
+		return;
+
+	pthread_mutex_lock( &d->lock );
+	if( err == slot->err &&
+		(err || (!memcmp( words, slot->words, sizeof(words) ) &&
+				 modtype == slot->modtype && probe == slot->probe &&
+				 !strcmp( devname, slot->devname ))) ){
+		pthread_mutex_unlock( &d->lock );
+		return;
+	}
+
+	n = snprintf( ev, sizeof(ev), "change " );
+	slot->err = err;
+	if( !err ){
+		memcpy( slot->words, words, sizeof(words) );
+		slot->modtype = modtype;
+		slot->probe   = probe;
+		slot->devid   = devid;
+		slot->devrev  = devrev;
+		memcpy( slot->devname, devname, sizeof(devname) );
+	}
+	d->gen[i]++;
+	n += _daemon_fmt( d, i, ev + n, sizeof(ev) - n );
+
+	/*
+	 * lines are shorter than PIPE_BUF, so the write is atomic; the pipe
+	 * doesn't block, if the main thread doesn't keep up the event is lost
+	 */
+	if( write( d->evPipe[1], ev, n ) != n )
+		d->dropped++;
+	pthread_mutex_unlock( &d->lock );
+}
+
+/******************************* _daemon_prober ****************************/
+/**   Probe thread: re-probe all slots every cfg->intervalMs and publish
+ *    the results in cfg->inv.
+ ****************************************************************************/
+static void *_daemon_prober( void *arg )
+{
+	DAEMON *d = arg;
+	MM_SCAN *scan = d->scan;
+	struct timespec ts;
+	uint64_t next = mm_time_ns(), round = 0;
+	int i, full;
+
+	pthread_mutex_lock( &d->lock );
+	while( !d->quit ){
+		if( d->cfg->intervalMs )
+			next += (uint64_t)d->cfg->intervalMs * 1000000;
+		else
+			next = ~0ULL >> 2;				/* only on request */
+
+		ts.tv_sec  = (time_t)(next / 1000000000);
+		ts.tv_nsec = (long)(next % 1000000000);
+		while( !d->quit && !d->probeNow &&
+			   pthread_cond_timedwait( &d->cond, &d->lock, &ts ) != ETIMEDOUT )
+			;
+		if( d->quit )
+			break;
+
+		round++;
+		d->rounds = round;
+		full = d->probeNow ||
+			(d->cfg->fullEvery && round % d->cfg->fullEvery == 0);
+		if( d->probeNow )
+			next = mm_time_ns();
+		d->probeNow = 0;
+		pthread_mutex_unlock( &d->lock );
+
+		for( i=0; i<scan->nslots; i++ )
+			if( scan->slot[i].mapped )
+				_daemon_probe( d, i, full );
+
+		pthread_mutex_lock( &d->lock );
+		if( d->cfg->inv )
+			mm_inv_update( d->cfg->inv, scan );
+	}
+	pthread_mutex_unlock( &d->lock );
+	return NULL;
+}
+
+/******************************* _daemon_drop *****************************/
+/**   Disconnect a client.
+ *---------------------------------------------------------------------------
+ *  \param c			\IN client
+ ****************************************************************************/
+static void _daemon_drop( DAEMON_CLIENT *c )
+{
+	close( c->fd );
+	c->fd = -1;
+	free( c->out );
+	c->out = NULL;
+	c->outLen = c->outMax = 0;
+}
+
+/******************************* _daemon_flush ****************************/
+/**   Send queued output of a client as far as the socket takes it.
+ *---------------------------------------------------------------------------
+ *  \param c			\IN client
+ ****************************************************************************/
+static void _daemon_flush( DAEMON_CLIENT *c )
+{
+	ssize_t n;
+
+	while( c->fd >= 0 && c->outLen ){
+		n = send( c->fd, c->out, c->outLen, MSG_NOSIGNAL | MSG_DONTWAIT );
+		if( n < 0 && (errno == EAGAIN || errno == EINTR) )
+			return;
+		if( n <= 0 ){
+			_daemon_drop( c );
+			return;
+		}
+		c->outLen -= (size_t)n;
+		memmove( c->out, c->out + n, c->outLen );
+	}
+}
+
+/******************************* _daemon_send *****************************/
+/**   Send to a client.
+ *
+ *    What the socket doesn't take now is queued and sent when the client
+ *    reads again (POLLOUT). A client that lets more than DAEMON_OUT_MAX
+ *    bytes pile up is dropped.
+ *---------------------------------------------------------------------------
+ *  \param c			\IN client
+ *  \param buf			\IN data
+ *  \param len			\IN length
+ ****************************************************************************/
+static void _daemon_send( DAEMON_CLIENT *c, const char *buf, size_t len )
+{
+	size_t max;
+	char *p;
+
+	if( c->fd < 0 )
+		return;
+	if( c->outLen + len > DAEMON_OUT_MAX ){
+		_daemon_drop( c );
+		return;
+	}
+	if( c->outLen + len > c->outMax ){
+		for( max = c->outMax ? c->outMax : DAEMON_LINE;
+			 max < c->outLen + len; max *= 2 )
+			;
+		if( !(p = realloc( c->out, max )) ){
+			_daemon_drop( c );
+			return;
+		}
+		c->out    = p;
+		c->outMax = max;
+	}
+	memcpy( c->out + c->outLen, buf, len );
+	c->outLen += len;
+	_daemon_flush( c );
+}
+
+/******************************* _daemon_cmd *******************************/
+/**   Execute a client command.
+ *---------------------------------------------------------------------------
+ *  \param d			\IN daemon
+ *  \param c			\IN client
+ *  \param cmd			\IN command line (without newline)
+ ****************************************************************************/
+static void _daemon_cmd( DAEMON *d, DAEMON_CLIENT *c, const char *cmd )
+{
+	MM_SCAN *scan = d->scan;
+	char line[DAEMON_LINE], *buf, *end;
+	unsigned long long addr;
+	int i, n = 0;
+
+	if( !strcmp( cmd, "list" ) ){
+		if( !(buf = malloc( (size_t)(scan->nslots + 1) * DAEMON_LINE )) ){
+			_daemon_send( c, "ERR out of memory\n", 18 );
+			return;
+		}
+		pthread_mutex_lock( &d->lock );
+		for( i=0; i<scan->nslots; i++ )
+			n += _daemon_fmt( d, i, buf + n, DAEMON_LINE );
+		pthread_mutex_unlock( &d->lock );
+		buf[n++] = '\n';
+		_daemon_send( c, buf, n );
+		free( buf );
+	}
+	else if( !strncmp( cmd, "get ", 4 ) ){
+		addr = strtoull( cmd + 4, &end, 16 );
+		for( i=0; i<scan->nslots; i++ )
+			if( scan->slot[i].phys == addr )
+				break;
+		if( end == cmd + 4 || *end || i == scan->nslots ){
+			_daemon_send( c, "ERR unknown slot\n", 17 );
+			return;
+		}
+		pthread_mutex_lock( &d->lock );
+		n = _daemon_fmt( d, i, line, sizeof(line) );
+		pthread_mutex_unlock( &d->lock );
+		_daemon_send( c, line, n );
+	}
+	else if( !strcmp( cmd, "probe" ) ){
+		pthread_mutex_lock( &d->lock );
+		d->probeNow = 1;
+		pthread_cond_signal( &d->cond );
+		pthread_mutex_unlock( &d->lock );
+		_daemon_send( c, "OK\n", 3 );
+	}
+	else if( !strcmp( cmd, "status" ) ){
+		pthread_mutex_lock( &d->lock );
+		n = snprintf( line, sizeof(line), "Slots: %d, Interval: %u ms, "
+					  "Full every: %d, Probes: %llu, Dropped events: %u\n",
+					  scan->nslots, d->cfg->intervalMs, d->cfg->fullEvery,
+					  (unsigned long long)d->rounds, d->dropped );
+		pthread_mutex_unlock( &d->lock );
+		_daemon_send( c, line, n );
+	}
+	else if( !strcmp( cmd, "watch" ) ){
+		c->watch = 1;
+		_daemon_send( c, "OK\n", 3 );
+	}
+	else if( cmd[0] ){
+		_daemon_send( c, "ERR unknown command\n", 20 );
+	}
+}
+
+/******************************* _daemon_input *****************************/
+/**   Read from a client and execute complete command lines.
+ *---------------------------------------------------------------------------
+ *  \param d			\IN daemon
+ *  \param c			\IN client
+ ****************************************************************************/
+static void _daemon_input( DAEMON *d, DAEMON_CLIENT *c )
+{
+	char *nl;
+	ssize_t n;
+	int len;
+
+	n = recv( c->fd, c->line + c->len, sizeof(c->line) - 1 - c->len,
+			  MSG_DONTWAIT );
+	if( n <= 0 ){
+		if( n < 0 && (errno == EAGAIN || errno == EINTR) )
+			return;
+		_daemon_drop( c );
+		return;
+	}
+	c->len += (int)n;
+	c->line[c->len] = '\0';
+
+	while( c->fd >= 0 && (nl = strchr( c->line, '\n' )) ){
+		*nl = '\0';
+		if( nl > c->line && nl[-1] == '\r' )
+			nl[-1] = '\0';
+		_daemon_cmd( d, c, c->line );
+		len = (int)(nl + 1 - c->line);
+		memmove( c->line, nl + 1, c->len - len + 1 );
+		c->len -= len;
+	}
+
+	if( c->fd >= 0 && c->len == (int)sizeof(c->line) - 1 ){
+		_daemon_send( c, "ERR line too long\n", 18 );
+		c->len = 0;
+	}
+}
+
+/******************************* _daemon_events ****************************/
+/**   Forward change events from the probe thread to all watchers.
+ *---------------------------------------------------------------------------
+ *  \param d			\IN daemon
+ ****************************************************************************/
+static void _daemon_events( DAEMON *d )
+{
+	char buf[4096];
+	ssize_t n;
+	int i;
+
+	if( (n = read( d->evPipe[0], buf, sizeof(buf) )) <= 0 )
+		return;
+	for( i=0; i<MM_DAEMON_CLIENTS; i++ )
+		if( d->client[i].fd >= 0 && d->client[i].watch )
+			_daemon_send( &d->client[i], buf, (size_t)n );
+}
+
+/******************************* _daemon_listen ****************************/
+/**   Create the listening socket.
+ *
+ *    The directory is created if necessary, a stale socket is removed.
+ *---------------------------------------------------------------------------
+ *  \param path			\IN socket path
+ *  \return socket or -1 (errno set)
+ ****************************************************************************/
+static int _daemon_listen( const char *path )
+{
+	struct sockaddr_un sa;
+	char dir[sizeof(sa.sun_path)], *p;
+	int fd, e;
+
+	if( strlen( path ) >= sizeof(sa.sun_path) ){
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	snprintf( dir, sizeof(dir), "%s", path );
+	if( (p = strrchr( dir, '/' )) && p != dir ){
+		*p = '\0';
+		mkdir( dir, 0755 );
+	}
+
+	if( (fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 )) < 0 )
+		return -1;
+
+	memset( &sa, 0, sizeof(sa) );
+	sa.sun_family = AF_UNIX;
+	snprintf( sa.sun_path, sizeof(sa.sun_path), "%s", path );
+	unlink( path );
+	if( bind( fd, (struct sockaddr *)&sa, sizeof(sa) ) ||
+		listen( fd, 16 ) ){
+		e = errno;
+		close( fd );
+		errno = e;
+		return -1;
+	}
+	return fd;
+}
+
+/******************************* mm_daemon_run *****************************/
+/**   Run the inventory daemon until *stop is set.
+ *
+ *    The slots must be mapped and identified (mm_scan_run() & co.), the
+ *    results in the scan list are the initial inventory and are updated
+ *    by the daemon.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN identified slots
+ *  \param cfg			\IN configuration
+ *  \param stop			\IN set (e.g. by a signal handler) to terminate
+ *  \return 0=ok, -1=error (errno set)
+ ****************************************************************************/
+int mm_daemon_run( MM_SCAN *scan, const MM_DAEMON_CFG *cfg,
+				   volatile sig_atomic_t *stop )
+{
+	const char *path = cfg->sockPath ? cfg->sockPath : MM_DAEMON_SOCK;
+	struct pollfd pfd[MM_DAEMON_CLIENTS + 2];
+	int cidx[MM_DAEMON_CLIENTS + 2];
+	pthread_condattr_t ca;
+	pthread_t prober;
+	DAEMON *d;
+	int lfd, fd, i, n, e, ret = -1;
+
+	if( !(d = calloc( 1, sizeof(*d) )) )
+		return -1;
+	d->scan = scan;
+	d->cfg  = cfg;
+	for( i=0; i<MM_DAEMON_CLIENTS; i++ )
+		d->client[i].fd = -1;
+	if( !(d->gen = calloc( scan->nslots + 1, sizeof(*d->gen) )) )
+		goto FREE;
+	if( pipe2( d->evPipe, O_NONBLOCK | O_CLOEXEC ) )
+		goto FREE;
+	if( (lfd = _daemon_listen( path )) < 0 )
+		goto PIPE;
+
+	pthread_mutex_init( &d->lock, NULL );
+	pthread_condattr_init( &ca );
+	pthread_condattr_setclock( &ca, CLOCK_MONOTONIC );
+	pthread_cond_init( &d->cond, &ca );
+	pthread_condattr_destroy( &ca );
+
+	if( (errno = pthread_create( &prober, NULL, _daemon_prober, d )) )
+		goto SOCK;
+
+	while( !*stop ){
+		pfd[0].fd = lfd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = d->evPipe[0];
+		pfd[1].events = POLLIN;
+		for( n=2, i=0; i<MM_DAEMON_CLIENTS; i++ ){
+			if( d->client[i].fd < 0 )
+				continue;
+			pfd[n].fd = d->client[i].fd;
+			pfd[n].events = POLLIN | (d->client[i].outLen ? POLLOUT : 0);
+			cidx[n++] = i;
+		}
+
+		if( poll( pfd, n, DAEMON_POLL_MS ) <= 0 )
+			continue;
+
+		if( pfd[1].revents & POLLIN )
+			_daemon_events( d );
+
+		for( i=2; i<n; i++ ){
+			if( pfd[i].revents & POLLOUT )
+				_daemon_flush( &d->client[cidx[i]] );
+			if( d->client[cidx[i]].fd >= 0 &&
+				(pfd[i].revents & (POLLIN|POLLHUP|POLLERR)) )
+				_daemon_input( d, &d->client[cidx[i]] );
+		}
+
+		if( pfd[0].revents & POLLIN ){
+			if( (fd = accept4( lfd, NULL, NULL, SOCK_CLOEXEC )) < 0 )
+				continue;
+			for( i=0; i<MM_DAEMON_CLIENTS && d->client[i].fd >= 0; i++ )
+				;
+			if( i == MM_DAEMON_CLIENTS ){
+				close( fd );
+				continue;
+			}
+			memset( &d->client[i], 0, sizeof(d->client[i]) );
+			d->client[i].fd = fd;
+		}
+	}
+	ret = 0;
+
+	pthread_mutex_lock( &d->lock );
+	d->quit = 1;
+	pthread_cond_signal( &d->cond );
+	pthread_mutex_unlock( &d->lock );
+	pthread_join( prober, NULL );
+
+	for( i=0; i<MM_DAEMON_CLIENTS; i++ )
+		if( d->client[i].fd >= 0 )
+			_daemon_drop( &d->client[i] );
+
+SOCK:
+	e = errno;
+	pthread_cond_destroy( &d->cond );
+	pthread_mutex_destroy( &d->lock );
+	close( lfd );
+	unlink( path );
+	errno = e;
+PIPE:
+	close( d->evPipe[0] );
+	close( d->evPipe[1] );
+FREE:
+	e = errno;
+	free( d->gen );
+	free( d );
+	errno = e;
+	return ret;
+}
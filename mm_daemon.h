@@ -0,0 +1,55 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_daemon.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Inventory daemon: answers queries about the last known
+ *               identification results over a Unix socket and re-probes
+ *               the slots in the background.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_DAEMON_H
+#define _MM_DAEMON_H
+
+#include <signal.h>
+#include <stdint.h>
+#include "mm_scan.h"
+#include "mm_inv.h"
+
+#define MM_DAEMON_SOCK			"/run/mm_ident/sock"	/* default socket */
+#define MM_DAEMON_INTERVAL_MS	1000	/* default re-probe interval */
+#define MM_DAEMON_FULL_EVERY	60		/* default full read every n probes */
+#define MM_DAEMON_CLIENTS		64		/* max. connected clients */
+
+/** daemon configuration */
+typedef struct MM_DAEMON_CFG {
+	const char *sockPath;		/**< Unix socket (NULL=MM_DAEMON_SOCK) */
+	uint32_t    intervalMs;		/**< re-probe interval, 0=never */
+	int         fullEvery;		/**< full read every n-th probe, 0=never */
+	MM_INV     *inv;			/**< inventory to update or NULL */
+} MM_DAEMON_CFG;
+
+void mm_daemon_cfg_init( MM_DAEMON_CFG *cfg );
+int mm_daemon_run( MM_SCAN *scan, const MM_DAEMON_CFG *cfg,
+				   volatile sig_atomic_t *stop );
+
+#endif /* _MM_DAEMON_H */
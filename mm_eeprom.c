@@ -0,0 +1,1568 @@
+
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_eeprom.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Access to the M-Module serial id EEPROM (libmmident).
+ *               Bit-bang protocol, reading, programming and decoding of
+ *               the id words. Nothing is printed here.
+ *
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "mm_eeprom.h"
+#include "mm_timing.h"
+#include "mm_stats.h"
+#include "mm_rt.h"
+#include "mm_lock.h"
+
+#define     T_WP    10000   		/* max. time required for write/erase (us) */
+
+#define FALSE 0x00
+#define TRUE 0x01
+
+
+/*--- K&R prototypes ---*/
+static int _write( uintptr_t base, uint8_t index, uint16_t data );
+static int _erase( uintptr_t base, uint8_t index );
+static int _wait_ready( uintptr_t base );
+static void _opcode( uintptr_t base, uint8_t code );
+static void _select( uintptr_t base );
+static void _deselect( uintptr_t base );
+static int _clock( uintptr_t base, uint8_t dbs );
+static void _delay( void );
+static void _flush( uintptr_t base );
+static int _read_words( uintptr_t base, uint8_t first, uint8_t count,
+                        uint16_t *buf, int probe );
+static void _xtoa( uint32_t val, uint32_t radix, char *buf );
+static void MWRITE_D16(uintptr_t base, uint32_t offset, uint16_t val);
+static uint16_t MREAD_D16(uintptr_t base, uint32_t offset);
+
+/* register access backend in use */
+static const MM_BUS_OPS *G_bus = &MM_BusMmio;
+
+/* bit delays of n clocks, for mm_rt_leave() */
+#define _CLK_NS(n)  ((uint64_t)(n) * 2 * mm_timing_get()->halfNs)
+
+/*
+ * Waveform tables: one byte per MODREG write, the register value in the
+ * low bits plus flags. Each write is followed by the flush (if enabled in
+ * the timing) and half a bit period, except for W_NODLY.
+ */
+#define W_BITS      (B_DAT|B_CLK|B_SEL)
+#define W_NODLY     0x10                /* no flush/delay after the write */
+#define W_DATA      0x20                /* DI = next data bit, MSB first */
+#define W_SAMPLE    0x40                /* sample DO after the delay */
+
+#define WAVE_HDR    20                  /* select, start bit, 8 bit opcode */
+#define WAVE_WORD   32                  /* 16 data bits */
+
+static uint8_t G_waveHdr[256][WAVE_HDR];   /* per instruction code */
+static uint8_t G_waveRd[WAVE_WORD];         /* clock out a word */
+static uint8_t G_waveWr[WAVE_WORD];         /* clock in a word */
+static pthread_once_t G_waveOnce = PTHREAD_ONCE_INIT;
+
+static const uint8_t *_wave_hdr( uint8_t code );
+static int _wave_run( uintptr_t base, const uint8_t *w, int n, uint16_t data,
+                      int sample, uint16_t *out );
+
+/******************************* _xtoa *************************************/
+/**   Converts an u_int32 to a character string.
+ *
+ *---------------------------------------------------------------------------
+ *  \param radix		\IN	base to convert into
+ *  \param val			\IN	number to be converted
+ *  \param buf			\IN	ptr to buffer to place result
+ *	\param buf			\OUT computed string
+ *  Globals....:  ---
+ ****************************************************************************/
+static void _xtoa( uint32_t val, uint32_t radix, char *buf )
+{
+	char	*p;           /* pointer to traverse string */
+    char	*firstdig;    /* pointer to first digit */
+    char	temp;         /* temp char */
+    uint32_t digval;       /* value of digit */
+
+    p = buf;
+
+	/* save pointer to first digit */
+    firstdig = p;
+
+    do {
+        digval = (uint32_t) (val % radix);
+        val /= radix; /* get next digit */
+
+        /* convert to ascii and store */
+        if (digval > 9)
+            *p++ = (char) (digval - 10 + 'a');  /* a letter */
+        else
+            *p++ = (char) (digval + '0');       /* a digit */
+    } while (val > 0);
+
+    /* terminate string; p points to last digit */
+    *p-- = '\0';
+
+    /* reverse buffer */
+    do {
+        temp = *p;
+        *p = *firstdig;
+        *firstdig = temp;   /* swap *p and *firstdig */
+        --p;
+        ++firstdig;         /* advance to next two digits */
+    } while (firstdig < p); /* repeat until halfway */
+}
+
+/******************************* _write ***********************************/
+/**   Write a specified word into EEPROM at 'base'.
+ *
+ *---------------------------------------------------------------------------
+ *	\param base			\IN base address pointer
+ *	\param index		\IN index to write (0..63)
+ *  \param data			\IN word to write
+ *  \return   0=ok 1=write err 2=verify err
+ *
+ ***************************************************************************/
+static int _write( uintptr_t base, uint8_t index, uint16_t data )
+{
+    register int    err;                    /* error */
+
+    _opcode(base,EWEN);                     /* write enable */
+    _deselect(base);                        /* deselect     */
+
+    _opcode(base, (uint8_t)(_WRITE_+index) );             /* select write */
+    _wave_run( base, G_waveWr, WAVE_WORD, data, 0, NULL );  /* write data */
+    _deselect(base);                        /* deselect     */
+
+    err = _wait_ready(base);                /* wait for low/high */
+
+    _opcode(base, EWDS);                    /* write disable*/
+    _deselect(base);                        /* disable      */
+
+    if( err )                               /* error ?      */
+        return 1;                           /* ..yes */
+
+    if( data != m_read(base,index) )        /* verify data  */
+        return 2;                           /* ..error      */
+
+    return 0;                               /* ..no         */
+}
+
+/******************************* _erase ***********************************/
+/**   Erase a specified word into EEPROM
+ *
+ *---------------------------------------------------------------------------
+ *	\param base			\IN base address pointer
+ *	\param index		\IN index to write (0..15)
+ *  \return   0=ok 1=error
+ *
+ ***************************************************************************/
+static int _erase( uintptr_t base, uint8_t index )
+{
+    register int    i,err;                  /* counter, error */
+
+    _opcode(base,EWEN);                     /* erase enable */
+    for(i=0;i<4;i++) _clock(base,0);
+    _deselect(base);                        /* deselect     */
+
+    _opcode(base,(uint8_t)(ERASE+index) );              /* select erase */
+    _deselect(base);                        /* deselect     */
+
+    err = _wait_ready(base);                /* wait for low/high */
+
+    _opcode(base,EWDS);                     /* erase disable*/
+    _deselect(base);                        /* disable      */
+
+    if( err )                               /* error ?      */
+        return 1;
+    return 0;
+}
+
+/******************************* _wait_ready ******************************/
+/**   Wait for the end of a self timed erase/write cycle.
+ *
+ *    Selects the EEPROM and polls the ready/busy status on DO: first
+ *    for low (busy), then for high (ready). Both together may take at
+ *    most T_WP microseconds. Leaves the EEPROM selected.
+ *
+ *---------------------------------------------------------------------------
+ *	\param base			\IN base address pointer
+ *  \return   0=ok 1=timeout
+ *
+ ***************************************************************************/
+static int _wait_ready( uintptr_t base )
+{
+    uint64_t end;
+
+    _select(base);
+    end = mm_time_ns() + (uint64_t)T_WP * 1000;
+
+    while( _clock(base,0) ) {               /* wait for low */
+        MM_STATS_ADD( polls, 1 );
+        if( mm_time_ns() > end )
+            return 1;
+    }
+    while( !_clock(base,0) ) {              /* wait for high*/
+        MM_STATS_ADD( polls, 1 );
+        if( mm_time_ns() > end )
+            return 1;
+    }
+    MM_STATS_ADD( polls, 2 );
+    return 0;
+}
+
+/******************************* _opcode ***********************************/
+/**   Output opcode with leading startbit
+ *
+ *---------------------------------------------------------------------------
+ *	\param base			\IN base address pointer
+ *	\param code			\IN opcode to write
+ *
+ ***************************************************************************/
+static void _opcode( uintptr_t base, uint8_t code )
+{
+    _wave_run( base, _wave_hdr(code), WAVE_HDR, 0, 0, NULL );
+}
+
+/******************************* _wave_init ********************************/
+/**   Build the waveform tables.
+ *
+ *    The header of an instruction samples DO at the start bit (the
+ *    EEPROM doesn't drive DO yet) and after the last address bit (dummy
+ *    zero of READ), used by the presence probe only.
+ *
+ ***************************************************************************/
+static void _wave_init( void )
+{
+    uint8_t *w, b;
+    int code, i;
+
+    for(code=0; code<256; code++) {
+        w = G_waveHdr[code];
+        *w++ = W_NODLY;                         /* everything inactive */
+        *w++ = B_SEL;                           /* select high */
+        *w++ = B_DAT|B_SEL;                     /* start bit */
+        *w++ = B_DAT|B_CLK|B_SEL|W_SAMPLE;
+        for(i=7; i>=0; i--) {
+            b = (uint8_t)(((code>>i)&0x01) ? B_DAT : 0);
+            *w++ = b|B_SEL;
+            *w++ = (uint8_t)(b|B_CLK|B_SEL|(i ? 0 : W_SAMPLE));
+        }
+    }
+    for(i=0; i<WAVE_WORD; i+=2) {
+        G_waveRd[i]   = B_SEL;
+        G_waveRd[i+1] = B_CLK|B_SEL|W_SAMPLE;
+        G_waveWr[i]   = B_SEL|W_DATA;
+        G_waveWr[i+1] = B_CLK|B_SEL|W_DATA;
+    }
+}
+
+/******************************* _wave_hdr *********************************/
+/**   Waveform of select, start bit and instruction 'code'.
+ ***************************************************************************/
+static const uint8_t *_wave_hdr( uint8_t code )
+{
+    pthread_once( &G_waveOnce, _wave_init );
+    return G_waveHdr[code];
+}
+
+/******************************* _wave_run *********************************/
+/**   Replay a waveform table.
+ *
+ *    MODREG is only read for the flushes the timing asks for and for the
+ *    W_SAMPLE steps.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param w			\IN waveform
+ *  \param n			\IN number of steps
+ *  \param data			\IN data word for W_DATA steps
+ *  \param sample		\IN sample DO at W_SAMPLE steps
+ *  \param out			\OUT sampled bits, first in the MSB (may be NULL)
+ *  \return   number of sampled bits
+ *
+ ***************************************************************************/
+static int _wave_run( uintptr_t base, const uint8_t *w, int n, uint16_t data,
+                      int sample, uint16_t *out )
+{
+    int      flush = mm_timing_get()->flush;
+    uint16_t v, acc = 0;
+    int      i, k = 0;
+
+    pthread_once( &G_waveOnce, _wave_init );
+    for(i=0; i<n; i++) {
+        v = (uint16_t)(w[i] & W_BITS);
+        if( w[i] & W_DATA ) {
+            if( data & 0x8000 )
+                v |= B_DAT;
+            if( v & B_CLK )
+                data = (uint16_t)(data << 1);
+        }
+        MWRITE_D16( base, MODREG, v );
+        if( w[i] & W_NODLY )
+            continue;
+        if( v & B_CLK )
+            MM_STATS_ADD( clocks, 1 );
+        if( flush )
+            (void)MREAD_D16( base, MODREG );
+        _delay();
+        if( sample && (w[i] & W_SAMPLE) ) {
+            acc = (uint16_t)((acc<<1) | (MREAD_D16( base, MODREG ) & B_DAT));
+            k++;
+        }
+    }
+    if( out )
+        *out = acc;
+    return k;
+}
+
+/******************************* _select ***********************************/
+/**   Select EEPROM:
+ *                 output DI/CLK/CS low
+ *                 delay
+ *                 output CS high
+ *                 delay
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *
+ ***************************************************************************/
+static void _select( uintptr_t base )
+{
+    MWRITE_D16( base, MODREG, 0 );			/* everything inactive */
+    MWRITE_D16( base, MODREG, B_SEL );		/* select high */
+    _flush(base);
+    _delay();
+}
+
+/******************************* _deselect *********************************/
+/**   Deselect EEPROM
+ *                 output CS low
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *
+ ***************************************************************************/
+static void _deselect( uintptr_t base )
+{
+    MWRITE_D16( base, MODREG, 0 );			/* everything inactive */
+}
+
+
+/******************************* _bus **************************************/
+/**   Backend for the calling thread: the access profile of its timing
+ *    for MMIO, else the selected backend.
+ ***************************************************************************/
+static inline const MM_BUS_OPS *_bus( void )
+{
+	return G_bus == &MM_BusMmio ?
+		&MM_BusAccess[mm_timing_get()->access] : G_bus;
+}
+
+/******************************* MWRITE_D16 *********************************/
+/**   Write 16bit value to a memory address.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param offset		\IN memory offset
+ *  \param val			\IN value to write to the memory are
+ *
+ ***************************************************************************/
+static void MWRITE_D16(uintptr_t base, uint32_t offset, uint16_t val)
+{
+	MM_STATS_ADD( writes, 1 );
+	_bus()->write16( base, offset, val );
+}
+
+/******************************* MREAD_D16 *********************************/
+/**   Read a 16bit value from a memory address.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param offset		\IN memory offset
+ * 
+ *  \return value read from the memory address
+ ***************************************************************************/
+static uint16_t MREAD_D16(uintptr_t base, uint32_t offset)
+{
+	MM_STATS_ADD( reads, 1 );
+	return _bus()->read16( base, offset );
+}
+
+/*
+ * I/O barriers of the ordered access profiles: order the register access
+ * against all earlier (write) or later (read) memory accesses. x86 maps
+ * the carrier uncached, where this holds without fence instructions.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+# define _IO_WMB()	__asm__ __volatile__( "" ::: "memory" )
+# define _IO_RMB()	__asm__ __volatile__( "" ::: "memory" )
+#elif defined(__aarch64__)
+# define _IO_WMB()	__asm__ __volatile__( "dmb oshst" ::: "memory" )
+# define _IO_RMB()	__asm__ __volatile__( "dmb oshld" ::: "memory" )
+#elif defined(__arm__)
+# define _IO_WMB()	__asm__ __volatile__( "dmb" ::: "memory" )
+# define _IO_RMB()	__asm__ __volatile__( "dmb" ::: "memory" )
+#elif defined(__powerpc__) || defined(__powerpc64__)
+# define _IO_WMB()	__asm__ __volatile__( "eieio" ::: "memory" )
+# define _IO_RMB()	__asm__ __volatile__( "sync" ::: "memory" )
+#else
+# define _IO_WMB()	__sync_synchronize()
+# define _IO_RMB()	__sync_synchronize()
+#endif
+
+/* relaxed profiles: volatile access, only kept in order by the compiler */
+#define _IO_NOB()	__asm__ __volatile__( "" ::: "memory" )
+
+/*
+ * Access profiles: X( tag, name, access type, MODREG offset in the slot,
+ * barrier before a write, barrier after a read ). Every profile gets its
+ * own read/write functions with the type and offset as constants.
+ * The order must match the MM_ACCESS_xxx numbers.
+ */
+#define ACCESS_LIST(X) \
+	X( F204,     "f204",     uint32_t, MODREG, _IO_NOB, _IO_NOB ) \
+	X( D16,      "d16",      uint16_t, MODREG, _IO_NOB, _IO_NOB ) \
+	X( D16_SYNC, "d16-sync", uint16_t, MODREG, _IO_WMB, _IO_RMB )
+
+#define ACCESS_FUNCS(tag, name, type, reg, wmb, rmb) \
+static void _acc_write_##tag( uintptr_t base, uint32_t offset, uint16_t val ) \
+{ \
+	wmb(); \
+	*(volatile type *)(base + offset + ((reg) - MODREG)) = val; \
+	_IO_NOB(); \
+} \
+static uint16_t _acc_read_##tag( uintptr_t base, uint32_t offset ) \
+{ \
+	uint16_t val = (uint16_t) \
+		*(volatile type *)(base + offset + ((reg) - MODREG)); \
+	rmb(); \
+	return val; \
+}
+#define ACCESS_OPS(tag, name, ...) \
+	{ name, _acc_write_##tag, _acc_read_##tag },
+
+ACCESS_LIST(ACCESS_FUNCS)
+
+const MM_BUS_OPS MM_BusAccess[MM_ACCESS_NUM] = {
+	ACCESS_LIST(ACCESS_OPS)
+};
+
+/******************************* mm_access_find ****************************/
+/**   Look up an access profile by name.
+ *---------------------------------------------------------------------------
+ *  \param name			\IN profile name (e.g. "d16")
+ *  \return MM_ACCESS_xxx or -1
+ ***************************************************************************/
+int mm_access_find( const char *name )
+{
+	int i;
+
+	for( i=0; i<MM_ACCESS_NUM; i++ )
+		if( !strcmp( MM_BusAccess[i].name, name ) )
+			return i;
+	return -1;
+}
+
+/******************************* _mmio_write16 *****************************/
+/**   MMIO backend: write to the mapped carrier with the access profile
+ *    of the calling thread's timing.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN mapped base address
+ *  \param offset		\IN memory offset
+ *  \param val			\IN value to write to the memory are
+ *
+ ***************************************************************************/
+static void _mmio_write16(uintptr_t base, uint32_t offset, uint16_t val)
+{
+	MM_BusAccess[mm_timing_get()->access].write16( base, offset, val );
+}
+
+/******************************* _mmio_read16 ******************************/
+/**   MMIO backend: read from the mapped carrier, see _mmio_write16().
+ *---------------------------------------------------------------------------
+ *  \param base			\IN mapped base address
+ *  \param offset		\IN memory offset
+ * 
+ *  \return value read from the memory address
+ ***************************************************************************/
+static uint16_t _mmio_read16(uintptr_t base, uint32_t offset)
+{
+	return MM_BusAccess[mm_timing_get()->access].read16( base, offset );
+}
+
+const MM_BUS_OPS MM_BusMmio = {
+	"mmio",
+	_mmio_write16,
+	_mmio_read16
+};
+
+/******************************* mm_bus_set ********************************/
+/**   Select the register access backend.
+ *---------------------------------------------------------------------------
+ *  \param ops			\IN backend (NULL=MMIO)
+ *
+ ***************************************************************************/
+void mm_bus_set( const MM_BUS_OPS *ops )
+{
+	G_bus = ops ? ops : &MM_BusMmio;
+}
+
+/******************************* mm_bus_get ********************************/
+/**   Get the register access backend in use.
+ *---------------------------------------------------------------------------
+ *  \return backend
+ ***************************************************************************/
+const MM_BUS_OPS *mm_bus_get( void )
+{
+	return G_bus;
+}
+
+/******************************* _clock ***********************************/
+/**   Output data bit:
+ *                 output clock low
+ *                 output data bit
+ *                 delay
+ *                 output clock high
+ *                 delay
+ *                 return state of data serial eeprom's DO - line
+ *                 (Note: keep CS asserted)
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *	\param dbs			\IN	data bit to send
+ *  \return state of DO line
+ *
+ ***************************************************************************/
+static int _clock( uintptr_t base, uint8_t dbs )
+{
+    MM_STATS_ADD( clocks, 1 );
+    MWRITE_D16( base, MODREG, dbs|B_SEL );  /* output clock low */
+                                            /* output data high/low */
+    _flush(base);
+    _delay();                               /* delay    */
+
+    MWRITE_D16( base, MODREG, dbs|B_CLK|B_SEL );  /* output clock high */
+    _flush(base);
+    _delay();                               /* delay    */
+
+    return( MREAD_D16( base, MODREG) & B_DAT );  /* get data */
+}
+
+/******************************* _delay ************************************/
+/**   Delay half a bit period of the calling thread's timing
+ *    (MM_HALF_NS_DEFAULT = one microsecond unless tuned)
+ *---------------------------------------------------------------------------
+ *
+ ***************************************************************************/
+static void _delay( void )
+{
+    uint32_t ns = mm_delay_ns( mm_timing_get()->halfNs );
+
+    MM_STATS_ADD( delays, 1 );
+    MM_STATS_ADD( delayNs, ns );
+}
+
+/******************************* _flush ************************************/
+/**   Read back MODREG so a posted write has reached the carrier before
+ *    the following delay starts (if enabled in the timing)
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *
+ ***************************************************************************/
+static void _flush( uintptr_t base )
+{
+    if( mm_timing_get()->flush )
+        (void)MREAD_D16( base, MODREG );
+}
+
+/******************************* m_mread ***********************************/
+/**   Read all contents (words 0..15) from EEPROM at 'base'.
+ *
+ *---------------------------------------------------------------------------
+ *  \param addr			\IN base address pointer
+ *  \param buff			\INOUT user buffer (16 words)
+ *  \return   0=ok, 1=error
+ *
+ ****************************************************************************/
+int m_mread( uint8_t *addr, uint16_t  *buff )
+{
+    return m_read_range( (uintptr_t)addr, 0, 16, buff );
+}
+
+/******************************* m_mwrite **********************************/
+/**   Write all contents (words 0..15) into EEPROM at 'base'.
+ *
+ *---------------------------------------------------------------------------
+ *  \param addr		\IN base address pointer
+ *  \param buff		\IN user buffer (16 words)
+ *  \return   0=ok, 1=error
+ *
+ ****************************************************************************/
+int m_mwrite( uint8_t *addr, uint8_t *buff) 
+{
+    register uint8_t    index;
+
+    for(index=0; index<16; index++)
+        if( m_write(addr,index,*buff++) )
+            return 1;
+    return 0;
+}
+
+/******************************* m_write ***********************************/
+/**   Write a specified word into EEPROM at 'base'.
+ *
+ *---------------------------------------------------------------------------
+ *  \param addr			\IN base address pointer
+ *  \param index		\IN index to write (0..15)
+ *  \param data			\IN word to write
+ *  \return   0=ok; 1=write err; 2=verify err
+ *
+ ***************************************************************************/
+int m_write( uint8_t *addr, uint8_t  index, uint16_t data )
+{
+    int err;
+
+    if( mm_lock_take( (uintptr_t)addr ) )               /* slot busy */
+        return 1;
+
+    if( _erase( (uintptr_t)addr, index ))              /* erase cell first */
+        err = 3;
+    else
+        err = _write( (uintptr_t)addr, index, data );
+
+    mm_lock_give( (uintptr_t)addr );
+    return err;
+}
+
+/******************************* _prog_cmd *******************************/
+/**   Run one erase/write instruction and wait for its end.
+ *
+ *    The EEPROM must be write enabled.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param code			\IN instruction (incl. address)
+ *  \param data			\IN data word for WRITE/WRAL
+ *  \param withData		\IN instruction has data
+ *  \param rep			\INOUT report (wait time)
+ *  \return   0=ok 1=timeout
+ *
+ ****************************************************************************/
+static int _prog_cmd( uintptr_t base, uint8_t code, uint16_t data,
+                      int withData, MM_PROG_REPORT *rep )
+{
+    uint64_t t0;
+    int err;
+
+    mm_rt_enter();
+    _opcode(base, code);
+    if( withData )
+        _wave_run( base, G_waveWr, WAVE_WORD, data, 0, NULL );
+    _deselect(base);                        /* start cycle  */
+    mm_rt_leave( _CLK_NS(withData ? 25 : 9) );
+
+    t0 = mm_time_ns();
+    err = _wait_ready(base);
+    t0 = mm_time_ns() - t0;
+    _deselect(base);
+
+    rep->waitNs += t0;
+    if( MM_STATS_ON ) {
+        MM_StatsCur->cycles++;
+        MM_StatsCur->waitNs += t0;
+        if( t0 > MM_StatsCur->waitMaxNs )
+            MM_StatsCur->waitMaxNs = t0;
+    }
+    return err;
+}
+
+/******************************* _prog_cost *******************************/
+/**   Number of erase/write cycles needed to turn one word into another.
+ *---------------------------------------------------------------------------
+ *  \param cur			\IN current word
+ *  \param dst			\IN target word
+ *  \param flags		\IN MM_PROG_xxx flags
+ *  \return   cycles
+ *
+ ****************************************************************************/
+static int _prog_cost( uint16_t cur, uint16_t dst, uint32_t flags )
+{
+    if( cur == dst )
+        return 0;
+    if( dst == 0xffff || (flags & MM_PROG_AUTOERASE) )
+        return 1;                           /* ERASE or WRITE */
+    return 2;                               /* ERASE + WRITE  */
+}
+
+/******************************* m_program *********************************/
+/**   Program an image into the EEPROM at 'base' with as few erase/write
+ *    cycles as possible.
+ *
+ *    - the current contents are read in one sequential read
+ *    - only words that differ are erased/written
+ *    - if cheaper, ERAL (plus WRITE of all non-erased words) or
+ *      ERAL+WRAL (all 64 words equal) is used; words behind the image
+ *      keep their contents
+ *    - the EEPROM stays write enabled for the whole session
+ *    - every cycle is polled with a deadline of T_WP microseconds
+ *    - the result is verified with one sequential read
+ *
+ *    Without MM_PROG_AUTOERASE a word is erased before it is written
+ *    (like m_write() does).
+ *
+ *    ERAL/WRAL are only used by library callers (mm_ctx_program()):
+ *    mm_ident --program runs mm_batch_run(), whose transactions write
+ *    word by word (see mm_xfer.h).
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param image		\IN words to program, starting at word 0
+ *  \param nwords		\IN number of words (1..MM_EE_WORDS)
+ *  \param flags		\IN MM_PROG_xxx flags
+ *  \param rep			\OUT report (may be NULL)
+ *  \return   MM_PROG_OK or MM_PROG_xxx error
+ *
+ ****************************************************************************/
+int m_program( uintptr_t base, const uint16_t *image, int nwords,
+               uint32_t flags, MM_PROG_REPORT *rep )
+{
+    uint16_t cur[MM_EE_WORDS], dst[MM_EE_WORDS], chk[MM_EE_WORDS];
+    MM_PROG_REPORT dummy;
+    uint64_t t0 = mm_time_ns();
+    int i, nread, costWord = 0, costEral, costWral = -1;
+    int keep = 0, nonErased = 0, useEral = 0, useWral = 0, err = MM_PROG_OK;
+
+    if( !rep )
+        rep = &dummy;
+    memset( rep, 0, sizeof(*rep) );
+    rep->nwords  = nwords;
+    rep->badWord = -1;
+
+    if( nwords < 1 || nwords > MM_EE_WORDS )
+        return MM_PROG_PARAM;
+
+    /* EWEN..EWDS must not be interleaved with another programming run */
+    if( mm_lock_take( base ) )
+        return MM_PROG_BUSY;
+
+    /* current contents and per word cost */
+    nread = nwords;
+    if( m_read_range( base, 0, (uint8_t)nread, cur ) ) {
+        err = MM_PROG_BUSY;
+        goto DONE;
+    }
+    for(i=0; i<nwords; i++) {
+        dst[i] = image[i];
+        if( cur[i] != dst[i] )
+            rep->changed++;
+        costWord += _prog_cost( cur[i], dst[i], flags );
+        if( dst[i] != 0xffff )
+            nonErased++;
+    }
+    if( rep->changed == 0 )
+        goto VERIFY;
+
+    /*
+     * ERAL/WRAL affect the whole chip: only worth a look if they can win
+     * even if the rest of the chip is erased already
+     */
+    if( !(flags & MM_PROG_NOCHIP) && 1 + nonErased < costWord ) {
+        if( nwords < MM_EE_WORDS ) {
+            if( m_read_range( base, (uint8_t)nwords,
+                              (uint8_t)(MM_EE_WORDS - nwords),
+                              cur + nwords ) ) {
+                err = MM_PROG_BUSY;
+                goto DONE;
+            }
+            memcpy( dst + nwords, cur + nwords,
+                    (MM_EE_WORDS - nwords) * sizeof(uint16_t) );
+            nread = MM_EE_WORDS;
+        }
+        for(i=nwords, keep=0; i<MM_EE_WORDS; i++)
+            if( dst[i] != 0xffff )
+                keep++;
+        costEral = 1 + nonErased + keep;
+
+        for(i=1; i<MM_EE_WORDS && dst[i] == dst[0]; i++)
+            ;
+        if( i == MM_EE_WORDS )
+            costWral = (flags & MM_PROG_AUTOERASE) ? 1 : 2;
+
+        if( costWral >= 0 && costWral < costWord && costWral <= costEral )
+            useWral = 1;
+        else if( costEral < costWord )
+            useEral = 1;
+    }
+
+    _opcode(base, EWEN);                    /* write enable */
+    _deselect(base);
+
+    if( useWral ) {
+        if( !(flags & MM_PROG_AUTOERASE) ) {
+            rep->eral++;
+            err = _prog_cmd( base, ERAL, 0, 0, rep );
+        }
+        if( !err && dst[0] != 0xffff ) {
+            rep->wral++;
+            err = _prog_cmd( base, WRAL, dst[0], 1, rep );
+        }
+    }
+    else if( useEral ) {
+        rep->eral++;
+        err = _prog_cmd( base, ERAL, 0, 0, rep );
+        for(i=0; i<MM_EE_WORDS && !err; i++) {
+            if( dst[i] == 0xffff )
+                continue;
+            rep->write++;
+            err = _prog_cmd( base, (uint8_t)(_WRITE_+i), dst[i], 1, rep );
+        }
+    }
+    else {
+        for(i=0; i<nwords && !err; i++) {
+            if( cur[i] == dst[i] )
+                continue;
+            if( dst[i] == 0xffff || !(flags & MM_PROG_AUTOERASE) ) {
+                rep->erase++;
+                err = _prog_cmd( base, (uint8_t)(ERASE+i), 0, 0, rep );
+            }
+            if( !err && dst[i] != 0xffff ) {
+                rep->write++;
+                err = _prog_cmd( base, (uint8_t)(_WRITE_+i), dst[i], 1, rep );
+            }
+        }
+    }
+
+    _opcode(base, EWDS);                    /* write disable */
+    _deselect(base);
+
+    if( err ) {
+        err = MM_PROG_TIMEOUT;
+        goto DONE;
+    }
+
+VERIFY:
+    if( m_read_range( base, 0, (uint8_t)nread, chk ) ) {
+        err = MM_PROG_VERIFY;
+        goto DONE;
+    }
+    for(i=0; i<nread; i++) {
+        if( chk[i] != dst[i] ) {
+            rep->badWord = i;
+            err = MM_PROG_VERIFY;
+            break;
+        }
+    }
+
+DONE:
+    mm_lock_give( base );
+    rep->totalNs = mm_time_ns() - t0;
+    return err;
+}
+
+/******************************* m_read ************************************/
+/**   Read a specified word from EEPROM at 'base'.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param index		\IN index to read (0..15)
+ *  \return   read word
+ *
+ ****************************************************************************/
+int m_read( uintptr_t base, uint8_t index )
+{
+    uint16_t    wx;                         /* data word    */
+
+    m_read_range( base, index, 1, &wx );
+    return(wx);
+}
+
+/******************************* m_read_range ******************************/
+/**   Read consecutive words from EEPROM at 'base'.
+ *
+ *    Uses the sequential read of the serial EEPROM: the READ instruction
+ *    is sent once for 'first', then CS stays asserted and the following
+ *    words are clocked out without further start bit and opcode.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param first		\IN index of first word to read
+ *  \param count		\IN number of words (first+count <= MM_EE_WORDS)
+ *  \param buf			\OUT read words
+ *  \return   0=ok, 1=error
+ *
+ ****************************************************************************/
+int m_read_range( uintptr_t base, uint8_t first, uint8_t count, uint16_t *buf )
+{
+    if( count == 0 || first + count > MM_EE_WORDS )
+        return 1;
+
+    return _read_words( base, first, count, buf, 0 ) == MM_PROBE_BUSY;
+}
+
+/******************************* _read_words *******************************/
+/**   Sequential read, optionally with presence probe.
+ *
+ *    With 'probe' DO is sampled at the start bit, where the EEPROM
+ *    doesn't drive it, and after the last address bit, where it drives
+ *    the dummy zero. Without the dummy zero (empty slot, no EEPROM or
+ *    DO stuck high) the read stops there. DO low at the start bit and a
+ *    first word of zero means DO stuck low, the read stops after the
+ *    first word. Words not read are set to the level seen on DO.
+ *    Without 'probe' DO is only read for the data bits.
+ *
+ *    The slot is locked for the read, see mm_lock_take(). If it stays
+ *    busy, nothing is read and the words are set to 0xffff.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param first		\IN index of first word to read
+ *  \param count		\IN number of words (checked by the caller)
+ *  \param buf			\OUT read words
+ *  \param probe		\IN check for the EEPROM
+ *  \return   MM_PROBE_xxx (MM_PROBE_PRESENT or MM_PROBE_BUSY without
+ *            'probe')
+ *
+ ****************************************************************************/
+static int _read_words( uintptr_t base, uint8_t first, uint8_t count,
+                        uint16_t *buf, int probe )
+{
+    uint16_t            wx, hdr;            /* data word, probe samples */
+    int                 n;                  /* counter      */
+    int                 low, dummy, ret = MM_PROBE_PRESENT;
+    uint64_t            t0 = 0;
+
+    if( mm_lock_take( base ) ) {
+        for(n=0; n<count; n++)
+            buf[n] = 0xffff;
+        return MM_PROBE_BUSY;
+    }
+
+    if( MM_STATS_ON )
+        t0 = mm_time_ns();
+
+    /* _opcode(), DO only sampled for the probe */
+    mm_rt_enter();
+    _wave_run( base, _wave_hdr((uint8_t)(_READ_+first)), WAVE_HDR, 0, probe,
+               &hdr );
+    low   = !(hdr & 0x02);                          /* start bit */
+    dummy = hdr & 0x01;                             /* last address bit */
+
+    if( probe && dummy ) {
+        ret = MM_PROBE_EMPTY;
+        n = 0;
+        mm_rt_leave( _CLK_NS(9) );
+    }
+    else {
+        for(n=0; n<count; n++) {
+            if( n )
+                mm_rt_enter();
+            _wave_run( base, G_waveRd, WAVE_WORD, 0, 1, &wx );
+            mm_rt_leave( _CLK_NS(n ? 16 : 25) );
+            buf[n] = wx;
+            if( probe && low && n == 0 && wx == 0 ) {
+                ret = MM_PROBE_STUCK0;
+                n++;
+                break;
+            }
+        }
+    }
+    _deselect(base);
+    mm_lock_give( base );
+
+    if( MM_STATS_ON ) {
+        MM_StatsCur->words  += n;
+        MM_StatsCur->readNs += mm_time_ns() - t0;
+    }
+
+    for( ; n<count; n++)
+        buf[n] = (ret == MM_PROBE_EMPTY) ? 0xffff : 0;
+    return ret;
+}
+
+/******************************* m_read_range_probe ************************/
+/**   m_read_range() with presence probe.
+ *
+ *    See _read_words(): if the EEPROM doesn't answer, the read stops
+ *    early and the words are set to the level seen on DO.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param first		\IN index of first word to read
+ *  \param count		\IN number of words (first+count <= MM_EE_WORDS)
+ *  \param buf			\OUT read words
+ *  \param probe		\OUT MM_PROBE_PRESENT, MM_PROBE_EMPTY, MM_PROBE_STUCK0 or
+ *                      MM_PROBE_BUSY
+ *  \return   0=ok, 1=error (slot busy)
+ *
+ ****************************************************************************/
+int m_read_range_probe( uintptr_t base, uint8_t first, uint8_t count,
+                        uint16_t *buf, int *probe )
+{
+    if( count == 0 || first + count > MM_EE_WORDS )
+        return 1;
+
+    *probe = _read_words( base, first, count, buf, 1 );
+    return *probe == MM_PROBE_BUSY;
+}
+
+/******************************* m_probe ***********************************/
+/**   Check whether an EEPROM answers at 'base'.
+ *
+ *    Clocks in a READ of word 0 and checks DO, see _read_words(). Costs
+ *    10 clocks for empty slots, 26 for present EEPROMs.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \return   MM_PROBE_PRESENT, MM_PROBE_EMPTY, MM_PROBE_STUCK0 or
+ *            MM_PROBE_BUSY
+ *
+ ****************************************************************************/
+int m_probe( uintptr_t base )
+{
+    uint16_t wx;
+
+    return _read_words( base, 0, 1, &wx, 1 );
+}
+
+/******************************* m_instr ***********************************/
+/**   Select the EEPROM and send start bit and instruction.
+ *
+ *    m_instr(), m_data_out(), m_data_in(), m_status() and m_deselect()
+ *    are the steps of the functions above, for transactions driven from
+ *    outside (see mm_xfer.h). CS stays asserted until m_deselect(),
+ *    which also starts an erase/write cycle. The caller does the locking.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param code			\IN instruction (incl. address)
+ *
+ ****************************************************************************/
+void m_instr( uintptr_t base, uint8_t code )
+{
+    _opcode( base, code );
+}
+
+/******************************* m_data_out ********************************/
+/**   Clock a data word into the EEPROM (WRITE, WRAL), MSB first.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param data			\IN data word
+ *
+ ****************************************************************************/
+void m_data_out( uintptr_t base, uint16_t data )
+{
+    _wave_run( base, G_waveWr, WAVE_WORD, data, 0, NULL );
+}
+
+/******************************* m_data_in *********************************/
+/**   Clock the next data word out of the EEPROM (READ).
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \return   data word
+ *
+ ****************************************************************************/
+uint16_t m_data_in( uintptr_t base )
+{
+    uint16_t wx;
+
+    _wave_run( base, G_waveRd, WAVE_WORD, 0, 1, &wx );
+    MM_STATS_ADD( words, 1 );
+    return wx;
+}
+
+/******************************* m_status **********************************/
+/**   Poll the ready/busy status once after an erase/write cycle started.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param select		\IN select the EEPROM first (first poll)
+ *  \return   DO: 0=busy, 1=ready
+ *
+ ****************************************************************************/
+int m_status( uintptr_t base, int select )
+{
+    if( select )
+        _select( base );
+    MM_STATS_ADD( polls, 1 );
+    return _clock( base, 0 ) ? 1 : 0;
+}
+
+/******************************* m_deselect ********************************/
+/**   Deselect the EEPROM, ends the instruction.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *
+ ****************************************************************************/
+void m_deselect( uintptr_t base )
+{
+    _deselect( base );
+}
+
+/******************************* _select_n *********************************/
+/**   Select the EEPROMs of several slots, see _select().
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointers
+ *  \param n			\IN number of slots
+ *
+ ***************************************************************************/
+static void _select_n( const uintptr_t *base, int n )
+{
+    int i;
+
+    for(i=0; i<n; i++)
+        MWRITE_D16( base[i], MODREG, 0 );       /* everything inactive */
+    for(i=0; i<n; i++)
+        MWRITE_D16( base[i], MODREG, B_SEL );   /* select high */
+    for(i=0; i<n; i++)
+        _flush( base[i] );
+    _delay();
+}
+
+/******************************* _clock_n **********************************/
+/**   Clock one bit into the EEPROMs of several slots in lockstep.
+ *
+ *    The clock low writes of all slots share one delay, the clock high
+ *    writes share the next one, then DO of all slots is sampled.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointers
+ *  \param n			\IN number of slots
+ *  \param dbs			\IN data bit to send
+ *  \param dout			\OUT state of DO lines (NULL=don't sample)
+ *
+ ***************************************************************************/
+static void _clock_n( const uintptr_t *base, int n, uint8_t dbs, uint8_t *dout )
+{
+    int i;
+
+    MM_STATS_ADD( clocks, n );
+    for(i=0; i<n; i++)
+        MWRITE_D16( base[i], MODREG, dbs|B_SEL );       /* clock low  */
+    for(i=0; i<n; i++)
+        _flush( base[i] );
+    _delay();
+    for(i=0; i<n; i++)
+        MWRITE_D16( base[i], MODREG, dbs|B_CLK|B_SEL ); /* clock high */
+    for(i=0; i<n; i++)
+        _flush( base[i] );
+    _delay();
+
+    if( dout )
+        for(i=0; i<n; i++)
+            dout[i] = (uint8_t)(MREAD_D16( base[i], MODREG) & B_DAT);
+}
+
+/******************************* m_read_lockstep ***************************/
+/**   Sequential read of the same words from several slots at once.
+ *
+ *    All slots are driven in lockstep from the calling thread, so reading
+ *    n slots takes about as long as reading one.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointers
+ *  \param n			\IN number of slots (1..MM_LOCKSTEP_MAX)
+ *  \param first		\IN index of first word to read
+ *  \param count		\IN number of words (first+count <= MM_EE_WORDS)
+ *  \param buf			\OUT n*count words, slot i at buf[i*count]
+ *  \return   0=ok, 1=error
+ *
+ ****************************************************************************/
+int m_read_lockstep( const uintptr_t *base, int n, uint8_t first,
+                     uint8_t count, uint16_t *buf )
+{
+    return m_read_lockstep_probe( base, n, first, count, buf, NULL );
+}
+
+/******************************* m_read_lockstep_probe *********************/
+/**   Lockstep read with presence probe.
+ *
+ *    Same as m_read_lockstep(), with 'probe' every slot is checked like
+ *    in m_probe(): slots without EEPROM leave the group after the
+ *    instruction, slots with DO stuck low after the first word, so the
+ *    remaining slots need fewer register accesses per clock. All slots
+ *    are locked for the read; if one stays busy, none is read and the
+ *    probe results are MM_PROBE_BUSY.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointers
+ *  \param n			\IN number of slots (1..MM_LOCKSTEP_MAX)
+ *  \param first		\IN index of first word to read
+ *  \param count		\IN number of words (first+count <= MM_EE_WORDS)
+ *  \param buf			\OUT n*count words, slot i at buf[i*count]
+ *  \param probe		\OUT n MM_PROBE_xxx results (NULL=don't probe)
+ *  \return   0=ok, 1=error
+ *
+ ****************************************************************************/
+int m_read_lockstep_probe( const uintptr_t *base, int n, uint8_t first,
+                           uint8_t count, uint16_t *buf, int *probe )
+{
+    uint8_t code = (uint8_t)(_READ_+first);
+    uint8_t dout[MM_LOCKSTEP_MAX], low[MM_LOCKSTEP_MAX];
+    uintptr_t act[MM_LOCKSTEP_MAX];         /* slots still reading */
+    int     idx[MM_LOCKSTEP_MAX];
+    int     i, j, k, w, na;
+    uint64_t t0 = 0, words = 0;
+
+    if( n < 1 || n > MM_LOCKSTEP_MAX ||
+        count == 0 || first + count > MM_EE_WORDS )
+        return 1;
+
+    if( mm_lock_take_n( base, n ) ) {
+        for(j=0; probe && j<n; j++)
+            probe[j] = MM_PROBE_BUSY;
+        return 1;
+    }
+
+    if( MM_STATS_ON )
+        t0 = mm_time_ns();
+
+    mm_rt_enter();
+    _select_n( base, n );
+    _clock_n( base, n, 1, probe ? dout : NULL );    /* start bit */
+    for(j=0; probe && j<n; j++)
+        low[j] = !dout[j];
+    for(i=7; i>=0; i--)
+        _clock_n( base, n, (uint8_t)((code>>i)&0x01),
+                  (probe && i == 0) ? dout : NULL );
+
+    /* dout is the dummy zero now */
+    for(j=0, na=0; j<n; j++) {
+        if( probe ) {
+            probe[j] = dout[j] ? MM_PROBE_EMPTY : MM_PROBE_PRESENT;
+            if( dout[j] ) {
+                for(w=0; w<count; w++)
+                    buf[j*count+w] = 0xffff;
+                _deselect( base[j] );
+                continue;
+            }
+        }
+        idx[na]   = j;
+        act[na++] = base[j];
+    }
+
+    if( !na )
+        mm_rt_leave( _CLK_NS(9) );
+
+    for(w=0; w<count && na; w++) {
+        for(k=0; k<na; k++)
+            buf[idx[k]*count+w] = 0;
+        if( w )
+            mm_rt_enter();
+        for(i=0; i<16; i++) {
+            _clock_n( act, na, 0, dout );
+            for(k=0; k<na; k++)
+                buf[idx[k]*count+w] =
+                    (uint16_t)((buf[idx[k]*count+w]<<1) + dout[k]);
+        }
+        mm_rt_leave( _CLK_NS(w ? 16 : 25) );
+        words += na;
+
+        /* DO stuck low: leave the group */
+        for(k=0; probe && w == 0 && k<na; ) {
+            j = idx[k];
+            if( low[j] && !buf[j*count] ) {
+                probe[j] = MM_PROBE_STUCK0;
+                for(i=1; i<count; i++)
+                    buf[j*count+i] = 0;
+                _deselect( base[j] );
+                idx[k] = idx[--na];
+                act[k] = act[na];
+            }
+            else
+                k++;
+        }
+    }
+
+    for(k=0; k<na; k++)
+        _deselect( act[k] );
+    mm_lock_give_n( base, n );
+
+    if( MM_STATS_ON ) {
+        MM_StatsCur->words  += words;
+        MM_StatsCur->readNs += (mm_time_ns() - t0) * n;
+    }
+    return 0;
+}
+
+/******************************* m_getmodinfo ******************************/
+/**   Get module information.
+ *
+ *                The function reads the magic-id, mod-id, layout-rev and
+ *                product-variant from the EEPROM, evaluates these parameters
+ *                and provide the module information for the caller.
+ *
+ *                1) If the four read values are equal, then we assume that
+ *                   the EEPROM is not present or is invalid.
+ *                   In this case, the function returns with the following
+ *                   parameters:
+ *                   - modtype = 0.
+ *             		 - devid  = 0xffffffff
+ *                   - devrev = 0xffffffff
+ *                   - devname = '\\0'
+ *
+ *                2) If the four read values are different, the function
+ *                   gives the following parameters to the caller:
+ *             		 - devid  = (magic-id   << 16) | mod-id
+ *                   - devrev = (layout-rev << 16) | product-variant
+ *
+ *                2a) If magic-id = 0x5346 the function returns with:
+ *                    - modtype = MODCOM_MOD_MEN
+ *					  - devname = "<prefix><decimal mod-id><suffix>"
+ *					              - if (mod-id & 0xFF00) == 0x5300 then
+ *                                  - prefix="MS"
+ *					              - else
+ *                                  - prefix="M"
+ *					                - if (mod-id & 0xFF00) = 0x7D00 then
+ *                                    - suffix="N"
+ *
+ *                                e.g. M34, MS9, M45N
+ *
+ *                2b) If magic-id <> 0x5346 the function returns with:
+ *                  - modtype = MODCOM_MOD_THIRD
+ *                  - devname = '\\0'
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN	base address pointer
+ *  \param modtype		\OUT module type (0, MODCOM_MOD_MEN, MODCOM_MOD_THIRD)
+ *  \param devid		\OUT device id
+ *  \param devrev		\OUT device revision
+ *  \param devname		\OUT device name
+ *  \return    0=ok, 1=error
+ *
+ ****************************************************************************/
+int m_getmodinfo(
+	uintptr_t base,
+	uint32_t *modtype,
+	uint32_t *devid,
+	uint32_t *devrev,
+	char    *devname )
+{
+	uint16_t words[4];
+
+	return m_getmodinfo_raw( base, words, modtype, devid, devrev, devname );
+}
+
+/******************************* m_getmodinfo_raw **************************/
+/**   Get module information and the id words it is based on.
+ *
+ *                Same as m_getmodinfo(), additionally returns the read
+ *                magic-id, mod-id, layout-rev and product-variant.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN	base address pointer
+ *  \param words		\OUT magic-id, mod-id, layout-rev, product-variant
+ *  \param modtype		\OUT module type (0, MODCOM_MOD_MEN, MODCOM_MOD_THIRD)
+ *  \param devid		\OUT device id
+ *  \param devrev		\OUT device revision
+ *  \param devname		\OUT device name
+ *  \return    0=ok, 1=error
+ *
+ ****************************************************************************/
+int m_getmodinfo_raw(
+	uintptr_t base,
+	uint16_t *words,
+	uint32_t *modtype,
+	uint32_t *devid,
+	uint32_t *devrev,
+	char    *devname )
+{
+	int probe;
+
+	return m_getmodinfo_probe( base, words, &probe, modtype, devid, devrev,
+							   devname );
+}
+
+/******************************* m_getmodinfo_probe ************************/
+/**   Get module information, give up early on empty slots.
+ *
+ *                Same as m_getmodinfo_raw(), but the EEPROM is probed
+ *                while reading word 0 (see m_probe()). If it doesn't
+ *                answer, the remaining words aren't read: the slot is
+ *                reported as M-Module without id-prom (modtype 0), like
+ *                m_getmodinfo() does for the words such a slot returns.
+ *
+ *---------------------------------------------------------------------------
+ *  \param base			\IN	base address pointer
+ *  \param words		\OUT magic-id, mod-id, layout-rev, product-variant
+ *  \param probe		\OUT MM_PROBE_PRESENT, MM_PROBE_EMPTY, MM_PROBE_STUCK0
+ *  \param modtype		\OUT module type (0, MODCOM_MOD_MEN, MODCOM_MOD_THIRD)
+ *  \param devid		\OUT device id
+ *  \param devrev		\OUT device revision
+ *  \param devname		\OUT device name
+ *  \return    0=ok, 1=error
+ *
+ ****************************************************************************/
+int m_getmodinfo_probe(
+	uintptr_t base,
+	uint16_t *words,
+	int      *probe,
+	uint32_t *modtype,
+	uint32_t *devid,
+	uint32_t *devrev,
+	char    *devname )
+{
+	/* both reads in one lock */
+	if( mm_lock_take( base ) ){
+		words[0] = words[1] = words[2] = words[3] = 0xffff;
+		*probe = MM_PROBE_BUSY;
+		m_decode_modinfo( words, modtype, devid, devrev, devname );
+		return 1;
+	}
+
+	/* read data from eeprom, words 0..2 in one sequential read */
+	*probe = _read_words( base, 0, 3, words, 1 );
+	if( *probe != MM_PROBE_PRESENT )
+		words[3] = words[0];
+	else
+		words[3] = (uint16_t)m_read(base, 8);
+	mm_lock_give( base );
+
+	return m_decode_modinfo( words, modtype, devid, devrev, devname );
+}
+
+/******************************* m_modname *********************************/
+/**   Build the name of a MEN M-Module from its mod-id.
+ *
+ *                "<prefix><decimal mod-id><suffix>", see m_getmodinfo().
+ *
+ *---------------------------------------------------------------------------
+ *  \param modid		\IN	mod-id (word 1)
+ *  \param devname		\OUT device name (at least 8 bytes)
+ *
+ ****************************************************************************/
+void m_modname( uint16_t modid, char *devname )
+{
+	uint8_t	addSuffix = FALSE;
+	char	*bufptr = devname;
+
+	*bufptr = 'M';
+	bufptr++;
+
+	/* MSxx M-Module? */
+	if( (modid & 0xFF00) == MOD_ID_MS_MASK ){
+		*bufptr = 'S';
+		bufptr++;
+		modid &= 0x00FF;
+	}
+	/* MxxN M-Module? */
+	else if( (modid & 0xFF00) == MOD_ID_N_MASK ){
+		addSuffix = TRUE;
+		modid &= 0x00FF;
+	}
+
+	/* add modid */
+	_xtoa( modid, 10, bufptr );
+
+	/* MxxN M-Module */
+	if( addSuffix ){
+		bufptr = devname;
+		while( *bufptr != '\0' )
+			bufptr++;
+		*bufptr++ = 'N';
+		*bufptr = '\0';
+	}
+}
+
+/******************************* m_decode_modinfo **************************/
+/**   Evaluate the id words read by m_getmodinfo().
+ *
+ *                See m_getmodinfo() for the rules.
+ *
+ *---------------------------------------------------------------------------
+ *  \param words		\IN	magic-id, mod-id, layout-rev, product-variant
+ *  \param modtype		\OUT module type (0, MODCOM_MOD_MEN, MODCOM_MOD_THIRD)
+ *  \param devid		\OUT device id
+ *  \param devrev		\OUT device revision
+ *  \param devname		\OUT device name
+ *  \return    0=ok, 1=error
+ *
+ ****************************************************************************/
+int m_decode_modinfo(
+	const uint16_t *words,
+	uint32_t *modtype,
+	uint32_t *devid,
+	uint32_t *devrev,
+	char    *devname )
+{
+	uint16_t magic   = words[0];
+	uint16_t modid   = words[1];
+	uint16_t layout  = words[2];
+	uint16_t variant = words[3];
+
+	/* set defaults */
+	*devid   = 0xffffffff;
+	*devrev  = 0xffffffff;
+	*devname = '\0';
+
+	/*------------------------------+
+	| M-Module without id-prom data |
+	+------------------------------*/
+	/*
+	 * If all read data are equal then we assume there is a M-Module
+	 * without id-prom or without valid id-prom data.
+	 */
+	if( (magic  == modid) &&
+		(layout == variant) &&
+		(magic  == layout) ){
+
+		*modtype = 0;
+		return 0;
+	}
+
+	/*------------------------------+
+	| M-Module with id-prom data    |
+	+------------------------------*/
+	else {
+
+		/* build devid and devrev */
+		*devid   = (magic  << 16) | modid;
+		*devrev  = (layout << 16) | variant;
+
+		/*------------------------------+
+		| VITA conform M-Module         |
+		+------------------------------*/
+		/*
+		 * If we got the right magic-id then
+		 * we assume there is a VITA conform M-Module.
+		 */
+		if( magic == MOD_ID_MAGIC ){
+
+			*modtype = MODCOM_MOD_MEN;
+
+			/*
+			 * build device name
+			 */
+			m_modname( modid, devname );
+		}
+
+		/*------------------------------+
+		| other M-Module                |
+		+------------------------------*/
+		/*
+		 * Not the right magic-id
+		 */
+		else{
+			*modtype = MODCOM_MOD_THIRD;
+		}
+	}
+
+	return 0;
+}
+
+
@@ -0,0 +1,162 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_eeprom.h
+ *
+ *      \author  awe
+ *
+ *       \brief  M-Module serial EEPROM definitions and register access
+ *               backend interface shared by mm_ident and its backends.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_EEPROM_H
+#define _MM_EEPROM_H
+
+#include <stdint.h>
+
+/*--- instructions for serial EEPROM ---*/
+#define     _READ_   0x80    		/* read data */
+#define     EWEN     0x30    		/* enable erase/write state */
+#define     ERASE    0xc0    		/* erase cell */
+#define     _WRITE_  0x40    		/* write data */
+#define     ERAL     0x20    		/* chip erase */
+#define     WRAL     0x10    		/* chip write */
+#define     EWDS     0x00    		/* disable erase/write state */
+
+#define     MM_EE_WORDS  64			/* 93C46 size in 16-bit words */
+#define     MM_EE_ADDR_MASK 0x3f	/* address bits of an opcode */
+
+#define     MM_LOCKSTEP_MAX 32		/* max. slots of m_read_lockstep() */
+
+/* bit definition */
+#define B_DAT	0x01			/* data in-;output */
+#define B_CLK	0x02			/* clock */
+#define B_SEL	0x04			/* chip-select */
+
+/* id defines */
+#define MOD_ID_MAGIC	0x5346  	/* M-Module id prom magic word */
+#define MOD_ID_MS_MASK	0x5300		/* mask to indicate MSxx M-Module */
+#define MOD_ID_N_MASK	0x7D00		/* mask to indicate MxxN M-Module */
+
+/* id prom layout (word index) */
+#define MM_EE_MAGIC		0		/* magic-id */
+#define MM_EE_MODID		1		/* mod-id */
+#define MM_EE_LAYOUT	2		/* layout-rev */
+#define MM_EE_VARIANT	8		/* product-variant */
+#define MM_EE_SERIAL_HI	9		/* serial number, high word */
+#define MM_EE_SERIAL_LO	10		/* serial number, low word */
+#define MM_EE_CHKSUM	15		/* CRC-16 of words 0..14, see mm_verify.h */
+
+#define MODCOM_MOD_MEN 1
+#define MODCOM_MOD_THIRD 2
+
+/* A08 register address */
+#define     MODREG  0xfe
+
+/* m_program() flags */
+#define MM_PROG_AUTOERASE	0x01	/* WRITE/WRAL erase by themselves */
+#define MM_PROG_NOCHIP		0x02	/* don't use ERAL/WRAL */
+
+/* m_probe() results */
+#define MM_PROBE_PRESENT	0		/* EEPROM answers */
+#define MM_PROBE_EMPTY		1		/* no dummy zero: empty slot, no EEPROM
+									   or DO stuck high */
+#define MM_PROBE_STUCK0		2		/* DO stuck low */
+#define MM_PROBE_BUSY		3		/* slot locked by another process,
+									   see mm_lock.h */
+
+/* m_program() errors */
+#define MM_PROG_OK			0
+#define MM_PROG_TIMEOUT		1		/* erase/write cycle didn't finish */
+#define MM_PROG_VERIFY		2		/* read back differs */
+#define MM_PROG_PARAM		3		/* invalid image size */
+#define MM_PROG_BUSY		4		/* slot locked by another process */
+
+/** m_program() report */
+typedef struct MM_PROG_REPORT {
+	int      nwords;			/**< image size */
+	int      changed;			/**< words that differed */
+	int      erase;				/**< ERASE instructions */
+	int      write;				/**< WRITE instructions */
+	int      eral;				/**< ERAL instructions */
+	int      wral;				/**< WRAL instructions */
+	int      badWord;			/**< first word failing verify or -1 */
+	uint64_t waitNs;			/**< time spent waiting for ready */
+	uint64_t totalNs;			/**< duration of m_program() */
+} MM_PROG_REPORT;
+
+/** Register access backend.
+ *
+ *  All accesses to the M-Module serial EEPROM interface go through one
+ *  of these. \a base is the value the caller passes to m_read() & co.
+ *  and is interpreted by the backend (mapped address for MMIO, slot
+ *  address for the simulation).
+ */
+typedef struct MM_BUS_OPS {
+	const char *name;										/**< backend name */
+	void     (*write16)( uintptr_t base, uint32_t offset, uint16_t val );
+	uint16_t (*read16)( uintptr_t base, uint32_t offset );
+} MM_BUS_OPS;
+
+/* MMIO access profiles (MM_TIMING.access), see MM_BusAccess */
+#define MM_ACCESS_F204		0		/* 32 bit access at MODREG (F204/F205) */
+#define MM_ACCESS_D16		1		/* 16 bit access at MODREG */
+#define MM_ACCESS_D16_SYNC	2		/* 16 bit access with I/O barriers */
+#define MM_ACCESS_NUM		3
+
+extern const MM_BUS_OPS MM_BusMmio;		/* memory mapped carrier */
+extern const MM_BUS_OPS MM_BusAccess[MM_ACCESS_NUM];	/* per profile */
+extern const MM_BUS_OPS MM_BusSim;		/* simulated EEPROM, see mm_sim.h */
+
+void mm_bus_set( const MM_BUS_OPS *ops );
+const MM_BUS_OPS *mm_bus_get( void );
+int mm_access_find( const char *name );
+
+int m_read( uintptr_t base, uint8_t index );
+int m_read_range( uintptr_t base, uint8_t first, uint8_t count, uint16_t *buf );
+int m_read_range_probe( uintptr_t base, uint8_t first, uint8_t count,
+						uint16_t *buf, int *probe );
+int m_probe( uintptr_t base );
+void m_instr( uintptr_t base, uint8_t code );
+void m_data_out( uintptr_t base, uint16_t data );
+uint16_t m_data_in( uintptr_t base );
+int m_status( uintptr_t base, int select );
+void m_deselect( uintptr_t base );
+int m_write( uint8_t *addr, uint8_t  index, uint16_t data );
+int m_mread( uint8_t *addr, uint16_t  *buff );
+int m_mwrite( uint8_t *addr, uint8_t *buff);
+int m_program( uintptr_t base, const uint16_t *image, int nwords,
+			   uint32_t flags, MM_PROG_REPORT *rep );
+int m_read_lockstep( const uintptr_t *base, int n, uint8_t first,
+					 uint8_t count, uint16_t *buf );
+int m_read_lockstep_probe( const uintptr_t *base, int n, uint8_t first,
+						   uint8_t count, uint16_t *buf, int *probe );
+int m_getmodinfo( uintptr_t base, uint32_t *modtype, uint32_t *devid,
+				  uint32_t *devrev, char *devname );
+int m_getmodinfo_raw( uintptr_t base, uint16_t *words, uint32_t *modtype,
+					  uint32_t *devid, uint32_t *devrev, char *devname );
+int m_getmodinfo_probe( uintptr_t base, uint16_t *words, int *probe,
+						uint32_t *modtype, uint32_t *devid, uint32_t *devrev,
+						char *devname );
+void m_modname( uint16_t modid, char *devname );
+int m_decode_modinfo( const uint16_t *words, uint32_t *modtype,
+					  uint32_t *devid, uint32_t *devrev, char *devname );
+
+#endif /* _MM_EEPROM_H */
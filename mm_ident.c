@@ -8,8 +8,8 @@
  *
  *        \brief Tool to read the M-Module EEPROM.
  *               This is tool is a standalone version of the id library-
- *
- *
+ *               The EEPROM access itself is in libmmident (mm_eeprom.c
+ *               and the other mm_*.c modules), this is the command line.
  *
  *---------------------------------------------------------------------------
  * Copyright 2014-2020, MEN Mikro Elektronik GmbH
@@ -40,552 +40,676 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <getopt.h>
+#include <errno.h>
+#include <signal.h>
+#include "mm_eeprom.h"
+#include "mm_sim.h"
+#include "mm_scan.h"
+#include "mm_pci.h"
+#include "mm_timing.h"
+#include "mm_stats.h"
+#include "mm_daemon.h"
+#include "mm_inv.h"
+#include "mm_trace.h"
+#include "mm_prod.h"
+#include "mm_rt.h"
+#include "mm_query.h"
+#include "mm_lock.h"
+#include "mm_verify.h"
+#include "mm_batch.h"
 
-#define DELAY   20	                /* m_clock's delay time */
-
-/* id defines */
-#define MOD_ID_MAGIC	0x5346  	/* M-Module id prom magic word */
-#define MOD_ID_MS_MASK	0x5300		/* mask to indicate MSxx M-Module */
-#define MOD_ID_N_MASK	0x7D00		/* mask to indicate MxxN M-Module */
-
-/*--- instructions for serial EEPROM ---*/
-#define     _READ_   0x80    		/* read data */
-#define     EWEN     0x30    		/* enable erase/write state */
-#define     ERASE    0xc0    		/* erase cell */
-#define     _WRITE_  0x40    		/* write data */
-#define     ERAL     0x20    		/* chip erase */
-#define     WRAL     0x10    		/* chip write */
-#define     EWDS     0x00    		/* disable erase/write state */
-
-#define     T_WP    10000   		/* max. time required for write/erase (us) */
-
-/* bit definition */
-#define B_DAT	0x01			/* data in-;output */
-#define B_CLK	0x02			/* clock */
-#define B_SEL	0x04			/* chip-select */
-
-/* A08 register address */
-#define     MODREG  0xfe
-
-#define FALSE 0x00
-#define TRUE 0x01
-
-#define MODCOM_MOD_MEN 1
-#define MODCOM_MOD_THIRD 2
-
-#ifndef MAP_32BIT
-#define MAP_32BIT 0x40			/* only give out 32bit addresses */
-#endif
-
-/*--- K&R prototypes ---*/
-static int _write( uint32_t base, uint8_t index, uint16_t data );
-static int _erase( uint32_t base, uint8_t index );
-static void _opcode( uint32_t base, uint8_t code );
-static void _select( uint32_t base );
-static void _deselect( uint32_t base );
-static int _clock( uint32_t base, uint8_t dbs );
-static void _delay( void );
-static void _xtoa( uint32_t val, uint32_t radix, char *buf );
-static void MWRITE_D16(uint32_t base, uint32_t offset, uint16_t val);
-static uint16_t MREAD_D16(uint32_t base, uint32_t offset);
-int m_read( uint32_t base, uint8_t index );
-int m_write( uint8_t *addr, uint8_t  index, uint16_t data );
 int is_kernel_locked_down();
 
-/******************************* _xtoa *************************************/
-/**   Converts an u_int32 to a character string.
- *
- *---------------------------------------------------------------------------
- *  \param radix		\IN	base to convert into
- *  \param val			\IN	number to be converted
- *  \param buf			\IN	ptr to buffer to place result
- *	\param buf			\OUT computed string
- *  Globals....:  ---
- ****************************************************************************/
-static void _xtoa( uint32_t val, uint32_t radix, char *buf )
-{
-	char	*p;           /* pointer to traverse string */
-    char	*firstdig;    /* pointer to first digit */
-    char	temp;         /* temp char */
-    uint32_t digval;       /* value of digit */
-
-    p = buf;
-
-	/* save pointer to first digit */
-    firstdig = p;
-
-    do {
-        digval = (uint32_t) (val % radix);
-        val /= radix; /* get next digit */
-
-        /* convert to ascii and store */
-        if (digval > 9)
-            *p++ = (char) (digval - 10 + 'a');  /* a letter */
-        else
-            *p++ = (char) (digval + '0');       /* a digit */
-    } while (val > 0);
-
-    /* terminate string; p points to last digit */
-    *p-- = '\0';
-
-    /* reverse buffer */
-    do {
-        temp = *p;
-        *p = *firstdig;
-        *firstdig = temp;   /* swap *p and *firstdig */
-        --p;
-        ++firstdig;         /* advance to next two digits */
-    } while (firstdig < p); /* repeat until halfway */
-}
+#define STATS_TEXT	1				/* --stats output formats */
+#define STATS_JSON	2
 
-/******************************* _write ***********************************/
-/**   Write a specified word into EEPROM at 'base'.
- *
- *---------------------------------------------------------------------------
- *	\param base			\IN base address pointer
- *	\param index		\IN index to write (0..63)
- *  \param data			\IN word to write
- *  \return   0=ok 1=write err 2=verify err
- *
- ***************************************************************************/
-static int _write( uint32_t base, uint8_t index, uint16_t data )
-{
-    register int    i,j;                    /* counters     */
-
-    _opcode(base,EWEN);                     /* write enable */
-    _deselect(base);                        /* deselect     */
-
-    _opcode(base, (uint8_t)(_WRITE_+index) );             /* select write */
-    for(i=15; i>=0; i--)
-        _clock(base,(uint8_t)((data>>i)&0x01));        /* write data   */
-    _deselect(base);                        /* deselect     */
-
-    _select(base);
-    for(i=T_WP; i>0; i--)                   /* wait for low */
-    {   if(!_clock(base,0))
-            break;
-        _delay();
-    }
-    for(j=T_WP; j>0; j--)                   /* wait for high*/
-    {   if(_clock(base,0))
-            break;
-        _delay();
-    }
-
-    _opcode(base, EWDS);                    /* write disable*/
-    _deselect(base);                        /* disable      */
-
-    if((i==0) || (j==0))                    /* error ?      */
-        return 1;                           /* ..yes */
-
-    if( data != m_read(base,index) )        /* verify data  */
-        return 2;                           /* ..error      */
-
-    return 0;                               /* ..no         */
-}
+#define FORMAT_MODPROBE	1			/* --format output modes */
+#define FORMAT_DSC		2
 
-/******************************* _erase ***********************************/
-/**   Erase a specified word into EEPROM
- *
- *---------------------------------------------------------------------------
- *	\param base			\IN base address pointer
- *	\param index		\IN index to write (0..15)
- *  \return   0=ok 1=error
- *
- ***************************************************************************/
-static int _erase( uint32_t base, uint8_t index )
+static volatile sig_atomic_t G_stop;	/* daemon: terminate */
+
+void usage()
 {
-    register int    i,j;                    /* counters     */
-
-    _opcode(base,EWEN);                     /* erase enable */
-    for(i=0;i<4;i++) _clock(base,0);
-    _deselect(base);                        /* deselect     */
-
-    _opcode(base,(uint8_t)(ERASE+index) );              /* select erase */
-    _deselect(base);                        /* deselect     */
-
-    _select(base);
-    for(i=T_WP; i>0; i--)                   /* wait for low */
-    {   if(!_clock(base,0))
-            break;
-        _delay();
-    }
-
-    for(j=T_WP; j>0; j--)                   /* wait for high*/
-    {   if(_clock(base,0))
-            break;
-        _delay();
-    }
-
-    _opcode(base,EWDS);                     /* erase disable*/
-    _deselect(base);                        /* disable      */
-
-    if((i==0) || (j==0))                    /* error ?      */
-        return 1;
-    return 0;
+	printf("--------------------------------------------\n");
+	printf("mm_ident [options] <addr> [<addr>...]	    \n");
+	printf("  <addr> - MM-Module Addresse (BAR + Offset)\n");
+	printf("           '-' reads addresses from stdin\n");
+	printf("Options:\n");
+	printf("  -c, --carrier=<bar>   scan all slots of an F204/F205\n");
+	printf("                        with BAR <bar> (repeatable)\n");
+	printf("  -d, --discover        scan all known carriers found in\n");
+	printf("                        sysfs, map them via resource files\n");
+	printf("  --sysfs=<dir>         sysfs mount point (default /sys)\n");
+	printf("  -j, --jobs=<n>        identify up to <n> slots in parallel\n");
+	printf("  --per-carrier=<n>     max. parallel slots per carrier (1)\n");
+	printf("  --lockstep            bit-bang all slots of a carrier together\n");
+	printf("                        from one thread\n");
+	printf("  --bit-ns=<ns>         half bit period (default %d ns)\n",
+		   MM_HALF_NS_DEFAULT);
+	printf("  --no-flush            don't read back MODREG after writes\n");
+	printf("  --access=<profile>    MODREG access: f204 (32 bit, default\n");
+	printf("                        and for discovered F204/F205), d16\n");
+	printf("                        (16 bit), d16-sync (16 bit, barriers)\n");
+	printf("  --verify              detect read errors (checksum word or\n");
+	printf("                        second read), re-read failing words\n");
+	printf("                        slower; identifies at %d ns, other\n",
+		   MM_VERIFY_HALF_NS);
+	printf("                        accesses keep the safe period\n");
+	printf("  --autotune            find the fastest reliable bit period\n");
+	printf("                        of every slot and use it\n");
+	printf("  --cache[=<file>]      store results in a cache file\n");
+	printf("                        (default %s)\n", MM_CACHE_FILE);
+	printf("  --fast                take cached results if the mod-id\n");
+	printf("                        word still matches (implies --cache)\n");
+	printf("  --program=<file>      program image <file> into every slot\n");
+	printf("                        before identification (only words\n");
+	printf("                        that differ are written); all slots\n");
+	printf("                        are programmed at the same time\n");
+	printf("  --autoerase           EEPROM erases on WRITE by itself\n");
+	printf("  --serial=<n>[,<n>..]  program serial numbers into words 9\n");
+	printf("                        and 10: counting up from <n>, or one\n");
+	printf("                        of the list per slot\n");
+	printf("  --report=<file>       write a CSV pass/fail report of the\n");
+	printf("                        programmed slots\n");
+	printf("  --daemon[=<socket>]   keep running and answer queries on\n");
+	printf("                        a Unix socket (default %s)\n",
+		   MM_DAEMON_SOCK);
+	printf("  --interval=<ms>       daemon: re-probe interval (%d ms)\n",
+		   MM_DAEMON_INTERVAL_MS);
+	printf("  --full-every=<n>      daemon: read the complete id every\n");
+	printf("                        n-th probe, else magic/mod-id (%d)\n",
+		   MM_DAEMON_FULL_EVERY);
+	printf("  --inventory[=<file>]  publish the results as binary table\n");
+	printf("                        (default %s), the daemon\n",
+		   MM_INV_FILE);
+	printf("                        keeps it up to date\n");
+	printf("  --format=<mode>       print driver setup instead of the id:\n");
+	printf("                        modprobe: kernel modules to load\n");
+	printf("                        dsc: MDIS device descriptors\n");
+	printf("  --query=<fields>      print only these fields, reading only\n");
+	printf("                        the words they need: magic,modid,\n");
+	printf("                        layout,variant,serial,type,name,raw\n");
+	printf("                        or all\n");
+	printf("  --no-lock             don't lock the slots against other\n");
+	printf("                        processes while accessing them\n");
+	printf("  --lock-timeout=<ms>   max. wait for a slot locked by\n");
+	printf("                        another process (%d ms)\n",
+		   MM_LOCK_TIMEOUT_MS);
+	printf("  --rt[=<prio>]         real-time mode: lock memory, run word\n");
+	printf("                        transfers with SCHED_FIFO <prio> (%d,\n",
+		   MM_RT_PRIO_DEFAULT);
+	printf("                        0=don't raise), report preemptions\n");
+	printf("  --rt-cpu=<n>          real-time mode: run on CPU <n>\n");
+	printf("  --stats[=json]        report bus counters and phase\n");
+	printf("                        timings (text or JSON)\n");
+	printf("  --trace=<file>        record all MODREG accesses into <file>\n");
+	printf("  --vcd=<file>          record all MODREG accesses as VCD\n");
+	printf("  --trace-size=<n>      trace ring buffer size (%d events)\n",
+		   MM_TRACE_EVENTS);
+	printf("  --replay=<file>       answer accesses from a trace recorded\n");
+	printf("                        with --trace instead of the hardware\n");
+	printf("  --sim-tpd=<ns>        clock to DO delay of the simulation\n");
+	printf("  --sim-busy=<us>       erase/write cycle time of the\n");
+	printf("                        simulation (default %d us)\n",
+		   MM_SIM_BUSY_US);
+	printf("  -s, --sim[=<file>]    use a simulated EEPROM at <addr>\n");
+	printf("                        (default contents: M72, or image\n");
+	printf("                        <file> with one hex word per entry)\n");
+	printf("  --sim-fault=<list>    inject faults into the simulation:\n");
+	printf("                        stuck0,stuck1,nodummy,busystuck,\n");
+	printf("                        nowrite,flip=<word>:<mask>[:<count>]\n");
+	printf("--------------------------------------------\n");
 }
 
-/******************************* _opcode ***********************************/
-/**   Output opcode with leading startbit
- *
+static const char *G_progErr[] = { "ok", "timeout", "verify error",
+								   "bad image", "slot busy" };
+
+/******************************* write_report ******************************/
+/**   Write the programming result of every slot as CSV.
  *---------------------------------------------------------------------------
- *	\param base			\IN base address pointer
- *	\param code			\IN opcode to write
+ *  \param scan			\IN slots
+ *  \param path			\IN file
+ *  \return 0=ok, 1=error
  *
- ***************************************************************************/
-static void _opcode( uint32_t base, uint8_t code )
+ ****************************************************************************/
+static int write_report( const MM_SCAN *scan, const char *path )
 {
-    register int i;
-    _select(base);
-    _clock(base,1);                         /* output start bit */
+	const MM_SCAN_SLOT *slot;
+	FILE *fp;
+	int i, err;
 
-    for(i=7; i>=0; i--)
-        _clock(base,(uint8_t)((code>>i)&0x01) );        /* output instruction code  */
+	if (!(fp = fopen(path, "w")))
+		return 1;
+
+	fprintf(fp, "phys,carrier,pci,slot,serial,result,error,changed,erase,"
+			"write,bad_word,us\n");
+	for (i = 0; i < scan->nslots; i++) {
+		slot = &scan->slot[i];
+		fprintf(fp, "0x%08llx,%s,%s,%d,", (unsigned long long)slot->phys,
+				slot->carrier >= 0 ? scan->carrier[slot->carrier].type : "",
+				slot->carrier >= 0 ? scan->carrier[slot->carrier].pci : "",
+				slot->slotNo);
+		if (!slot->programmed) {
+			fprintf(fp, ",fail,not mapped,,,,,\n");
+			continue;
+		}
+		fprintf(fp, "%u,%s,%s,%d,%d,%d,%d,%llu\n", slot->serial,
+				slot->progErr ? "fail" : "pass", G_progErr[slot->progErr],
+				slot->progRep.changed, slot->progRep.erase,
+				slot->progRep.write, slot->progRep.badWord,
+				(unsigned long long)(slot->progRep.totalNs / 1000));
+	}
+
+	err = ferror(fp);
+	return (fclose(fp) || err) ? 1 : 0;
 }
 
-/******************************* _select ***********************************/
-/**   Select EEPROM:
- *                 output DI/CLK/CS low
- *                 delay
- *                 output CS high
- *                 delay
+/******************************* program_slots *****************************/
+/**   Program all mapped slots at once and print the result.
  *---------------------------------------------------------------------------
- *  \param base			\IN base address pointer
+ *  \param scan			\IN slots
+ *  \param b			\IN image template and serial numbers
+ *  \param report		\IN CSV report file or NULL
+ *  \return 0=ok, 1=at least one slot failed
  *
- ***************************************************************************/
-static void _select( uint32_t base )
+ ****************************************************************************/
+static int program_slots( MM_SCAN *scan, const MM_BATCH *b,
+						  const char *report )
 {
-    MWRITE_D16( base, MODREG, 0 );			/* everything inactive */
-    MWRITE_D16( base, MODREG, B_SEL );		/* select high */
-    _delay();
+	MM_SCAN_SLOT *slot;
+	uint64_t t0 = mm_time_ns();
+	int i, n = 0, failed, ret = 0;
+
+	if ((failed = mm_batch_run(scan, b)) < 0) {
+		printf(errno == EINVAL ? "Not enough serial numbers or image too "
+			   "short for the serial number\n" : "Can't program: %s\n",
+			   strerror(errno));
+		return 1;
+	}
+
+	for (i = 0; i < scan->nslots; i++) {
+		slot = &scan->slot[i];
+		if (!slot->programmed)
+			continue;
+		n++;
+
+		printf("0x%08llx: Program: %s, changed %d/%d, erase %d, write %d",
+			   (unsigned long long)slot->phys, G_progErr[slot->progErr],
+			   slot->progRep.changed, slot->progRep.nwords,
+			   slot->progRep.erase, slot->progRep.write);
+		if (b->serialWord >= 0)
+			printf(", serial %u", slot->serial);
+		if (slot->progErr == MM_PROG_VERIFY)
+			printf(", word %d", slot->progRep.badWord);
+		printf(", %llu us\n",
+			   (unsigned long long)(slot->progRep.totalNs / 1000));
+	}
+	printf("Programmed %d slots in %llu us, %d failed\n",
+		   n, (unsigned long long)((mm_time_ns() - t0) / 1000),
+		   failed);
+	if (failed)
+		ret = 1;
+
+	if (report && write_report(scan, report)) {
+		printf("Can't write report %s\n", report);
+		ret = 1;
+	}
+	return ret;
 }
 
-/******************************* _deselect *********************************/
-/**   Deselect EEPROM
- *                 output CS low
+/******************************* sig_stop **********************************/
+/**   SIGINT/SIGTERM handler of the daemon.
  *---------------------------------------------------------------------------
- *  \param base			\IN base address pointer
+ *  \param sig			\IN signal
  *
- ***************************************************************************/
-static void _deselect( uint32_t base )
+ ****************************************************************************/
+static void sig_stop( int sig )
 {
-    MWRITE_D16( base, MODREG, 0 );			/* everything inactive */
+	(void)sig;
+	G_stop = 1;
 }
 
-
-/******************************* MWRITE_D16 *********************************/
-/**   Write 16bit value to a memory address.
+/******************************* print_hist ********************************/
+/**   Print a latency histogram.
  *---------------------------------------------------------------------------
- *  \param base			\IN base address pointer
- *  \param offset		\IN memory offset
- *  \param val			\IN value to write to the memory are
+ *  \param name			\IN name
+ *  \param h			\IN histogram
+ *  \param fmt			\IN STATS_TEXT or STATS_JSON
+ *  \param sep			\IN JSON: separator to print first
  *
- ***************************************************************************/
-static void MWRITE_D16(uint32_t base, uint32_t offset, uint16_t val)
+ ****************************************************************************/
+static void print_hist( const char *name, const MM_HIST *h, int fmt,
+						const char *sep )
 {
-	uint32_t *addr;
-	
-	addr = (uint32_t*)(uintptr_t)(base + offset);
-	*addr = val;
+	int b, first = 1;
+
+	if (fmt == STATS_JSON) {
+		printf("%s\"%s\": { \"n\": %u, \"min_us\": %llu, \"avg_us\": %llu, "
+			   "\"max_us\": %llu, \"buckets\": [", sep, name, h->n,
+			   (unsigned long long)h->minUs,
+			   (unsigned long long)(h->n ? h->sumUs / h->n : 0),
+			   (unsigned long long)h->maxUs);
+		for (b = 0; b < MM_HIST_BUCKETS; b++) {
+			if (!h->bucket[b])
+				continue;
+			printf("%s{ \"lo_us\": %llu, \"n\": %u }", first ? " " : ", ",
+				   b ? 1ULL << b : 0ULL, h->bucket[b]);
+			first = 0;
+		}
+		printf(" ] }");
+		return;
+	}
 
+	if (!h->n)
+		return;
+	printf("%s latency: n %u, min %llu us, avg %llu us, max %llu us\n",
+		   name, h->n, (unsigned long long)h->minUs,
+		   (unsigned long long)(h->sumUs / h->n),
+		   (unsigned long long)h->maxUs);
+	for (b = 0; b < MM_HIST_BUCKETS; b++) {
+		if (h->bucket[b])
+			printf("  %10llu .. %10llu us: %u\n",
+				   b ? 1ULL << b : 0ULL, (2ULL << b) - 1, h->bucket[b]);
+	}
 }
 
-/******************************* MREAD_D16 *********************************/
-/**   Read a 16bit value from a memory address.
+/******************************* print_verify ******************************/
+/**   Print how the id of a slot was validated.
  *---------------------------------------------------------------------------
- *  \param base			\IN base address pointer
- *  \param offset		\IN memory offset
- * 
- *  \return value read from the memory address
- ***************************************************************************/
-static uint16_t MREAD_D16(uint32_t base, uint32_t offset)
+ *  \param slot			\IN slot
+ *  \param pre			\IN text before
+ *  \param post			\IN text after
+ *
+ ****************************************************************************/
+static void print_verify( const MM_SCAN_SLOT *slot, const char *pre,
+						  const char *post )
 {
-	uint32_t *value;
+	const MM_VERIFY_CNT *v = &slot->verify;
 
-	value = (uint32_t*)(uintptr_t)(base + offset);
-	return (uint16_t)*value;
+	printf("%sVerify: %s, %u errors, %u retries%s", pre,
+		   v->chkOk ? "checksum" : v->reread ? "reread" : "probe",
+		   v->errors, v->retries, post);
 }
 
-/******************************* _clock ***********************************/
-/**   Output data bit:
- *                 output clock low
- *                 output data bit
- *                 delay
- *                 output clock high
- *                 delay
- *                 return state of data serial eeprom's DO - line
- *                 (Note: keep CS asserted)
+/******************************* print_stats *******************************/
+/**   Print counters and phase timings of all slots.
+ *
+ *    In scan mode (more than one slot) latency histograms across the
+ *    slots are added.
  *---------------------------------------------------------------------------
- *  \param base			\IN base address pointer
- *	\param dbs			\IN	data bit to send
- *  \return state of DO line
+ *  \param scan			\IN slots
+ *  \param fmt			\IN STATS_TEXT or STATS_JSON
+ *  \param totalNs		\IN run time of mm_ident
  *
- ***************************************************************************/
-static int _clock( uint32_t base, uint8_t dbs )
+ ****************************************************************************/
+static void print_stats( MM_SCAN *scan, int fmt, uint64_t totalNs )
 {
-    MWRITE_D16( base, MODREG, dbs|B_SEL );  /* output clock low */
-                                            /* output data high/low */
-    _delay();                               /* delay    */
+	MM_HIST hIdent, hWord, hWait;
+	MM_STATS sum, *st;
+	int i, n = 0;
+
+	memset(&sum, 0, sizeof(sum));
+	mm_hist_init(&hIdent);
+	mm_hist_init(&hWord);
+	mm_hist_init(&hWait);
+
+	if (fmt == STATS_JSON)
+		printf("{ \"total_us\": %llu, \"map_us\": %llu, \"bus\": \"%s\", "
+			   "\"slots\": [",
+			   (unsigned long long)(totalNs / 1000),
+			   (unsigned long long)(scan->mapNs / 1000), mm_bus_get()->name);
+	else
+		printf("Stats: total %llu us, map %llu us, bus %s\n",
+			   (unsigned long long)(totalNs / 1000),
+			   (unsigned long long)(scan->mapNs / 1000), mm_bus_get()->name);
+
+	for (i = 0; i < scan->nslots; i++) {
+		st = &scan->slot[i].stats;
+		if (!scan->slot[i].mapped)
+			continue;
+		mm_stats_add(&sum, st);
+		if (st->identNs)
+			mm_hist_add(&hIdent, st->identNs);
+		if (st->words)
+			mm_hist_add(&hWord, st->readNs / st->words);
+		if (st->cycles)
+			mm_hist_add(&hWait, st->waitMaxNs);
+
+		if (fmt == STATS_JSON) {
+			printf("%s\n  { \"addr\": \"0x%08llx\", \"ident_us\": %llu, "
+				   "\"tune_us\": %llu, \"prog_us\": %llu, \"words\": %llu, "
+				   "\"word_ns\": %llu, \"reads\": %llu, \"writes\": %llu, "
+				   "\"clocks\": %llu, \"delays\": %llu, \"delay_us\": %llu, "
+				   "\"polls\": %llu, \"cycles\": %llu, \"wait_us\": %llu, "
+				   "\"wait_max_us\": %llu, \"cached\": %d }",
+				   n++ ? "," : "", (unsigned long long)scan->slot[i].phys,
+				   (unsigned long long)(st->identNs / 1000),
+				   (unsigned long long)(st->tuneNs / 1000),
+				   (unsigned long long)(st->progNs / 1000),
+				   (unsigned long long)st->words,
+				   (unsigned long long)(st->words ? st->readNs / st->words : 0),
+				   (unsigned long long)st->reads,
+				   (unsigned long long)st->writes,
+				   (unsigned long long)st->clocks,
+				   (unsigned long long)st->delays,
+				   (unsigned long long)(st->delayNs / 1000),
+				   (unsigned long long)st->polls,
+				   (unsigned long long)st->cycles,
+				   (unsigned long long)(st->waitNs / 1000),
+				   (unsigned long long)(st->waitMaxNs / 1000),
+				   scan->slot[i].cached);
+			continue;
+		}
+
+		printf("0x%08llx: ident %llu us, tune %llu us, prog %llu us%s\n",
+			   (unsigned long long)scan->slot[i].phys,
+			   (unsigned long long)(st->identNs / 1000),
+			   (unsigned long long)(st->tuneNs / 1000),
+			   (unsigned long long)(st->progNs / 1000),
+			   scan->slot[i].cached ? " (cached)" : "");
+		printf("            %llu words (%llu ns/word), %llu reads, %llu writes,"
+			   " %llu clocks\n",
+			   (unsigned long long)st->words,
+			   (unsigned long long)(st->words ? st->readNs / st->words : 0),
+			   (unsigned long long)st->reads,
+			   (unsigned long long)st->writes,
+			   (unsigned long long)st->clocks);
+		printf("            %llu delays (%llu us), %llu polls, %llu cycles"
+			   " (wait %llu us, max %llu us)\n",
+			   (unsigned long long)st->delays,
+			   (unsigned long long)(st->delayNs / 1000),
+			   (unsigned long long)st->polls,
+			   (unsigned long long)st->cycles,
+			   (unsigned long long)(st->waitNs / 1000),
+			   (unsigned long long)(st->waitMaxNs / 1000));
+	}
 
-    MWRITE_D16( base, MODREG, dbs|B_CLK|B_SEL );  /* output clock high */
-    _delay();                               /* delay    */
+	if (fmt == STATS_JSON) {
+		printf(" ],\n  \"sum\": { \"reads\": %llu, \"writes\": %llu, "
+			   "\"clocks\": %llu, \"delay_us\": %llu, \"polls\": %llu, "
+			   "\"wait_us\": %llu },\n  \"hist\": { ",
+			   (unsigned long long)sum.reads,
+			   (unsigned long long)sum.writes,
+			   (unsigned long long)sum.clocks,
+			   (unsigned long long)(sum.delayNs / 1000),
+			   (unsigned long long)sum.polls,
+			   (unsigned long long)(sum.waitNs / 1000));
+		print_hist("ident", &hIdent, fmt, "");
+		print_hist("word", &hWord, fmt, ",\n    ");
+		print_hist("wait", &hWait, fmt, ",\n    ");
+		printf(" } }\n");
+		return;
+	}
 
-    return( MREAD_D16( base, MODREG) & B_DAT );  /* get data */
+	if (scan->nslots > 1) {
+		printf("Sum: %llu reads, %llu writes, %llu clocks, delay %llu us,"
+			   " %llu polls, wait %llu us\n",
+			   (unsigned long long)sum.reads,
+			   (unsigned long long)sum.writes,
+			   (unsigned long long)sum.clocks,
+			   (unsigned long long)(sum.delayNs / 1000),
+			   (unsigned long long)sum.polls,
+			   (unsigned long long)(sum.waitNs / 1000));
+		print_hist("Identify", &hIdent, fmt, "");
+		print_hist("Word read", &hWord, fmt, "");
+		print_hist("Erase/write", &hWait, fmt, "");
+	}
 }
 
-/******************************* _delay ************************************/
-/**   Delay (at least) one microsecond
+/******************************* slot_board ********************************/
+/**   Board index and slot number of a slot for MDIS descriptors.
  *---------------------------------------------------------------------------
+ *  \param slot			\IN slot
+ *  \param devSlot		\OUT slot number on the carrier
+ *  \return board index (1..n)
  *
- ***************************************************************************/
-static void _delay( void )
+ ****************************************************************************/
+static int slot_board( const MM_SCAN_SLOT *slot, int *devSlot )
 {
-    register volatile int i,n;
-
-    for(i=DELAY; i>0; i--)
-        n=10*10;
-
-    (void)n;
+	if (slot->carrier >= 0) {
+		*devSlot = slot->slotNo;
+		return slot->carrier + 1;
+	}
+	*devSlot = (slot->phys & 0xfff) == MM_F204_SLOT1;
+	return slot->map + 1;
 }
 
-/******************************* m_mread ***********************************/
-/**   Read all contents (words 0..15) from EEPROM at 'base'.
+/******************************* print_format ******************************/
+/**   Print the driver setup of all slots.
  *
+ *    FORMAT_MODPROBE prints a modprobe line per driver needed, FORMAT_DSC
+ *    a minimal MDIS device descriptor per slot. Slots without known
+ *    product get a comment line.
  *---------------------------------------------------------------------------
- *  \param addr			\IN base address pointer
- *  \param buff			\INOUT user buffer (16 words)
- *  \return   0=ok, 1=error
+ *  \param scan			\IN identified slots
+ *  \param fmt			\IN FORMAT_MODPROBE or FORMAT_DSC
+ *  \return 0=ok, 1=at least one slot failed
  *
  ****************************************************************************/
-int m_mread( uint8_t *addr, uint16_t  *buff )
+static int print_format( MM_SCAN *scan, int fmt )
 {
+	const MM_PROD **prod;
+	MM_SCAN_SLOT *slot;
+	char devName[32], *p;
+	int i, j, n, board, devSlot, ret = 0;
 
-    register uint8_t    index;
+	if (!(prod = calloc(scan->nslots + 1, sizeof(*prod))))
+		return 1;
 
-    for(index=0; index<16; index++)
-        *buff++ = (uint8_t)m_read( (uint32_t)(uintptr_t)addr, index);
-    return 0;
-}
+	for (i = 0; i < scan->nslots; i++) {
+		slot = &scan->slot[i];
+		if (!slot->mapped || slot->err) {
+			printf("# 0x%08llx: %s\n", (unsigned long long)slot->phys,
+				   slot->mapped ? "Error reading modinfo" : "Can't map slot");
+			ret = 1;
+		}
+		else if (!(prod[i] = mm_prod_find(slot->words)))
+			printf("# 0x%08llx: %s\n", (unsigned long long)slot->phys,
+				   slot->probe != MM_PROBE_PRESENT ? "empty" :
+				   slot->modtype == MODCOM_MOD_MEN ? slot->devname :
+				   "no MEN M-Module");
+	}
 
-/******************************* m_mwrite **********************************/
-/**   Write all contents (words 0..15) into EEPROM at 'base'.
- *
- *---------------------------------------------------------------------------
- *  \param addr		\IN base address pointer
- *  \param buff		\IN user buffer (16 words)
- *  \return   0=ok, 1=error
- *
- ****************************************************************************/
-int m_mwrite( uint8_t *addr, uint8_t *buff) 
-{
-    register uint8_t    index;
+	for (i = 0; i < scan->nslots; i++) {
+		if (!prod[i])
+			continue;
+		slot  = &scan->slot[i];
+		board = slot_board(slot, &devSlot);
+
+		if (fmt == FORMAT_MODPROBE) {
+			printf("# 0x%08llx: %s, %s\n", (unsigned long long)slot->phys,
+				   prod[i]->name, prod[i]->desc);
+			for (j = 0; j < i && prod[j] != prod[i] &&
+				 (!prod[j] || strcmp(prod[j]->driver, prod[i]->driver)); j++)
+				;
+			if (j == i)
+				printf("modprobe %s\n", prod[i]->driver);
+			continue;
+		}
+
+		if (!prod[i]->dsc) {
+			printf("# 0x%08llx: %s, native driver %s (no descriptor)\n",
+				   (unsigned long long)slot->phys, prod[i]->name,
+				   prod[i]->driver);
+			continue;
+		}
 
-    for(index=0; index<16; index++)
-        if( m_write(addr,index,*buff++) )
-            return 1;
-    return 0;
+		/* device name: lower case product name and instance number */
+		for (j = 0, n = 1; j < i; j++)
+			n += (prod[j] == prod[i]);
+		snprintf(devName, sizeof(devName), "%s_%d", prod[i]->name, n);
+		for (p = devName; *p; p++)
+			if (*p >= 'A' && *p <= 'Z')
+				*p = (char)(*p - 'A' + 'a');
+
+		printf("# 0x%08llx: %s, %s (template %s, driver %s)\n",
+			   (unsigned long long)slot->phys, prod[i]->name, prod[i]->desc,
+			   prod[i]->dsc, prod[i]->driver);
+		printf("%s {\n", devName);
+		printf("    DESC_TYPE   = U_INT32  1\n");
+		printf("    HW_TYPE     = STRING   %s\n", prod[i]->name);
+		printf("    BOARD_NAME  = STRING   board_%d\n", board);
+		printf("    DEVICE_SLOT = U_INT32  %d\n", devSlot);
+		printf("}\n");
+	}
+	free(prod);
+	return ret;
 }
 
-/******************************* m_write ***********************************/
-/**   Write a specified word into EEPROM at 'base'.
- *
+/******************************* print_query *******************************/
+/**   Print the fields queried with --query, one line per slot.
  *---------------------------------------------------------------------------
- *  \param addr			\IN base address pointer
- *  \param index		\IN index to write (0..15)
- *  \param data			\IN word to write
- *  \return   0=ok; 1=write err; 2=verify err
+ *  \param scan			\IN queried slots
+ *  \param single		\IN single slot, no address prefix
+ *  \return 0=ok, 1=at least one slot failed
  *
- ***************************************************************************/
-int m_write( uint8_t *addr, uint8_t  index, uint16_t data )
+ ****************************************************************************/
+static int print_query( MM_SCAN *scan, int single )
 {
-    if( _erase( (uint32_t)(uintptr_t)addr, index ))              /* erase cell first */
-        return 3;
+	MM_SCAN_SLOT *slot;
+	const MM_QUERY_RES *res;
+	const char *sep;
+	int i, j, ret = 0;
+
+	for (i = 0; i < scan->nslots; i++) {
+		slot = &scan->slot[i];
+		res  = &slot->qres;
+		sep  = "";
+
+		if (!single)
+			printf("0x%08llx: ", (unsigned long long)slot->phys);
+		if (!slot->mapped || slot->err) {
+			printf("%s\n", slot->mapped ? "Error reading modinfo" :
+				   "Can't map slot");
+			ret = 1;
+			continue;
+		}
 
-    return _write( (uint32_t)(uintptr_t)addr, index, data );
+		if (res->fields & MM_QF_MAGIC) {
+			printf("%sMAGIC: 0x%04x", sep, res->magic);
+			sep = ", ";
+		}
+		if (res->fields & MM_QF_TYPE) {
+			printf("%sType: 0x%04x", sep, res->modtype);
+			sep = ", ";
+		}
+		if (res->fields & MM_QF_MODID) {
+			printf("%sID: 0x%04x", sep, res->modid);
+			sep = ", ";
+		}
+		if (res->fields & MM_QF_LAYOUT) {
+			printf("%sLayout: 0x%04x", sep, res->layout);
+			sep = ", ";
+		}
+		if (res->fields & MM_QF_VARIANT) {
+			printf("%sVariant: 0x%04x", sep, res->variant);
+			sep = ", ";
+		}
+		if (res->fields & MM_QF_SERIAL) {
+			printf("%sSerial: %u", sep, res->serial);
+			sep = ", ";
+		}
+		if (res->fields & MM_QF_NAME) {
+			printf("%sName: %s", sep, res->devname);
+			sep = ", ";
+		}
+		if (res->fields & MM_QF_RAW) {
+			printf("%sRaw:", sep);
+			for (j = 0; j < MM_EE_WORDS; j++)
+				printf(" %04x", res->raw[j]);
+		}
+		if (res->probe != MM_PROBE_PRESENT)
+			printf(res->probe == MM_PROBE_EMPTY ? ", Empty" :
+				   ", DO stuck low");
+		printf("\n");
+	}
+	return ret;
 }
 
-/******************************* m_read ************************************/
-/**   Read a specified word from EEPROM at 'base'.
- *
+/******************************* write_trace *******************************/
+/**   Stop tracing and write the trace files.
  *---------------------------------------------------------------------------
- *  \param base			\IN base address pointer
- *  \param index		\IN index to read (0..15)
- *  \return   read word
+ *  \param scan			\IN slots (for the physical addresses)
+ *  \param traceFile	\IN text trace (NULL=none)
+ *  \param vcdFile		\IN VCD file (NULL=none)
+ *  \return 0=ok, 1=error
  *
  ****************************************************************************/
-int m_read( uint32_t base, uint8_t index )
+static int write_trace( MM_SCAN *scan, const char *traceFile,
+						const char *vcdFile )
 {
-    register uint16_t    wx;                 /* data word    */
-    register int        i;                  /* counter      */
+	MM_TRACE_SLOT *ts;
+	uint64_t lost;
+	int i, ret = 0;
 
-    _opcode(base, (uint8_t)(_READ_+index) );
-    for(wx=0, i=0; i<16; i++)
-        wx = (uint16_t)((wx<<1)+_clock(base,0));
-    _deselect(base);
+	mm_trace_stop();
+	if (!(ts = calloc(scan->nslots + 1, sizeof(*ts))))
+		return 1;
+	for (i = 0; i < scan->nslots; i++) {
+		ts[i].base = scan->slot[i].base;
+		ts[i].phys = scan->slot[i].phys;
+	}
 
-    return(wx);
+	mm_trace_get(NULL, 0, &lost);
+	if (lost)
+		printf("*** WARNING: trace buffer overflow, %llu events lost\n",
+			   (unsigned long long)lost);
+	if (traceFile && mm_trace_save(traceFile, ts, scan->nslots)) {
+		printf("Can't write trace %s\n", traceFile);
+		ret = 1;
+	}
+	if (vcdFile && mm_trace_vcd(vcdFile, ts, scan->nslots)) {
+		printf("Can't write VCD %s\n", vcdFile);
+		ret = 1;
+	}
+	free(ts);
+	mm_trace_free();
+	return ret;
 }
 
-/******************************* m_getmodinfo ******************************/
-/**   Get module information.
- *
- *                The function reads the magic-id, mod-id, layout-rev and
- *                product-variant from the EEPROM, evaluates these parameters
- *                and provide the module information for the caller.
- *
- *                1) If the four read values are equal, then we assume that
- *                   the EEPROM is not present or is invalid.
- *                   In this case, the function returns with the following
- *                   parameters:
- *                   - modtype = 0.
- *             		 - devid  = 0xffffffff
- *                   - devrev = 0xffffffff
- *                   - devname = '\\0'
- *
- *                2) If the four read values are different, the function
- *                   gives the following parameters to the caller:
- *             		 - devid  = (magic-id   << 16) | mod-id
- *                   - devrev = (layout-rev << 16) | product-variant
- *
- *                2a) If magic-id = 0x5346 the function returns with:
- *                    - modtype = MODCOM_MOD_MEN
- *					  - devname = "<prefix><decimal mod-id><suffix>"
- *					              - if (mod-id & 0xFF00) == 0x5300 then
- *                                  - prefix="MS"
- *					              - else
- *                                  - prefix="M"
- *					                - if (mod-id & 0xFF00) = 0x7D00 then
- *                                    - suffix="N"
- *
- *                                e.g. M34, MS9, M45N
- *
- *                2b) If magic-id <> 0x5346 the function returns with:
- *                  - modtype = MODCOM_MOD_THIRD
- *                  - devname = '\\0'
+/******************************* load_image ********************************/
+/**   Read an EEPROM image file.
  *
+ *    The file contains hex words separated by white space, '#' starts
+ *    a comment.
  *---------------------------------------------------------------------------
- *  \param base			\IN	base address pointer
- *  \param modtype		\OUT module type (0, MODCOM_MOD_MEN, MODCOM_MOD_THIRD)
- *  \param devid		\OUT device id
- *  \param devrev		\OUT device revision
- *  \param devname		\OUT device name
- *  \return    0=ok, 1=error
+ *  \param path			\IN file name
+ *  \param buf			\OUT image
+ *  \param max			\IN size of buf in words
+ *  \return number of words read or -1 on error
  *
  ****************************************************************************/
-int m_getmodinfo(
-	uint32_t base,
-	uint32_t *modtype,
-	uint32_t *devid,
-	uint32_t *devrev,
-	char    *devname )
+int load_image( const char *path, uint16_t *buf, int max )
 {
-	uint16_t magic, modid, layout, variant;
-	uint8_t	addSuffix = FALSE;
-	char	*bufptr = devname;
-
-	/* set defaults */
-	*devid   = 0xffffffff;
-	*devrev  = 0xffffffff;
-	*devname = '\0';
-
-	/* read data from eeprom */
-	magic   = (uint16_t)m_read(base, 0);
-	modid   = (uint16_t)m_read(base, 1);
-	layout  = (uint16_t)m_read(base, 2);
-	variant	= (uint16_t)m_read(base, 8);
-	
-	printf("MAGIC: 0x%x\n",magic);
-	/*------------------------------+
-	| M-Module without id-prom data |
-	+------------------------------*/
-	/*
-	 * If all read data are equal then we assume there is a M-Module
-	 * without id-prom or without valid id-prom data.
-	 */
-	if( (magic  == modid) &&
-		(layout == variant) &&
-		(magic  == layout) ){
-
-		*modtype = 0;
-		return 0;
-	}
-
-	/*------------------------------+
-	| M-Module with id-prom data    |
-	+------------------------------*/
-	else {
-
-		/* build devid and devrev */
-		*devid   = (magic  << 16) | modid;
-		*devrev  = (layout << 16) | variant;
-
-		/*------------------------------+
-		| VITA conform M-Module         |
-		+------------------------------*/
-		/*
-		 * If we got the right magic-id then
-		 * we assume there is a VITA conform M-Module.
-		 */
-		if( magic == MOD_ID_MAGIC ){
-
-			*modtype = MODCOM_MOD_MEN;
-
-			/*
-			 * build device name
-			 */
-
-			*bufptr = 'M';
-			bufptr++;
-
-			/* MSxx M-Module? */
-			if( (modid & 0xFF00) == MOD_ID_MS_MASK ){
-				*bufptr = 'S';
-				bufptr++;
-				modid &= 0x00FF;
-			}
-			/* MxxN M-Module? */
-			else if( (modid & 0xFF00) == MOD_ID_N_MASK ){
-				addSuffix = TRUE;
-				modid &= 0x00FF;
+	FILE *fp;
+	char line[256], *p, *end;
+	unsigned long val;
+	int n = 0;
+
+	if( !(fp = fopen( path, "r" )) )
+		return -1;
+
+	while( fgets( line, sizeof(line), fp ) ){
+		if( (p = strchr( line, '#' )) )
+			*p = '\0';
+		for( p = line; ; p = end ){
+			while( *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' )
+				p++;
+			if( !*p )
+				break;
+			val = strtoul( p, &end, 16 );
+			if( end == p || val > 0xffff || n >= max ){
+				fclose( fp );
+				return -1;
 			}
-
-			/* add modid */
-			_xtoa( modid, 10, bufptr );
-
-			/* MxxN M-Module */
-			if( addSuffix ){
-				bufptr = devname;
-				while( *bufptr != '\0' )
-					bufptr++;
-				*bufptr++ = 'N';
-				*bufptr = '\0';
-			}
-		}
-
-		/*------------------------------+
-		| other M-Module                |
-		+------------------------------*/
-		/*
-		 * Not the right magic-id
-		 */
-		else{
-			*modtype = MODCOM_MOD_THIRD;
+			buf[n++] = (uint16_t)val;
 		}
 	}
-
-	return 0;
-}
-
-
-void usage()
-{
-	printf("--------------------------------------------\n");
-	printf("mm_ident <addr>				    \n");
-	printf("  <addr> - MM-Module Addresse (BAR + Offset)\n");
-	printf("--------------------------------------------\n");
+	fclose( fp );
+	return n;
 }
 
-
 /** \brief Check if kernel is locked down
  * \return 0 if kernel is not locked down
  * \return non-zero if kernel is locked down
@@ -607,9 +731,90 @@ int is_kernel_locked_down()
 	return ret;
 }
 
+/******************************* parse_serial ******************************/
+/**   Set the serial numbers of a batch from --serial.
+ *
+ *    One number: first serial, counted up per slot. Several numbers
+ *    separated by commas: one per slot, in slot order.
+ *---------------------------------------------------------------------------
+ *  \param str			\IN option argument
+ *  \param b			\INOUT batch
+ *  \param list			\OUT allocated list (to free) or NULL
+ *  \return   0 on success 1 on error
+ *
+ ****************************************************************************/
+static int parse_serial( const char *str, MM_BATCH *b, uint32_t **list )
+{
+	const char *p;
+	char *end;
+	int n = 1;
+
+	for (p = str; *p; p++)
+		if (*p == ',')
+			n++;
+	if (!(*list = calloc(n, sizeof(**list))))
+		return 1;
+
+	for (n = 0, p = str; ; p = end + 1) {
+		(*list)[n++] = (uint32_t)strtoul(p, &end, 0);
+		if (end == p || (*end && *end != ','))
+			return 1;
+		if (!*end)
+			break;
+	}
+
+	b->serialWord = MM_EE_SERIAL_HI;
+	if (n == 1)
+		b->serial = (*list)[0];
+	else {
+		b->serialList = *list;
+		b->nserial    = n;
+	}
+	return 0;
+}
+
+/******************************* add_addr **********************************/
+/**   Add a slot address given in hex to the scan list.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param str			\IN address string
+ *  \return   0 on success 1 on error
+ *
+ ****************************************************************************/
+static int add_addr( MM_SCAN *scan, const char *str )
+{
+	char *end;
+	unsigned long long addr = strtoull(str, &end, 16);
+
+	if (end == str || *end) {
+		printf("Invalid address: %s\n", str);
+		return 1;
+	}
+	return mm_scan_add(scan, (uint64_t)addr) ? 1 : 0;
+}
+
+/******************************* add_stdin *********************************/
+/**   Add the slot addresses read from stdin to the scan list.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \return   0 on success 1 on error
+ *
+ ****************************************************************************/
+static int add_stdin( MM_SCAN *scan )
+{
+	char word[64];
+
+	while (scanf("%63s", word) == 1)
+		if (add_addr(scan, word))
+			return 1;
+	return 0;
+}
 
 /******************************* main ************************************/
 /**   Map the M-Module memory and print the id informations
+ *
+ *    With a single address the output is the same as always, with
+ *    several addresses or carriers one line per slot is printed.
  *
  *---------------------------------------------------------------------------
  *  \param argc			\IN Argument Counter
@@ -619,57 +824,530 @@ int is_kernel_locked_down()
  ****************************************************************************/
 int main(int argc, char** argv)
 {
-        int fd;
-        uint32_t *vmem;
-	uint32_t phys_addr;
-	uint32_t modtype, devid, devrev;
-	uint32_t pagesize, pageaddr;
-	char devname[25];
-
-	if (is_kernel_locked_down()) {
+	MM_SCAN scan;
+	MM_SCAN_SLOT *slot;
+	int opt, i, sim = 0, carriers = 0, discover = 0, single, ret = 0;
+	int devmem = 0, jobs = 1, perCarrier = 1, lockstep = 0, autotune = 0;
+	MM_TIMING timing = { MM_HALF_NS_DEFAULT, 1, MM_ACCESS_F204 };
+	uint32_t simTpd = 0;
+	int useCache = 0, fast = 0;
+	const char *progFile = NULL;
+	uint16_t progImage[MM_EE_WORDS];
+	int progWords = 0;
+	MM_BATCH batch;
+	const char *serialStr = NULL, *reportFile = NULL;
+	uint32_t *serialList = NULL;
+	int stats = 0, format = 0, rt = 0, access = -1;
+	uint32_t query = 0, lockMs = 0;
+	int lock = 1, verify = 0, bitNs = 0;
+	MM_RT_CFG rtCfg = { -1, MM_RT_PRIO_DEFAULT };
+	int daemon = 0;
+	MM_DAEMON_CFG dcfg;
+	int useInv = 0;
+	const char *invFile = NULL;
+	MM_INV inv;
+	uint64_t t0 = mm_time_ns();
+	uint32_t progFlags = 0, simBusy = MM_SIM_BUSY_US;
+	const char *cacheFile = NULL;
+	MM_CACHE cache;
+	const char *sysfs = NULL;
+	char *end;
+	unsigned long long bar;
+	const char *simImage = NULL;
+	uint16_t image[MM_EE_WORDS] = { MOD_ID_MAGIC, 0x0048 };	/* M72 */
+	MM_SIM_FAULT fault;
+	MM_SIM_DEV **simDev = NULL;
+	const char *traceFile = NULL, *vcdFile = NULL, *replayFile = NULL;
+	uint32_t traceSize = 0;
+	static const struct option longopts[] = {
+		{ "carrier",	required_argument,	NULL, 'c' },
+		{ "discover",	no_argument,		NULL, 'd' },
+		{ "sysfs",		required_argument,	NULL, 'S' },
+		{ "jobs",		required_argument,	NULL, 'j' },
+		{ "per-carrier",	required_argument,	NULL, 'P' },
+		{ "lockstep",	no_argument,		NULL, 'L' },
+		{ "bit-ns",		required_argument,	NULL, 'B' },
+		{ "no-flush",	no_argument,		NULL, 'N' },
+		{ "access",		required_argument,	NULL, 'K' },
+		{ "autotune",	no_argument,		NULL, 'A' },
+		{ "verify",		no_argument,		NULL, 'v' },
+		{ "program",	required_argument,	NULL, 'W' },
+		{ "autoerase",	no_argument,		NULL, 'E' },
+		{ "serial",		required_argument,	NULL, 'n' },
+		{ "report",		required_argument,	NULL, 'r' },
+		{ "stats",		optional_argument,	NULL, 'I' },
+		{ "format",		required_argument,	NULL, 'O' },
+		{ "query",		required_argument,	NULL, 'M' },
+		{ "no-lock",	no_argument,		NULL, 'J' },
+		{ "lock-timeout",	required_argument,	NULL, 'e' },
+		{ "rt",			optional_argument,	NULL, 'G' },
+		{ "rt-cpu",		required_argument,	NULL, 'H' },
+		{ "daemon",		optional_argument,	NULL, 'D' },
+		{ "interval",	required_argument,	NULL, 'V' },
+		{ "full-every",	required_argument,	NULL, 'R' },
+		{ "inventory",	optional_argument,	NULL, 'i' },
+		{ "trace",		required_argument,	NULL, 'X' },
+		{ "vcd",		required_argument,	NULL, 'Y' },
+		{ "trace-size",	required_argument,	NULL, 'Z' },
+		{ "replay",		required_argument,	NULL, 'Q' },
+		{ "sim-tpd",	required_argument,	NULL, 'T' },
+		{ "sim-busy",	required_argument,	NULL, 'U' },
+		{ "cache",		optional_argument,	NULL, 'C' },
+		{ "fast",		no_argument,		NULL, 'f' },
+		{ "sim",		optional_argument,	NULL, 's' },
+		{ "sim-fault",	required_argument,	NULL, 'F' },
+		{ "help",		no_argument,		NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	mm_timing_calibrate();
+	mm_scan_init(&scan);
+	mm_sim_fault_init(&fault);
+	mm_daemon_cfg_init(&dcfg);
+	while ((opt = getopt_long(argc, argv, "c:dj:s::h", longopts, NULL)) != -1) {
+		switch (opt) {
+		case 'c':
+			bar = strtoull(optarg, &end, 16);
+			if (end == optarg || *end) {
+				printf("Invalid carrier BAR: %s\n", optarg);
+				return 1;
+			}
+			if (mm_scan_add_carrier(&scan, (uint64_t)bar))
+				return 1;
+			carriers++;
+			break;
+		case 'd':
+			discover = 1;
+			break;
+		case 'S':
+			sysfs = optarg;
+			break;
+		case 'j':
+			jobs = atoi(optarg);
+			break;
+		case 'P':
+			perCarrier = atoi(optarg);
+			break;
+		case 'L':
+			lockstep = 1;
+			break;
+		case 'B':
+			timing.halfNs = (uint32_t)strtoul(optarg, NULL, 0);
+			bitNs = 1;
+			break;
+		case 'N':
+			timing.flush = 0;
+			break;
+		case 'K':
+			if ((access = mm_access_find(optarg)) < 0) {
+				printf("Invalid access profile: %s\n", optarg);
+				return 1;
+			}
+			timing.access = access;
+			break;
+		case 'A':
+			autotune = 1;
+			break;
+		case 'v':
+			verify = 1;
+			break;
+		case 'W':
+			progFile = optarg;
+			break;
+		case 'E':
+			progFlags |= MM_PROG_AUTOERASE;
+			break;
+		case 'n':
+			serialStr = optarg;
+			break;
+		case 'r':
+			reportFile = optarg;
+			break;
+		case 'I':
+			if (!optarg || !strcmp(optarg, "text"))
+				stats = STATS_TEXT;
+			else if (!strcmp(optarg, "json"))
+				stats = STATS_JSON;
+			else {
+				printf("Invalid stats format: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'O':
+			if (!strcmp(optarg, "modprobe"))
+				format = FORMAT_MODPROBE;
+			else if (!strcmp(optarg, "dsc"))
+				format = FORMAT_DSC;
+			else {
+				printf("Invalid format: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'M':
+			if (mm_query_parse(optarg, &query)) {
+				printf("Invalid field list: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'J':
+			lock = 0;
+			break;
+		case 'e':
+			lockMs = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'G':
+			rt = 1;
+			if (optarg)
+				rtCfg.prio = (int)strtol(optarg, NULL, 0);
+			break;
+		case 'H':
+			rt = 1;
+			rtCfg.cpu = (int)strtol(optarg, NULL, 0);
+			break;
+		case 'D':
+			daemon = 1;
+			dcfg.sockPath = optarg;
+			break;
+		case 'V':
+			dcfg.intervalMs = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'R':
+			dcfg.fullEvery = atoi(optarg);
+			break;
+		case 'i':
+			useInv = 1;
+			invFile = optarg;
+			break;
+		case 'X':
+			traceFile = optarg;
+			break;
+		case 'Y':
+			vcdFile = optarg;
+			break;
+		case 'Z':
+			traceSize = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'Q':
+			replayFile = optarg;
+			break;
+		case 'U':
+			simBusy = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			simTpd = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'C':
+			useCache = 1;
+			cacheFile = optarg;
+			break;
+		case 'f':
+			useCache = 1;
+			fast = 1;
+			break;
+		case 's':
+			sim = 1;
+			simImage = optarg;
+			break;
+		case 'F':
+			if (mm_sim_parse_fault(optarg, &fault)) {
+				printf("Invalid fault list: %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	scan.stats = (stats != 0);
+
+	/*
+	 * errors are detected, so the identification may run faster; all
+	 * other accesses (query, programming, daemon probes) run at the
+	 * safe period
+	 */
+	if (verify) {
+		scan.verifyNs = timing.halfNs > MM_HALF_NS_DEFAULT ?
+			timing.halfNs : MM_HALF_NS_DEFAULT;
+		scan.verifyFastNs = bitNs ? timing.halfNs : MM_VERIFY_HALF_NS;
+		timing.halfNs = scan.verifyNs;
+	}
+
+	/* slots added from now on use this timing */
+	mm_timing_set_default(&timing);
+	for (i = 0; i < scan.nslots; i++)
+		scan.slot[i].timing = timing;
+
+	for (i = optind; i < argc; i++) {
+		if (!strcmp(argv[i], "-") ? add_stdin(&scan) : add_addr(&scan, argv[i]))
+			return 1;
+	}
+
+	if (discover) {
+		if (mm_pci_discover(&scan, sysfs) < 0) {
+			printf("Can't scan %s/bus/pci/devices\n",
+				   sysfs ? sysfs : MM_PCI_SYSFS);
+			return 1;
+		}
+		if (scan.ncarriers == 0 && scan.nslots == 0) {
+			printf("No M-Module carrier found\n");
+			return 1;
+		}
+	}
+
+	/* an explicit profile also applies to discovered carriers */
+	for (i = 0; access >= 0 && i < scan.nslots; i++)
+		scan.slot[i].timing.access = access;
+
+	if (scan.nslots == 0) {
+		usage();
+		return 1;
+	}
+
+	if (query && (format || useCache || daemon || useInv)) {
+		printf("--query can't be combined with --format, --cache, "
+			   "--daemon or --inventory\n");
+		return 1;
+	}
+
+	if (progFile) {
+		progWords = load_image(progFile, progImage, MM_EE_WORDS);
+		if (progWords <= 0) {
+			printf("Can't read image %s\n", progFile);
+			return 1;
+		}
+		mm_batch_init(&batch, progImage, progWords, progFlags);
+		if (serialStr && parse_serial(serialStr, &batch, &serialList)) {
+			printf("Invalid serial numbers: %s\n", serialStr);
+			return 1;
+		}
+	}
+	single = (scan.nslots == 1 && !carriers && !discover);
+
+	/* discovered carriers are mapped through sysfs, not /dev/mem */
+	for (i = 0; i < scan.nslots; i++)
+		if (scan.slot[i].carrier < 0)
+			devmem = 1;
+
+	if (!sim && !replayFile && devmem && is_kernel_locked_down()) {
 		printf("*** WARNING: Linux kernel lockdown functionality is enabled. /dev/mem is not\n"
 		       "             accessible and fpga_load is not usable.\n");
 	}
 
-	if (argc < 2) {
-		usage();
+	if (single && !format && !query)
+		printf("PhysAddr: 0x%08llx\n", (unsigned long long)scan.slot[0].phys);
+
+	if (sim) {
+		if (simImage) {
+			memset(image, 0xff, sizeof(image));
+			if (load_image(simImage, image, MM_EE_WORDS) < 0) {
+				printf("Can't read image %s\n", simImage);
+				return 1;
+			}
+		}
+		simDev = calloc(scan.nslots, sizeof(*simDev));
+		for (i = 0; simDev && i < scan.nslots; i++) {
+			if (!(simDev[i] = mm_sim_create(image, MM_EE_WORDS)) ||
+			    mm_sim_attach(simDev[i], (uintptr_t)scan.slot[i].phys)) {
+				printf("Can't create simulated EEPROM\n");
+				return 1;
+			}
+			mm_sim_set_fault(simDev[i], &fault);
+			mm_sim_set_tpd(simDev[i], simTpd);
+			mm_sim_set_busy(simDev[i], simBusy);
+		}
+		mm_bus_set(&MM_BusSim);
+	}
+	else if (replayFile) {
+		if (mm_replay_load(replayFile) < 0) {
+			printf("Can't read trace %s\n", replayFile);
+			return 1;
+		}
+		mm_bus_set(&MM_BusReplay);
+	}
+
+	if ((traceFile || vcdFile) && mm_trace_start(traceSize)) {
+		printf("Can't allocate trace buffer\n");
 		return 1;
 	}
 
-	sscanf(argv[1],"%x",&phys_addr);
-	printf("PhysAddr: 0x%08x\n",phys_addr);
-        
-        fd = open("/dev/mem",O_RDWR|O_SYNC);
-	if(fd < 0) {
-                printf("Can't open /dev/mem\n");
-                return 1;
-        }
-
-	/* mmap needs a page aligned address */
-	pagesize = getpagesize();
-	pageaddr = phys_addr & ~(pagesize-1);
-
-	/* map always in the 32bit area this works for 32bit and 64bit */
-	vmem = (uint32_t *) mmap(0, getpagesize(), PROT_READ|PROT_WRITE, MAP_SHARED | MAP_32BIT, fd, pageaddr);
-
-	/* Add the page offset */
-	vmem = (uint32_t*)(uintptr_t)((uint32_t)(uintptr_t)vmem | (phys_addr & (pagesize - 1)));
-	
-        if(vmem == NULL) {
-                printf("Can't mmap memory reagion\n");
-                return 1;
-	}
-	
-	if (m_getmodinfo((uint32_t)(uintptr_t)vmem, &modtype, &devid, &devrev, devname))
-		printf("Error reading modinfo\n");
+	/* other processes may access the same slots */
+	if (lock && mm_lock_init(NULL, lockMs))
+		printf("*** WARNING: can't open slot locks %s: %s\n", MM_LOCK_SHM,
+			   strerror(errno));
+
+	/* map every carrier page only once */
+	mm_scan_map(&scan, sim || replayFile);
+
+	if (single) {
+		if (!scan.slot[0].mapped) {
+			if (scan.memFd < 0)
+				printf("Can't open /dev/mem\n");
+			else
+				printf("Can't mmap memory reagion\n");
+			return 1;
+		}
+	}
+
+	if (rt) {
+		if (mm_rt_init(&rtCfg)) {
+			printf("Can't enable real-time mode: %s\n", strerror(errno));
+			return 1;
+		}
+		for (i = 0; i < scan.nslots; i++)
+			if (scan.slot[i].mapped)
+				mm_rt_prefault(&scan.slot[i].base, 1);
+	}
+
+	if (autotune)
+		mm_scan_autotune(&scan);
+
+	if (progFile && program_slots(&scan, &batch, reportFile))
+		ret = 1;
+
+	if (useCache) {
+		if (mm_cache_load(&cache, cacheFile))
+			return 1;
+		if (fast && !progFile)
+			mm_scan_cache_check(&scan, &cache);
+	}
+
+	if (query)
+		mm_scan_query(&scan, query);
+	else if (lockstep)
+		mm_scan_run_lockstep(&scan);
 	else
-		printf("Type: 0x%04x, ID: 0x%04x, Rev: 0x%04x, Name: %s\n",
-					modtype, (uint16_t)devid, (uint16_t)devrev,devname);
+		mm_scan_run_parallel(&scan, jobs, perCarrier);
 
-	munmap(vmem, getpagesize());
+	if (useCache) {
+		if (mm_scan_cache_update(&scan, &cache) || mm_cache_save(&cache))
+			printf("*** WARNING: can't update cache %s\n", cache.path);
+		mm_cache_exit(&cache);
+	}
 
-        return 0;
-}
+	memset(&inv, 0, sizeof(inv));
+	if (useInv) {
+		if (mm_inv_create(&inv, invFile, scan.nslots))
+			printf("*** WARNING: can't create inventory %s: %s\n",
+				   invFile ? invFile : MM_INV_FILE, strerror(errno));
+		else
+			mm_inv_update(&inv, &scan);
+	}
+
+	if (format && print_format(&scan, format))
+		ret = 1;
+
+	if (query && print_query(&scan, single))
+		ret = 1;
 
+	for (i = 0; !format && !query && i < scan.nslots; i++) {
+		slot = &scan.slot[i];
 
+		if (!single)
+			printf("0x%08llx: ", (unsigned long long)slot->phys);
+		else if (slot->mapped)
+			printf("MAGIC: 0x%x\n", slot->words[0]);
 
+		if (!slot->mapped) {
+			printf("Can't map slot\n");
+			ret = 1;
+		}
+		else if (slot->err) {
+			printf(slot->probe == MM_PROBE_BUSY ?
+				   "Slot busy, locked by another process\n" :
+				   slot->verify.failed ?
+				   "Unreliable read, words differ on every re-read\n" :
+				   "Error reading modinfo\n");
+			ret = 1;
+		}
+		else {
+			printf("Type: 0x%04x, ID: 0x%04x, Rev: 0x%04x, Name: %s",
+				   slot->modtype, (uint16_t)slot->devid,
+				   (uint16_t)slot->devrev, slot->devname);
+			if (slot->probe != MM_PROBE_PRESENT)
+				printf(slot->probe == MM_PROBE_EMPTY ? ", Empty" :
+					   ", DO stuck low");
+			if (slot->carrier >= 0)
+				printf(", Carrier: %s %s slot %d",
+					   scan.carrier[slot->carrier].type,
+					   scan.carrier[slot->carrier].pci, slot->slotNo);
+			if (autotune && !single)
+				printf(", Bit: %u ns", slot->timing.halfNs);
+			if (scan.verifyNs && !single)
+				print_verify(slot, ", ", "");
+			printf("\n");
+			if (scan.verifyNs && single)
+				print_verify(slot, "", "\n");
+		}
+		if (autotune && single) {
+			if (slot->tuned)
+				printf("Timing: half bit period %u ns (limit %u ns)\n",
+					   slot->tune.halfNs, slot->tune.limitNs);
+			else
+				printf("Timing: auto-tuning failed, half bit period %u ns\n",
+					   slot->timing.halfNs);
+		}
+	}
+
+	if (stats)
+		print_stats(&scan, stats, mm_time_ns() - t0);
+
+	if (rt) {
+		MM_RT_CNT rcnt;
+
+		mm_rt_get_cnt(&rcnt);
+		printf("RT: %llu transfers, %llu preempted, %llu overruns, "
+			   "max %llu us\n", (unsigned long long)rcnt.words,
+			   (unsigned long long)rcnt.preempt,
+			   (unsigned long long)rcnt.overrun,
+			   (unsigned long long)(rcnt.maxNs / 1000));
+	}
+
+	if (stats == STATS_TEXT && lock) {
+		MM_LOCK_CNT lcnt;
+
+		mm_lock_get_cnt(&lcnt);
+		printf("Lock: %llu taken, %llu waited (%llu us), %llu timeouts, "
+			   "%llu recovered\n", (unsigned long long)lcnt.taken,
+			   (unsigned long long)lcnt.waited,
+			   (unsigned long long)(lcnt.waitNs / 1000),
+			   (unsigned long long)lcnt.timeouts,
+			   (unsigned long long)lcnt.recovered);
+	}
+
+	if ((traceFile || vcdFile) && write_trace(&scan, traceFile, vcdFile))
+		ret = 1;
+
+	if (replayFile) {
+		MM_REPLAY_CNT rcnt;
+
+		mm_replay_get_cnt(&rcnt);
+		if (rcnt.diverged)
+			printf("*** WARNING: replay diverged from trace in %llu "
+				   "accesses\n", (unsigned long long)rcnt.diverged);
+	}
+
+	if (daemon) {
+		fflush(stdout);
+		signal(SIGINT, sig_stop);
+		signal(SIGTERM, sig_stop);
+		dcfg.inv = inv.hdr ? &inv : NULL;
+		if (mm_daemon_run(&scan, &dcfg, &G_stop)) {
+			printf("Can't run daemon on %s: %s\n", dcfg.sockPath ?
+				   dcfg.sockPath : MM_DAEMON_SOCK, strerror(errno));
+			ret = 1;
+		}
+	}
+
+	mm_inv_close(&inv);
+	mm_scan_exit(&scan);
+	mm_lock_exit();
+	for (i = 0; simDev && i < scan.nslots; i++)
+		mm_sim_destroy(simDev[i]);
+	free(simDev);
+	free(serialList);
+	mm_replay_free();
+
+	return (single && !progFile) ? 0 : ret;
+}
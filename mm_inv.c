@@ -0,0 +1,311 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_inv.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Inventory table in a shared file, seqlock protected.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mm_eeprom.h"
+#include "mm_inv.h"
+
+#define INV_RETRIES		1000		/* snapshot attempts */
+#define INV_RETRY_NS	100000		/* wait between attempts */
+
+/* the layout is part of the interface */
+typedef char _inv_hdr_size[sizeof(MM_INV_HDR) == 64 ? 1 : -1];
+typedef char _inv_rec_size[sizeof(MM_INV_REC) == 128 ? 1 : -1];
+typedef char _inv_pci_size[sizeof(((MM_INV_REC *)0)->pci) >=
+						   sizeof(((MM_SCAN_CARRIER *)0)->pci) ? 1 : -1];
+
+/******************************* _inv_now **********************************/
+/**   Wall clock time for the records.
+ ****************************************************************************/
+static uint64_t _inv_now( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_REALTIME, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/******************************* mm_inv_create *****************************/
+/**   Create the inventory file and map it for writing.
+ *
+ *    The file is set up under a temporary name and renamed, so readers
+ *    never see a partial header. A reader that mapped an earlier file
+ *    keeps the old one, MM_INV_HDR.pid=0 there tells it to map again.
+ *---------------------------------------------------------------------------
+ *  \param inv			\OUT handle
+ *  \param path			\IN file (NULL=MM_INV_FILE), directory is created
+ *  \param nrec			\IN number of records (slots)
+ *  \return 0=ok, -1=error (errno)
+ ****************************************************************************/
+int mm_inv_create( MM_INV *inv, const char *path, int nrec )
+{
+	char tmp[512], *p;
+	void *vaddr;
+	int fd, e;
+
+	memset( inv, 0, sizeof(*inv) );
+	if( !path )
+		path = MM_INV_FILE;
+
+	/* create directory */
+	snprintf( tmp, sizeof(tmp), "%s", path );
+	if( (p = strrchr( tmp, '/' )) && p != tmp ){
+		*p = '\0';
+		mkdir( tmp, 0755 );
+	}
+
+	inv->size = sizeof(MM_INV_HDR) + (size_t)nrec * sizeof(MM_INV_REC);
+	snprintf( tmp, sizeof(tmp), "%s.%d", path, (int)getpid() );
+	if( (fd = open( tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 )) < 0 )
+		return -1;
+	if( ftruncate( fd, (off_t)inv->size ) ||
+		(vaddr = mmap( NULL, inv->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+					   fd, 0 )) == MAP_FAILED )
+		goto ERR;
+	close( fd );
+
+	inv->hdr = vaddr;
+	inv->rec = (MM_INV_REC *)(inv->hdr + 1);
+	inv->hdr->magic   = MM_INV_MAGIC;
+	inv->hdr->version = MM_INV_VERSION;
+	inv->hdr->hdrSize = sizeof(MM_INV_HDR);
+	inv->hdr->recSize = sizeof(MM_INV_REC);
+	inv->hdr->nrec    = (uint32_t)nrec;
+	inv->hdr->pid     = (uint32_t)getpid();
+
+	if( rename( tmp, path ) || !(inv->path = strdup( path )) ){
+		e = errno;
+		munmap( vaddr, inv->size );
+		unlink( tmp );
+		memset( inv, 0, sizeof(*inv) );
+		errno = e;
+		return -1;
+	}
+	return 0;
+
+ERR:
+	e = errno;
+	close( fd );
+	unlink( tmp );
+	errno = e;
+	return -1;
+}
+
+/******************************* _inv_fill *********************************/
+/**   Build the record of a slot.
+ ****************************************************************************/
+static void _inv_fill( const MM_SCAN *scan, int i, MM_INV_REC *r )
+{
+	const MM_SCAN_SLOT *s = &scan->slot[i];
+	const MM_SCAN_CARRIER *c;
+
+	memset( r, 0, sizeof(*r) );
+	r->phys   = s->phys;
+	r->slotNo = (uint16_t)s->slotNo;
+	r->probe  = s->probe;
+
+	if( !s->mapped || s->err )
+		r->flags |= MM_INV_ERR;
+	else {
+		r->flags  |= MM_INV_VALID | (s->cached ? MM_INV_CACHED : 0);
+		r->modtype = s->modtype;
+		r->devid   = s->devid;
+		r->devrev  = s->devrev;
+		memcpy( r->words, s->words, sizeof(r->words) );
+		snprintf( r->name, sizeof(r->name), "%s", s->devname );
+	}
+
+	if( s->carrier >= 0 && s->carrier < scan->ncarriers ){
+		c = &scan->carrier[s->carrier];
+		snprintf( r->carrier, sizeof(r->carrier), "%s", c->type );
+		snprintf( r->pci, sizeof(r->pci), "%s", c->pci );
+	}
+}
+
+/******************************* mm_inv_update *****************************/
+/**   Publish the results of the scan list.
+ *
+ *    MM_INV_REC.timeNs is set for records whose contents changed. Only
+ *    one thread may update at a time; the slots must not change meanwhile.
+ *---------------------------------------------------------------------------
+ *  \param inv			\IN handle from mm_inv_create()
+ *  \param scan			\IN scan list, the first MM_INV_HDR.nrec slots
+ *						    are published
+ ****************************************************************************/
+void mm_inv_update( MM_INV *inv, const MM_SCAN *scan )
+{
+	MM_INV_HDR *hdr = inv->hdr;
+	MM_INV_REC r;
+	uint64_t gen, now = _inv_now();
+	int i;
+
+	if( !hdr )
+		return;
+
+	gen = __atomic_load_n( &hdr->gen, __ATOMIC_RELAXED );
+	__atomic_store_n( &hdr->gen, gen + 1, __ATOMIC_RELAXED );
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+
+	for( i=0; i<(int)hdr->nrec && i<scan->nslots; i++ ){
+		_inv_fill( scan, i, &r );
+		r.timeNs = inv->rec[i].timeNs;
+		if( memcmp( &r, &inv->rec[i], sizeof(r) ) ){
+			r.timeNs = now;
+			inv->rec[i] = r;
+		}
+	}
+	hdr->timeNs = now;
+
+	__atomic_store_n( &hdr->gen, gen + 2, __ATOMIC_RELEASE );
+}
+
+/******************************* mm_inv_close ******************************/
+/**   Mark the table as abandoned and unmap it. The file stays.
+ *---------------------------------------------------------------------------
+ *  \param inv			\IN handle
+ ****************************************************************************/
+void mm_inv_close( MM_INV *inv )
+{
+	if( inv->hdr ){
+		__atomic_store_n( &inv->hdr->pid, 0, __ATOMIC_RELEASE );
+		munmap( inv->hdr, inv->size );
+	}
+	free( inv->path );
+	memset( inv, 0, sizeof(*inv) );
+}
+
+/******************************* mm_inv_map ********************************/
+/**   Map an inventory file for reading.
+ *---------------------------------------------------------------------------
+ *  \param inv			\OUT mapping
+ *  \param path			\IN file (NULL=MM_INV_FILE)
+ *  \return 0=ok, -1=error (errno, EPROTO=unknown format)
+ ****************************************************************************/
+int mm_inv_map( MM_INV *inv, const char *path )
+{
+	struct stat st;
+	MM_INV_HDR *hdr;
+	void *vaddr;
+	int fd;
+
+	memset( inv, 0, sizeof(*inv) );
+	if( (fd = open( path ? path : MM_INV_FILE, O_RDONLY | O_CLOEXEC )) < 0 )
+		return -1;
+	if( fstat( fd, &st ) ){
+		close( fd );
+		return -1;
+	}
+	if( (size_t)st.st_size < sizeof(MM_INV_HDR) ){
+		close( fd );
+		errno = EPROTO;
+		return -1;
+	}
+	vaddr = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if( vaddr == MAP_FAILED )
+		return -1;
+
+	/* the writer never changes these after the rename */
+	hdr = vaddr;
+	if( hdr->magic != MM_INV_MAGIC || hdr->version != MM_INV_VERSION ||
+		hdr->hdrSize < sizeof(MM_INV_HDR) ||
+		hdr->recSize < sizeof(MM_INV_REC) ||
+		hdr->hdrSize + (uint64_t)hdr->nrec * hdr->recSize >
+		(uint64_t)st.st_size ){
+		munmap( vaddr, (size_t)st.st_size );
+		errno = EPROTO;
+		return -1;
+	}
+
+	inv->hdr  = hdr;
+	inv->rec  = (MM_INV_REC *)((char *)vaddr + hdr->hdrSize);
+	inv->size = (size_t)st.st_size;
+	return 0;
+}
+
+/******************************* mm_inv_snapshot ***************************/
+/**   Copy a consistent set of records, without locking.
+ *
+ *    Retries while the writer updates the table.
+ *---------------------------------------------------------------------------
+ *  \param inv			\IN mapping from mm_inv_map()
+ *  \param rec			\OUT records
+ *  \param maxrec		\IN size of rec[]
+ *  \param gen			\OUT generation of the snapshot (or NULL)
+ *  \return number of records copied, -1=writer stuck (errno=EAGAIN)
+ ****************************************************************************/
+int mm_inv_snapshot( const MM_INV *inv, MM_INV_REC *rec, int maxrec,
+					 uint64_t *gen )
+{
+	const MM_INV_HDR *hdr = inv->hdr;
+	const char *src = (const char *)inv->rec;
+	struct timespec ts = { 0, INV_RETRY_NS };
+	uint64_t g0, g1;
+	int i, n, try;
+
+	n = (int)hdr->nrec < maxrec ? (int)hdr->nrec : maxrec;
+	for( try=0; try<INV_RETRIES; try++ ){
+		g0 = __atomic_load_n( &hdr->gen, __ATOMIC_ACQUIRE );
+		if( !(g0 & 1) ){
+			for( i=0; i<n; i++ )
+				memcpy( &rec[i], src + (size_t)i * hdr->recSize,
+						sizeof(MM_INV_REC) );
+			__atomic_thread_fence( __ATOMIC_ACQUIRE );
+			g1 = __atomic_load_n( &hdr->gen, __ATOMIC_RELAXED );
+			if( g0 == g1 ){
+				if( gen )
+					*gen = g0;
+				return n;
+			}
+		}
+		nanosleep( &ts, NULL );
+	}
+	errno = EAGAIN;
+	return -1;
+}
+
+/******************************* mm_inv_unmap ******************************/
+/**   Unmap a file mapped by mm_inv_map().
+ *---------------------------------------------------------------------------
+ *  \param inv			\IN mapping
+ ****************************************************************************/
+void mm_inv_unmap( MM_INV *inv )
+{
+	if( inv->hdr )
+		munmap( inv->hdr, inv->size );
+	memset( inv, 0, sizeof(*inv) );
+}
@@ -0,0 +1,101 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_inv.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Inventory table in a shared file.
+ *
+ *               A versioned binary table with one fixed size record per
+ *               slot. Other processes mmap() the file read-only and take
+ *               consistent snapshots without locks or parsing: the writer
+ *               makes MM_INV_HDR.gen odd while it updates records and even
+ *               again when done (seqlock), a reader copies the records and
+ *               retries if gen was odd or changed meanwhile.
+ *
+ *               The layout only grows: new fields are appended to a record
+ *               (recSize) or header (hdrSize) and old readers skip them.
+ *               An incompatible change increments MM_INV_VERSION.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_INV_H
+#define _MM_INV_H
+
+#include <stdint.h>
+#include "mm_scan.h"
+
+#define MM_INV_FILE		"/run/mm_ident/inventory"	/* default file */
+#define MM_INV_MAGIC	0x564e494d		/* "MINV" little endian */
+#define MM_INV_VERSION	1
+
+/* MM_INV_REC.flags */
+#define MM_INV_VALID	0x01	/* identified, the id fields are valid */
+#define MM_INV_ERR		0x02	/* not mapped or read error */
+#define MM_INV_CACHED	0x04	/* result taken from the cache */
+
+/** file header, 64 bytes */
+typedef struct MM_INV_HDR {
+	uint32_t magic;				/**< MM_INV_MAGIC */
+	uint16_t version;			/**< MM_INV_VERSION */
+	uint16_t hdrSize;			/**< offset of first record */
+	uint32_t recSize;			/**< size of a record */
+	uint32_t nrec;				/**< number of records */
+	uint64_t gen;				/**< generation, odd while updating */
+	uint64_t timeNs;			/**< CLOCK_REALTIME of last update */
+	uint32_t pid;				/**< writer, 0=writer exited */
+	uint32_t reserved[7];
+} MM_INV_HDR;
+
+/** one slot, 128 bytes, all fields are written by the same update */
+typedef struct MM_INV_REC {
+	uint64_t phys;				/**< physical slot address */
+	uint64_t timeNs;			/**< CLOCK_REALTIME of identification */
+	uint32_t modtype;			/**< m_getmodinfo() results */
+	uint32_t devid;
+	uint32_t devrev;
+	int32_t  probe;				/**< MM_PROBE_xxx */
+	uint16_t flags;				/**< MM_INV_xxx */
+	uint16_t slotNo;			/**< slot number on carrier */
+	uint16_t words[4];			/**< raw words 0, 1, 2, 8 */
+	char     name[32];			/**< module name, NUL terminated */
+	char     carrier[16];		/**< carrier type, NUL terminated */
+	char     pci[32];			/**< carrier PCI device, NUL terminated */
+	uint8_t  reserved[4];
+} MM_INV_REC;
+
+/** writer handle or reader mapping */
+typedef struct MM_INV {
+	MM_INV_HDR *hdr;			/**< mapped file */
+	MM_INV_REC *rec;			/**< first record */
+	size_t      size;			/**< mapped size */
+	char       *path;			/**< file (writer) */
+} MM_INV;
+
+int mm_inv_create( MM_INV *inv, const char *path, int nrec );
+void mm_inv_update( MM_INV *inv, const MM_SCAN *scan );
+void mm_inv_close( MM_INV *inv );
+
+int mm_inv_map( MM_INV *inv, const char *path );
+int mm_inv_snapshot( const MM_INV *inv, MM_INV_REC *rec, int maxrec,
+					 uint64_t *gen );
+void mm_inv_unmap( MM_INV *inv );
+
+#endif /* _MM_INV_H */
@@ -0,0 +1,542 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_lock.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Cross-process per-slot locks in shared memory.
+ *
+ *               The segment holds a table of physical slot addresses,
+ *               each with a robust, process-shared mutex. Entries are
+ *               claimed with a compare-and-swap on the address and never
+ *               freed, so all processes find the same mutex for a slot.
+ *               The segment is created and initialized under flock(), a
+ *               process dying while it holds a slot doesn't block the
+ *               slot: the next owner gets EOWNERDEAD and takes over.
+ *
+ *               A process maps its slot addresses to entries with
+ *               mm_lock_attach(). mm_lock_take()/mm_lock_give() nest per
+ *               thread and do nothing until mm_lock_init() was called or
+ *               for addresses that aren't attached.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mm_eeprom.h"
+#include "mm_timing.h"
+#include "mm_lock.h"
+
+#define LOCK_MAGIC		0x4d4d4c4b			/* "MMLK" */
+#define LOCK_VERSION	1
+#define LOCK_HELD		(MM_LOCKSTEP_MAX + 1)	/* slots held by a thread */
+
+/** one slot in the segment */
+typedef struct {
+	uint64_t        phys;		/* physical slot address, 0=free */
+	pthread_mutex_t mtx;
+} LOCK_ENT;
+
+/** shared memory segment */
+typedef struct {
+	uint32_t magic;				/* LOCK_MAGIC when initialized */
+	uint32_t version;			/* LOCK_VERSION */
+	uint32_t nent;				/* MM_LOCK_SLOTS */
+	uint32_t entSize;			/* sizeof(LOCK_ENT) */
+	LOCK_ENT ent[MM_LOCK_SLOTS];
+} LOCK_SHM;
+
+/** slot address of this process -> entry */
+typedef struct {
+	uintptr_t base;				/* 0=free */
+	int       ent;
+} LOCK_MAP;
+
+/** slot held by the calling thread */
+typedef struct {
+	int ent;
+	int depth;
+} LOCK_HOLD;
+
+static LOCK_SHM   *G_lockShm;
+static uint32_t    G_lockTimeoutMs = MM_LOCK_TIMEOUT_MS;
+static LOCK_MAP    G_lockMap[MM_LOCK_SLOTS];
+static int         G_lockMapN;
+static pthread_mutex_t G_lockMapMtx = PTHREAD_MUTEX_INITIALIZER;
+static MM_LOCK_CNT G_lockCnt;
+
+static __thread LOCK_HOLD G_lockHeld[LOCK_HELD];
+static __thread int       G_lockHeldN;
+
+#define CNT_ADD(f, n)	__atomic_add_fetch( &G_lockCnt.f, (n), __ATOMIC_RELAXED )
+
+/******************************* _lock_shm_init ****************************/
+/**   Initialize a new segment.
+ *---------------------------------------------------------------------------
+ *  \param shm			\IN segment (zeroed)
+ *  \return 0=ok, -1=error
+ ****************************************************************************/
+static int _lock_shm_init( LOCK_SHM *shm )
+{
+	pthread_mutexattr_t attr;
+	int i, err = 0;
+
+	if( pthread_mutexattr_init( &attr ) )
+		return -1;
+	if( pthread_mutexattr_setpshared( &attr, PTHREAD_PROCESS_SHARED ) ||
+		pthread_mutexattr_setrobust( &attr, PTHREAD_MUTEX_ROBUST ) )
+		err = -1;
+
+	memset( shm, 0, sizeof(*shm) );
+	for( i=0; !err && i<MM_LOCK_SLOTS; i++ )
+		if( pthread_mutex_init( &shm->ent[i].mtx, &attr ) )
+			err = -1;
+	pthread_mutexattr_destroy( &attr );
+	if( err )
+		return -1;
+
+	shm->version = LOCK_VERSION;
+	shm->nent    = MM_LOCK_SLOTS;
+	shm->entSize = sizeof(LOCK_ENT);
+	__atomic_store_n( &shm->magic, LOCK_MAGIC, __ATOMIC_RELEASE );
+	return 0;
+}
+
+/******************************* mm_lock_init ******************************/
+/**   Open (and if needed create) the lock segment and enable locking.
+ *
+ *    Must be called before slots are attached and worker threads are
+ *    started.
+ *---------------------------------------------------------------------------
+ *  \param name			\IN shm_open() name (NULL=MM_LOCK_SHM)
+ *  \param timeoutMs	\IN max. wait for a busy slot (0=MM_LOCK_TIMEOUT_MS)
+ *  \return 0=ok, -1=error (errno set)
+ ****************************************************************************/
+int mm_lock_init( const char *name, uint32_t timeoutMs )
+{
+	LOCK_SHM *shm = MAP_FAILED;
+	struct stat st;
+	int fd, err = 0;
+
+	if( (fd = shm_open( name ? name : MM_LOCK_SHM, O_RDWR | O_CREAT,
+						0600 )) < 0 )
+		return -1;
+
+	/* only one process may create the segment */
+	if( flock( fd, LOCK_EX ) || fstat( fd, &st ) ||
+		((size_t)st.st_size < sizeof(LOCK_SHM) &&
+		 ftruncate( fd, sizeof(LOCK_SHM) )) ||
+		(shm = mmap( NULL, sizeof(LOCK_SHM), PROT_READ | PROT_WRITE,
+					 MAP_SHARED, fd, 0 )) == MAP_FAILED )
+		err = errno;
+	else if( __atomic_load_n( &shm->magic, __ATOMIC_ACQUIRE ) != LOCK_MAGIC ){
+		if( _lock_shm_init( shm ) )
+			err = ENOMEM;
+	}
+	else if( shm->version != LOCK_VERSION || shm->nent != MM_LOCK_SLOTS ||
+			 shm->entSize != sizeof(LOCK_ENT) )
+		err = EPROTO;
+	/* the mapping keeps the file open, close() wouldn't release the flock */
+	flock( fd, LOCK_UN );
+	close( fd );
+
+	if( err ){
+		if( shm != MAP_FAILED )
+			munmap( shm, sizeof(LOCK_SHM) );
+		errno = err;
+		return -1;
+	}
+
+	G_lockTimeoutMs = timeoutMs ? timeoutMs : MM_LOCK_TIMEOUT_MS;
+	G_lockShm = shm;
+	return 0;
+}
+
+/******************************* mm_lock_exit ******************************/
+/**   Disable locking and unmap the segment.
+ *
+ *    No EEPROM function may run at the same time.
+ ****************************************************************************/
+void mm_lock_exit( void )
+{
+	if( !G_lockShm )
+		return;
+	munmap( G_lockShm, sizeof(LOCK_SHM) );
+	G_lockShm = NULL;
+	G_lockMapN = 0;
+}
+
+/******************************* _lock_claim *******************************/
+/**   Find or claim the entry of a slot in the segment.
+ *---------------------------------------------------------------------------
+ *  \param phys			\IN physical slot address
+ *  \return entry index or -1 (table full)
+ ****************************************************************************/
+static int _lock_claim( uint64_t phys )
+{
+	uint32_t h = (uint32_t)((phys >> 9) ^ (phys >> 21)) % MM_LOCK_SLOTS;
+	uint64_t cur;
+	int n, i;
+
+	for( n=0; n<MM_LOCK_SLOTS; n++ ){
+		i = (int)((h + n) % MM_LOCK_SLOTS);
+		cur = __atomic_load_n( &G_lockShm->ent[i].phys, __ATOMIC_ACQUIRE );
+		if( cur == 0 &&
+			__atomic_compare_exchange_n( &G_lockShm->ent[i].phys, &cur, phys,
+										 0, __ATOMIC_ACQ_REL,
+										 __ATOMIC_ACQUIRE ) )
+			return i;
+		if( cur == phys )
+			return i;
+	}
+	return -1;
+}
+
+/******************************* mm_lock_attach ****************************/
+/**   Let the EEPROM functions lock a slot of this process.
+ *
+ *    Does nothing if locking isn't enabled.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN address passed to m_read() & co.
+ *  \param phys			\IN physical slot address (the lock key)
+ *  \return 0=ok, -1=lock table full
+ ****************************************************************************/
+int mm_lock_attach( uintptr_t base, uint64_t phys )
+{
+	int ent, i, ret = 0;
+
+	if( !G_lockShm || !base )
+		return 0;
+	if( !phys || (ent = _lock_claim( phys )) < 0 )
+		return -1;
+
+	pthread_mutex_lock( &G_lockMapMtx );
+	for( i=0; i<G_lockMapN; i++ )
+		if( G_lockMap[i].base == base || G_lockMap[i].base == 0 )
+			break;
+	if( i == MM_LOCK_SLOTS )
+		ret = -1;
+	else {
+		/* readers don't lock: publish the entry before the address */
+		G_lockMap[i].ent = ent;
+		__atomic_store_n( &G_lockMap[i].base, base, __ATOMIC_RELEASE );
+		if( i == G_lockMapN )
+			__atomic_store_n( &G_lockMapN, i + 1, __ATOMIC_RELEASE );
+	}
+	pthread_mutex_unlock( &G_lockMapMtx );
+	return ret;
+}
+
+/******************************* mm_lock_detach ****************************/
+/**   Stop locking a slot, e.g. before it is unmapped.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN address passed to mm_lock_attach()
+ ****************************************************************************/
+void mm_lock_detach( uintptr_t base )
+{
+	int i;
+
+	if( !G_lockShm || !base )
+		return;
+	pthread_mutex_lock( &G_lockMapMtx );
+	for( i=0; i<G_lockMapN; i++ )
+		if( G_lockMap[i].base == base )
+			__atomic_store_n( &G_lockMap[i].base, 0, __ATOMIC_RELEASE );
+	pthread_mutex_unlock( &G_lockMapMtx );
+}
+
+/******************************* _lock_find ********************************/
+/**   Entry of an attached slot.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN slot address
+ *  \return entry index or -1 (not attached)
+ ****************************************************************************/
+static int _lock_find( uintptr_t base )
+{
+	int i, n = __atomic_load_n( &G_lockMapN, __ATOMIC_ACQUIRE );
+
+	for( i=0; i<n; i++ )
+		if( __atomic_load_n( &G_lockMap[i].base, __ATOMIC_ACQUIRE ) == base )
+			return G_lockMap[i].ent;
+	return -1;
+}
+
+/******************************* _lock_mtx_take ****************************/
+/**   Lock the mutex of an entry, recover it if the owner died.
+ *---------------------------------------------------------------------------
+ *  \param ent			\IN entry index
+ *  \param wait			\IN wait up to the timeout if busy
+ *  \return 0=ok, 1=busy, timeout or lock unusable
+ ****************************************************************************/
+static int _lock_mtx_take( int ent, int wait )
+{
+	pthread_mutex_t *mtx = &G_lockShm->ent[ent].mtx;
+	struct timespec ts;
+	uint64_t t0;
+	int err;
+
+	if( (err = pthread_mutex_trylock( mtx )) == EBUSY && wait ){
+		CNT_ADD( waited, 1 );
+		t0 = mm_time_ns();
+		clock_gettime( CLOCK_REALTIME, &ts );
+		ts.tv_sec  += G_lockTimeoutMs / 1000;
+		ts.tv_nsec += (long)(G_lockTimeoutMs % 1000) * 1000000;
+		if( ts.tv_nsec >= 1000000000 ){
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		err = pthread_mutex_timedlock( mtx, &ts );
+		CNT_ADD( waitNs, mm_time_ns() - t0 );
+	}
+
+	/*
+	 * the owner died, maybe in the middle of an instruction: the next
+	 * _select() resets the EEPROM with CS low, so just take over
+	 */
+	if( err == EOWNERDEAD ){
+		CNT_ADD( recovered, 1 );
+		err = pthread_mutex_consistent( mtx );
+	}
+	if( err ){
+		if( err == ETIMEDOUT )
+			CNT_ADD( timeouts, 1 );
+		return 1;
+	}
+
+	CNT_ADD( taken, 1 );
+	return 0;
+}
+
+/******************************* _lock_ent_take ****************************/
+/**   Lock an entry for the calling thread, nested locks only count.
+ *---------------------------------------------------------------------------
+ *  \param ent			\IN entry index
+ *  \param wait			\IN wait up to the timeout if busy
+ *  \return 0=ok, 1=busy, timeout or lock unusable
+ ****************************************************************************/
+static int _lock_ent_take( int ent, int wait )
+{
+	int i;
+
+	for( i=0; i<G_lockHeldN; i++ ){
+		if( G_lockHeld[i].ent == ent ){
+			G_lockHeld[i].depth++;
+			return 0;
+		}
+	}
+	if( G_lockHeldN == LOCK_HELD || _lock_mtx_take( ent, wait ) )
+		return 1;
+
+	G_lockHeld[G_lockHeldN].ent   = ent;
+	G_lockHeld[G_lockHeldN].depth = 1;
+	G_lockHeldN++;
+	return 0;
+}
+
+/******************************* _lock_ent_give ****************************/
+/**   Unlock an entry held by the calling thread.
+ *---------------------------------------------------------------------------
+ *  \param ent			\IN entry index
+ ****************************************************************************/
+static void _lock_ent_give( int ent )
+{
+	int i;
+
+	for( i=0; i<G_lockHeldN; i++ )
+		if( G_lockHeld[i].ent == ent )
+			break;
+	if( i == G_lockHeldN || --G_lockHeld[i].depth )
+		return;
+
+	pthread_mutex_unlock( &G_lockShm->ent[ent].mtx );
+	G_lockHeld[i] = G_lockHeld[--G_lockHeldN];
+}
+
+/******************************* mm_lock_take ******************************/
+/**   Lock a slot for one transaction.
+ *
+ *    Waits up to the timeout of mm_lock_init() if another process or
+ *    thread holds the slot. Nested calls of the same thread only count.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN slot address
+ *  \return 0=ok (or slot not attached), 1=timeout
+ ****************************************************************************/
+int mm_lock_take( uintptr_t base )
+{
+	int ent;
+
+	if( !G_lockShm || (ent = _lock_find( base )) < 0 )
+		return 0;
+	return _lock_ent_take( ent, 1 );
+}
+
+/******************************* mm_lock_try *******************************/
+/**   Lock a slot without waiting, nests like mm_lock_take().
+ *
+ *    A thread can hold only a few slots this way (m_read_lockstep()
+ *    needs the most), transactions on many slots use mm_lock_try_tx().
+ *---------------------------------------------------------------------------
+ *  \param base			\IN slot address
+ *  \return 0=ok (or slot not attached), 1=busy
+ ****************************************************************************/
+int mm_lock_try( uintptr_t base )
+{
+	int ent;
+
+	if( !G_lockShm || (ent = _lock_find( base )) < 0 )
+		return 0;
+	return _lock_ent_take( ent, 0 );
+}
+
+/******************************* mm_lock_try_tx ****************************/
+/**   Lock a slot for a transaction driven from an event loop.
+ *
+ *    Like mm_lock_try(), but the lock is not kept in the list of the
+ *    calling thread: there is no limit on the number of slots locked
+ *    this way and it doesn't nest. The thread must release it with
+ *    mm_lock_give_tx() and must not lock the same slot otherwise
+ *    meanwhile (the EEPROM step functions m_instr() & co. don't lock).
+ *---------------------------------------------------------------------------
+ *  \param base			\IN slot address
+ *  \return 0=ok (or slot not attached), 1=busy
+ ****************************************************************************/
+int mm_lock_try_tx( uintptr_t base )
+{
+	int ent;
+
+	if( !G_lockShm || (ent = _lock_find( base )) < 0 )
+		return 0;
+	return _lock_mtx_take( ent, 0 );
+}
+
+/******************************* mm_lock_give_tx ***************************/
+/**   Unlock a slot locked with mm_lock_try_tx().
+ *---------------------------------------------------------------------------
+ *  \param base			\IN slot address
+ ****************************************************************************/
+void mm_lock_give_tx( uintptr_t base )
+{
+	int ent;
+
+	if( !G_lockShm || (ent = _lock_find( base )) < 0 )
+		return;
+	pthread_mutex_unlock( &G_lockShm->ent[ent].mtx );
+}
+
+/******************************* mm_lock_timeout_ms ************************/
+/**   Wait for a busy slot set by mm_lock_init().
+ *---------------------------------------------------------------------------
+ *  \return timeout (ms)
+ ****************************************************************************/
+uint32_t mm_lock_timeout_ms( void )
+{
+	return G_lockTimeoutMs;
+}
+
+/******************************* mm_lock_give ******************************/
+/**   Unlock a slot locked with mm_lock_take().
+ *---------------------------------------------------------------------------
+ *  \param base			\IN slot address
+ ****************************************************************************/
+void mm_lock_give( uintptr_t base )
+{
+	int ent;
+
+	if( !G_lockShm || (ent = _lock_find( base )) < 0 )
+		return;
+	_lock_ent_give( ent );
+}
+
+/******************************* mm_lock_take_n ****************************/
+/**   Lock several slots, e.g. for a lockstep read.
+ *
+ *    The slots are locked in the order of their entries in the segment,
+ *    which is the same in all processes, so overlapping groups can't
+ *    deadlock. Either all slots are locked or none.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN slot addresses
+ *  \param n			\IN number of slots (max. MM_LOCKSTEP_MAX)
+ *  \return 0=ok, 1=timeout
+ ****************************************************************************/
+int mm_lock_take_n( const uintptr_t *base, int n )
+{
+	int ent[MM_LOCKSTEP_MAX];
+	int i, j, k, e;
+
+	if( !G_lockShm )
+		return 0;
+	if( n > MM_LOCKSTEP_MAX )
+		return 1;
+
+	/* insertion sort of the attached entries */
+	for( i=0, k=0; i<n; i++ ){
+		if( (e = _lock_find( base[i] )) < 0 )
+			continue;
+		for( j=k++; j>0 && ent[j-1] > e; j-- )
+			ent[j] = ent[j-1];
+		ent[j] = e;
+	}
+
+	for( i=0; i<k; i++ ){
+		if( _lock_ent_take( ent[i], 1 ) ){
+			while( i-- )
+				_lock_ent_give( ent[i] );
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/******************************* mm_lock_give_n ****************************/
+/**   Unlock slots locked with mm_lock_take_n().
+ *---------------------------------------------------------------------------
+ *  \param base			\IN slot addresses
+ *  \param n			\IN number of slots
+ ****************************************************************************/
+void mm_lock_give_n( const uintptr_t *base, int n )
+{
+	int i;
+
+	for( i=0; i<n; i++ )
+		mm_lock_give( base[i] );
+}
+
+/******************************* mm_lock_get_cnt ***************************/
+/**   Get the lock counters of this process.
+ *---------------------------------------------------------------------------
+ *  \param cnt			\OUT counters
+ ****************************************************************************/
+void mm_lock_get_cnt( MM_LOCK_CNT *cnt )
+{
+	cnt->taken     = __atomic_load_n( &G_lockCnt.taken, __ATOMIC_RELAXED );
+	cnt->waited    = __atomic_load_n( &G_lockCnt.waited, __ATOMIC_RELAXED );
+	cnt->timeouts  = __atomic_load_n( &G_lockCnt.timeouts, __ATOMIC_RELAXED );
+	cnt->recovered = __atomic_load_n( &G_lockCnt.recovered, __ATOMIC_RELAXED );
+	cnt->waitNs    = __atomic_load_n( &G_lockCnt.waitNs, __ATOMIC_RELAXED );
+}
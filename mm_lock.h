@@ -0,0 +1,67 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_lock.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Cross-process per-slot locks.
+ *
+ *               One robust, process-shared mutex per physical slot address
+ *               in a small shared memory segment. The EEPROM functions hold
+ *               it for one transaction (a read, a programming run), so
+ *               processes that use the locks can work on different slots
+ *               at the same time without disturbing each other's MODREG
+ *               accesses on the same slot.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_LOCK_H
+#define _MM_LOCK_H
+
+#include <stdint.h>
+
+#define MM_LOCK_SHM			"/mm_ident.lock"	/* shm_open() name */
+#define MM_LOCK_SLOTS		256		/* slot addresses in the segment */
+#define MM_LOCK_TIMEOUT_MS	1000	/* default wait for a busy slot */
+
+/** lock counters of this process */
+typedef struct MM_LOCK_CNT {
+	uint64_t taken;				/**< transactions locked */
+	uint64_t waited;			/**< slot was busy */
+	uint64_t timeouts;			/**< gave up after the timeout */
+	uint64_t recovered;			/**< owner died holding the lock */
+	uint64_t waitNs;			/**< time spent waiting */
+} MM_LOCK_CNT;
+
+int mm_lock_init( const char *name, uint32_t timeoutMs );
+void mm_lock_exit( void );
+int mm_lock_attach( uintptr_t base, uint64_t phys );
+void mm_lock_detach( uintptr_t base );
+int mm_lock_take( uintptr_t base );
+int mm_lock_try( uintptr_t base );
+int mm_lock_try_tx( uintptr_t base );
+void mm_lock_give_tx( uintptr_t base );
+uint32_t mm_lock_timeout_ms( void );
+int mm_lock_take_n( const uintptr_t *base, int n );
+void mm_lock_give( uintptr_t base );
+void mm_lock_give_n( const uintptr_t *base, int n );
+void mm_lock_get_cnt( MM_LOCK_CNT *cnt );
+
+#endif /* _MM_LOCK_H */
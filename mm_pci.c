@@ -0,0 +1,207 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_pci.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Find M-Module carriers in /sys/bus/pci/devices and add
+ *               their slots to a scan list. The slots are mapped through
+ *               the sysfs resource file of the carrier BAR, /dev/mem is
+ *               not needed.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mm_eeprom.h"
+#include "mm_pci.h"
+
+/** known carriers */
+const MM_CARRIER_TYPE MM_CarrierTbl[] = {
+	/* Altera based F204/F205, A08 slots */
+	{ 0x1172, 0xd203, 0xff00, 0xff00, "F204/F205", 0,
+	  2, { MM_F204_SLOT0, MM_F204_SLOT1 }, MM_ACCESS_F204 },
+	{ 0 }
+};
+
+/******************************* _pci_read_id ******************************/
+/**   Read a hex ID file of a PCI device.
+ *---------------------------------------------------------------------------
+ *  \param dir			\IN device directory
+ *  \param name			\IN attribute name
+ *  \param id			\OUT value, unchanged on error
+ *  \return 0=ok, -1=error
+ ****************************************************************************/
+static int _pci_read_id( const char *dir, const char *name, uint16_t *id )
+{
+	char path[512];
+	unsigned int val;
+	FILE *fp;
+	int ok;
+
+	if( (size_t)snprintf( path, sizeof(path), "%s/%s", dir, name ) >=
+		sizeof(path) || !(fp = fopen( path, "r" )) )
+		return -1;
+	ok = (fscanf( fp, "%x", &val ) == 1);
+	fclose( fp );
+
+	if( !ok )
+		return -1;
+	*id = (uint16_t)val;
+	return 0;
+}
+
+/******************************* _pci_bar_addr *****************************/
+/**   Get the physical address of a BAR from the sysfs resource file.
+ *---------------------------------------------------------------------------
+ *  \param dir			\IN device directory
+ *  \param bar			\IN BAR number
+ *  \return physical address or 0 if unknown
+ ****************************************************************************/
+static uint64_t _pci_bar_addr( const char *dir, int bar )
+{
+	char path[512], line[128];
+	unsigned long long start = 0;
+	FILE *fp;
+	int i;
+
+	if( (size_t)snprintf( path, sizeof(path), "%s/resource", dir ) >=
+		sizeof(path) || !(fp = fopen( path, "r" )) )
+		return 0;
+
+	for( i=0; i<=bar && fgets( line, sizeof(line), fp ); i++ )
+		if( i == bar && sscanf( line, "%llx", &start ) != 1 )
+			start = 0;
+
+	fclose( fp );
+	return start;
+}
+
+/******************************* _pci_match *******************************/
+/**   Look up a PCI device in the carrier table.
+ *---------------------------------------------------------------------------
+ *  \param dir			\IN device directory
+ *  \return carrier type or NULL
+ ****************************************************************************/
+static const MM_CARRIER_TYPE *_pci_match( const char *dir )
+{
+	const MM_CARRIER_TYPE *t;
+	uint16_t ven, dev, subVen = MM_PCI_ANY, subDev = MM_PCI_ANY;
+
+	if( _pci_read_id( dir, "vendor", &ven ) ||
+		_pci_read_id( dir, "device", &dev ) )
+		return NULL;
+	/* missing or unreadable: keep MM_PCI_ANY */
+	_pci_read_id( dir, "subsystem_vendor", &subVen );
+	_pci_read_id( dir, "subsystem_device", &subDev );
+
+	for( t = MM_CarrierTbl; t->name; t++ ){
+		if( t->vendor == ven && t->device == dev &&
+			(t->subVendor == MM_PCI_ANY || t->subVendor == subVen) &&
+			(t->subDevice == MM_PCI_ANY || t->subDevice == subDev) )
+			return t;
+	}
+	return NULL;
+}
+
+/******************************* _pci_cmp **********************************/
+/**   qsort() compare for PCI device names.
+ ****************************************************************************/
+static int _pci_cmp( const void *a, const void *b )
+{
+	return strcmp( *(char * const *)a, *(char * const *)b );
+}
+
+/******************************* mm_pci_discover ***************************/
+/**   Add the slots of all known carriers to a scan list.
+ *
+ *    Walks <sysfs>/bus/pci/devices in bus order and matches every device
+ *    against MM_CarrierTbl. The slots of a matching carrier are mapped
+ *    through its resource<bar> file.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param sysfs		\IN sysfs mount point (NULL=MM_PCI_SYSFS)
+ *  \return number of carriers found or -1 on error
+ ****************************************************************************/
+int mm_pci_discover( MM_SCAN *scan, const char *sysfs )
+{
+	const MM_CARRIER_TYPE *t;
+	char path[512], dir[512], res[512], **names = NULL, **tmp;
+	struct dirent *de;
+	uint64_t bar;
+	int i, j, n = 0, max = 0, found = 0, err = 0;
+	DIR *dp;
+
+	snprintf( path, sizeof(path), "%s/bus/pci/devices",
+			  sysfs ? sysfs : MM_PCI_SYSFS );
+	if( !(dp = opendir( path )) )
+		return -1;
+
+	while( (de = readdir( dp )) ){
+		if( de->d_name[0] == '.' )
+			continue;
+		if( n == max ){
+			max = max ? 2 * max : 32;
+			if( !(tmp = realloc( names, max * sizeof(*names) )) ){
+				err = 1;
+				break;
+			}
+			names = tmp;
+		}
+		if( !(names[n] = strdup( de->d_name )) ){
+			err = 1;
+			break;
+		}
+		n++;
+	}
+	closedir( dp );
+
+	qsort( names, n, sizeof(*names), _pci_cmp );
+
+	for( i=0; i<n && !err; i++ ){
+		/* skip devices whose paths don't fit */
+		if( (size_t)snprintf( dir, sizeof(dir), "%s/%s", path, names[i] ) >=
+			sizeof(dir) || !(t = _pci_match( dir )) )
+			continue;
+		if( (size_t)snprintf( res, sizeof(res), "%s/resource%d", dir,
+							  t->bar ) >= sizeof(res) )
+			continue;
+
+		bar = _pci_bar_addr( dir, t->bar );
+		if( mm_scan_add_carrier_res( scan, t->name, names[i], res,
+									 bar, t->nslots, t->slotOff ) ){
+			err = 1;
+			continue;
+		}
+		for( j=scan->nslots - t->nslots; j<scan->nslots; j++ )
+			scan->slot[j].timing.access = t->access;
+		found++;
+	}
+
+	for( i=0; i<n; i++ )
+		free( names[i] );
+	free( names );
+
+	return err ? -1 : found;
+}
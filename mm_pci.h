@@ -0,0 +1,55 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_pci.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Discovery of M-Module carriers via sysfs PCI enumeration.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_PCI_H
+#define _MM_PCI_H
+
+#include <stdint.h>
+#include "mm_scan.h"
+
+#define MM_PCI_ANY			0xffff	/* wildcard for IDs in carrier table */
+#define MM_PCI_SYSFS		"/sys"	/* default sysfs mount point */
+#define MM_CARRIER_SLOTS	4		/* max. M-Module slots per carrier */
+
+/** known M-Module carrier */
+typedef struct MM_CARRIER_TYPE {
+	uint16_t    vendor;				/**< PCI vendor ID */
+	uint16_t    device;				/**< PCI device ID */
+	uint16_t    subVendor;			/**< subsystem vendor ID or MM_PCI_ANY */
+	uint16_t    subDevice;			/**< subsystem ID or MM_PCI_ANY */
+	const char *name;				/**< carrier name */
+	int         bar;				/**< BAR with the M-Module slots */
+	int         nslots;				/**< number of slots */
+	uint32_t    slotOff[MM_CARRIER_SLOTS];	/**< A08 slot offsets in BAR */
+	int         access;				/**< MM_ACCESS_xxx register access */
+} MM_CARRIER_TYPE;
+
+extern const MM_CARRIER_TYPE MM_CarrierTbl[];
+
+int mm_pci_discover( MM_SCAN *scan, const char *sysfs );
+
+#endif /* _MM_PCI_H */
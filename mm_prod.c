@@ -0,0 +1,127 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_prod.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Product database: M-Module id to name, description and
+ *               MDIS driver.
+ *
+ *               The products are listed once below; the table and the
+ *               lookup switch are generated from the list by the
+ *               preprocessor, so a lookup is a jump on the mod-id and
+ *               nothing is built at run time.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include "mm_eeprom.h"
+#include "mm_prod.h"
+
+/* mod-id of MxxN modules (MSxx: MOD_ID_MS_MASK), see m_decode_modinfo() */
+#define N(n)	(MOD_ID_N_MASK | (n))
+
+/*
+ * X( tag, mod-id, name, description, driver, descriptor template )
+ *
+ * Products with the same mod-id but a different product variant are
+ * added to PROD_VARIANT_LIST with the variant as additional parameter
+ * after the mod-id; they are checked before PROD_LIST.
+ */
+#define PROD_LIST(X) \
+	X( M31,  31,    "M31",  "16 binary inputs",          "men_ll_m31", "m31_min.dsc" ) \
+	X( M32,  32,    "M32",  "16 binary outputs",         "men_ll_m31", "m32_min.dsc" ) \
+	X( M33,  33,    "M33",  "8 analog outputs",          "men_ll_m33", "m33_min.dsc" ) \
+	X( M34,  34,    "M34",  "16 analog inputs, 12 bit",  "men_ll_m34", "m34_min.dsc" ) \
+	X( M35,  35,    "M35",  "16 analog inputs, 14 bit",  "men_ll_m34", "m35_min.dsc" ) \
+	X( M36,  36,    "M36",  "16 analog inputs, 16 bit",  "men_ll_m36", "m36_min.dsc" ) \
+	X( M37,  37,    "M37",  "4 analog outputs, 16 bit",  "men_ll_m37", "m37_min.dsc" ) \
+	X( M43,  43,    "M43",  "8 relay outputs",           "men_ll_m43", "m43_min.dsc" ) \
+	X( M45N, N(45), "M45N", "8 serial interfaces",       "men_lx_m77", NULL          ) \
+	X( M47,  47,    "M47",  "SSI interface",             "men_ll_m47", "m47_min.dsc" ) \
+	X( M58,  58,    "M58",  "32 binary I/O",             "men_ll_m58", "m58_min.dsc" ) \
+	X( M62,  62,    "M62",  "16 analog outputs",         "men_ll_m62", "m62_min.dsc" ) \
+	X( M66,  66,    "M66",  "32 binary I/O",             "men_ll_m66", "m66_min.dsc" ) \
+	X( M69N, N(69), "M69N", "4 serial interfaces",       "men_lx_m77", NULL          ) \
+	X( M72,  72,    "M72",  "motion counter",            "men_ll_m72", "m72_min.dsc" ) \
+	X( M77,  77,    "M77",  "4 serial interfaces",       "men_lx_m77", NULL          ) \
+	X( M99,  99,    "M99",  "timer/test module",         "men_ll_m99", "m99_min.dsc" )
+
+#define PROD_VARIANT_LIST(X)
+
+#define PROD_IDX(tag, ...)				PROD_##tag,
+#define PROD_ENT(tag, modid, ...)		{ modid, MM_PROD_ANY_VARIANT, __VA_ARGS__ },
+#define PROD_VAR_ENT(tag, modid, var, ...)	{ modid, var, __VA_ARGS__ },
+#define PROD_CASE(tag, modid, ...) \
+	case modid: return &G_prod[PROD_##tag];
+#define PROD_VAR_CASE(tag, modid, var, ...) \
+	case ((uint32_t)(modid) << 16) | (var): return &G_prod[PROD_##tag];
+
+enum { PROD_LIST(PROD_IDX) PROD_VARIANT_LIST(PROD_IDX) PROD_NUM };
+
+static const MM_PROD G_prod[] = {
+	PROD_LIST(PROD_ENT)
+	PROD_VARIANT_LIST(PROD_VAR_ENT)
+};
+
+/******************************* mm_prod_find ******************************/
+/**   Look up the product of identified M-Module.
+ *---------------------------------------------------------------------------
+ *  \param words		\IN raw id words 0, 1, 2, 8 (see m_getmodinfo_raw())
+ *  \return product or NULL (unknown or not a MEN M-Module)
+ ****************************************************************************/
+const MM_PROD *mm_prod_find( const uint16_t *words )
+{
+	if( words[0] != MOD_ID_MAGIC )
+		return NULL;
+
+	switch( ((uint32_t)words[1] << 16) | words[3] ){
+		PROD_VARIANT_LIST(PROD_VAR_CASE)
+	default:
+		break;
+	}
+	switch( words[1] ){
+		PROD_LIST(PROD_CASE)
+	default:
+		return NULL;
+	}
+}
+
+/******************************* mm_prod_count *****************************/
+/**   Number of known products.
+ *---------------------------------------------------------------------------
+ *  \return number of products
+ ****************************************************************************/
+int mm_prod_count( void )
+{
+	return PROD_NUM;
+}
+
+/******************************* mm_prod_get *******************************/
+/**   Get a known product.
+ *---------------------------------------------------------------------------
+ *  \param i			\IN index (0..mm_prod_count()-1)
+ *  \return product or NULL
+ ****************************************************************************/
+const MM_PROD *mm_prod_get( int i )
+{
+	return (i >= 0 && i < PROD_NUM) ? &G_prod[i] : NULL;
+}
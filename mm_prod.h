@@ -0,0 +1,51 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_prod.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Product database: M-Module id to name, description and
+ *               MDIS driver.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_PROD_H
+#define _MM_PROD_H
+
+#include <stdint.h>
+
+#define MM_PROD_ANY_VARIANT	-1		/* MM_PROD.variant: all variants */
+
+/** one product */
+typedef struct MM_PROD {
+	uint16_t    modid;			/**< mod-id incl. MS/N prefix (word 1) */
+	int32_t     variant;		/**< product variant (word 8) or -1 */
+	const char *name;			/**< canonical name, e.g. "M45N" */
+	const char *desc;			/**< short description */
+	const char *driver;			/**< kernel module */
+	const char *dsc;			/**< MDIS descriptor template, NULL=native
+									 driver without descriptor */
+} MM_PROD;
+
+const MM_PROD *mm_prod_find( const uint16_t *words );
+int mm_prod_count( void );
+const MM_PROD *mm_prod_get( int i );
+
+#endif /* _MM_PROD_H */
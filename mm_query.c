@@ -0,0 +1,217 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_query.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Lazy per-field ID PROM queries with a per-slot memo.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "mm_eeprom.h"
+#include "mm_query.h"
+
+#define W(n)	((uint64_t)1 << (n))
+#define W_ALL	(~(uint64_t)0 >> (64 - MM_EE_WORDS))
+
+/** field names for mm_query_parse() */
+static const struct {
+	const char *name;
+	uint32_t    fields;
+} G_fieldName[] = {
+	{ "magic",		MM_QF_MAGIC },
+	{ "modid",		MM_QF_MODID },
+	{ "layout",		MM_QF_LAYOUT },
+	{ "variant",	MM_QF_VARIANT },
+	{ "serial",		MM_QF_SERIAL },
+	{ "type",		MM_QF_TYPE },
+	{ "name",		MM_QF_NAME },
+	{ "raw",		MM_QF_RAW },
+	{ "all",		0xff },
+};
+
+/******************************* mm_query_init *****************************/
+/**   Forget all words read, e.g. after the EEPROM was programmed.
+ *---------------------------------------------------------------------------
+ *  \param q			\OUT memo
+ ****************************************************************************/
+void mm_query_init( MM_QUERY *q )
+{
+	memset( q, 0, sizeof(*q) );
+}
+
+/******************************* mm_query_parse ****************************/
+/**   Convert a comma separated list of field names to MM_QF_xxx flags.
+ *
+ *    Names: magic, modid, layout, variant, serial, type, name, raw, all.
+ *---------------------------------------------------------------------------
+ *  \param str			\IN e.g. "type,serial"
+ *  \param fields		\OUT MM_QF_xxx flags
+ *  \return 0=ok, 1=unknown name
+ ****************************************************************************/
+int mm_query_parse( const char *str, uint32_t *fields )
+{
+	const char *end;
+	size_t len, i;
+
+	*fields = 0;
+	while( *str ){
+		end = strchr( str, ',' );
+		len = end ? (size_t)(end - str) : strlen( str );
+
+		for( i=0; i<sizeof(G_fieldName)/sizeof(G_fieldName[0]); i++ )
+			if( strlen(G_fieldName[i].name) == len &&
+				!strncmp( G_fieldName[i].name, str, len ) )
+				break;
+		if( i == sizeof(G_fieldName)/sizeof(G_fieldName[0]) )
+			return 1;
+
+		*fields |= G_fieldName[i].fields;
+		str += len + (end ? 1 : 0);
+	}
+	return *fields ? 0 : 1;
+}
+
+/******************************* _query_read *******************************/
+/**   Read the words of a mask that are not in the memo yet.
+ *
+ *    Runs of consecutive missing words are read with one instruction
+ *    each. The first read of a slot also probes it; the words of an empty
+ *    slot or one with DO stuck low are set without further reads.
+ *---------------------------------------------------------------------------
+ *  \param q			\INOUT memo
+ *  \param base			\IN base address pointer
+ *  \param need			\IN bit n: word n is needed
+ *  \return 0=ok, 1=error
+ ****************************************************************************/
+static int _query_read( MM_QUERY *q, uintptr_t base, uint64_t need )
+{
+	uint64_t miss = need & ~q->valid;
+	int first, count, probe, i;
+
+	if( miss && q->valid && q->probe != MM_PROBE_PRESENT ){
+		/* level seen on DO, as _read_words() sets it */
+		for( i=0; i<MM_EE_WORDS; i++ )
+			if( miss & W(i) )
+				q->words[i] = q->probe == MM_PROBE_EMPTY ? 0xffff : 0;
+		q->valid |= miss;
+		return 0;
+	}
+
+	for( first=0; first<MM_EE_WORDS; first += count ){
+		if( !(miss & W(first)) ){
+			count = 1;
+			continue;
+		}
+		for( count=1; first + count < MM_EE_WORDS &&
+				 (miss & W(first + count)); count++ )
+			;
+
+		if( m_read_range_probe( base, (uint8_t)first, (uint8_t)count,
+								&q->words[first], &probe ) )
+			return 1;
+		if( !q->valid )
+			q->probe = probe;
+		q->valid |= (W_ALL >> (MM_EE_WORDS - count)) << first;
+
+		if( q->probe != MM_PROBE_PRESENT )
+			return _query_read( q, base, need );
+	}
+	return 0;
+}
+
+/******************************* mm_query **********************************/
+/**   Get fields of the EEPROM, reading only the words they need.
+ *
+ *    Words read earlier for the same memo are not read again. The type
+ *    needs word 0 only if it holds the MEN magic-id (which means a MEN
+ *    module here, even if all four id words are equal), otherwise words
+ *    1, 2 and 8 are read and evaluated as by m_getmodinfo(). The name is
+ *    built from the mod-id for MEN modules and is empty otherwise.
+ *
+ *    The bit timing of the calling thread is used.
+ *---------------------------------------------------------------------------
+ *  \param q			\INOUT memo of the slot
+ *  \param base			\IN base address pointer
+ *  \param fields		\IN MM_QF_xxx flags
+ *  \param res			\OUT result
+ *  \return 0=ok, 1=read error
+ ****************************************************************************/
+int mm_query( MM_QUERY *q, uintptr_t base, uint32_t fields, MM_QUERY_RES *res )
+{
+	uint64_t need = 0;
+	uint16_t id[4];
+	uint32_t devid, devrev;
+
+	memset( res, 0, sizeof(*res) );
+
+	if( fields & (MM_QF_MAGIC | MM_QF_TYPE | MM_QF_NAME) )
+		need |= W(MM_EE_MAGIC);
+	if( fields & (MM_QF_MODID | MM_QF_NAME) )
+		need |= W(MM_EE_MODID);
+	if( fields & MM_QF_LAYOUT )
+		need |= W(MM_EE_LAYOUT);
+	if( fields & MM_QF_VARIANT )
+		need |= W(MM_EE_VARIANT);
+	if( fields & MM_QF_SERIAL )
+		need |= W(MM_EE_SERIAL_HI) | W(MM_EE_SERIAL_LO);
+	if( fields & MM_QF_RAW )
+		need = W_ALL;
+	if( !need )
+		return 0;
+
+	if( _query_read( q, base, need ) )
+		return 1;
+
+	res->fields  = fields;
+	res->probe   = q->probe;
+	res->magic   = q->words[MM_EE_MAGIC];
+	res->modid   = q->words[MM_EE_MODID];
+	res->layout  = q->words[MM_EE_LAYOUT];
+	res->variant = q->words[MM_EE_VARIANT];
+	res->serial  = ((uint32_t)q->words[MM_EE_SERIAL_HI] << 16) |
+		q->words[MM_EE_SERIAL_LO];
+	if( fields & MM_QF_RAW )
+		res->raw = q->words;
+
+	if( !(fields & (MM_QF_TYPE | MM_QF_NAME)) )
+		return 0;
+
+	if( q->probe != MM_PROBE_PRESENT )
+		res->modtype = 0;
+	else if( res->magic == MOD_ID_MAGIC ){
+		res->modtype = MODCOM_MOD_MEN;
+		if( fields & MM_QF_NAME )
+			m_modname( res->modid, res->devname );
+	}
+	else {
+		if( _query_read( q, base, W(MM_EE_MODID) | W(MM_EE_LAYOUT) |
+						 W(MM_EE_VARIANT) ) )
+			return 1;
+		id[0] = q->words[MM_EE_MAGIC];
+		id[1] = q->words[MM_EE_MODID];
+		id[2] = q->words[MM_EE_LAYOUT];
+		id[3] = q->words[MM_EE_VARIANT];
+		m_decode_modinfo( id, &res->modtype, &devid, &devrev, res->devname );
+	}
+	return 0;
+}
@@ -0,0 +1,76 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_query.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Lazy per-field ID PROM queries.
+ *
+ *               A query names the fields it needs (MM_QF_xxx); only the
+ *               words behind them are read, words already read for the
+ *               slot are taken from its MM_QUERY memo. The module type
+ *               costs one word for MEN modules, the serial number two.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_QUERY_H
+#define _MM_QUERY_H
+
+#include <stdint.h>
+#include "mm_eeprom.h"
+
+/* fields */
+#define MM_QF_MAGIC		0x0001		/* magic-id (word 0) */
+#define MM_QF_MODID		0x0002		/* mod-id (word 1) */
+#define MM_QF_LAYOUT	0x0004		/* layout-rev (word 2) */
+#define MM_QF_VARIANT	0x0008		/* product-variant (word 8) */
+#define MM_QF_SERIAL	0x0010		/* serial number (words 9, 10) */
+#define MM_QF_TYPE		0x0020		/* 0, MODCOM_MOD_MEN, MODCOM_MOD_THIRD */
+#define MM_QF_NAME		0x0040		/* module name, e.g. "M72" */
+#define MM_QF_RAW		0x0080		/* all MM_EE_WORDS words */
+
+#define MM_QUERY_NAME_LEN	25		/* size of MM_QUERY_RES.devname */
+
+/** words read so far from one slot */
+typedef struct MM_QUERY {
+	uint16_t words[MM_EE_WORDS];	/**< EEPROM contents */
+	uint64_t valid;					/**< bit n: words[n] was read */
+	int      probe;					/**< MM_PROBE_xxx of the first read */
+} MM_QUERY;
+
+/** query result, only the requested fields are set */
+typedef struct MM_QUERY_RES {
+	uint32_t fields;			/**< MM_QF_xxx that are set */
+	uint16_t magic;
+	uint16_t modid;
+	uint16_t layout;
+	uint16_t variant;
+	uint32_t serial;			/**< (word 9 << 16) | word 10 */
+	uint32_t modtype;
+	char     devname[MM_QUERY_NAME_LEN];
+	const uint16_t *raw;		/**< MM_EE_WORDS words, points into memo */
+	int      probe;				/**< MM_PROBE_xxx, e.g. empty slot */
+} MM_QUERY_RES;
+
+void mm_query_init( MM_QUERY *q );
+int mm_query_parse( const char *str, uint32_t *fields );
+int mm_query( MM_QUERY *q, uintptr_t base, uint32_t fields, MM_QUERY_RES *res );
+
+#endif /* _MM_QUERY_H */
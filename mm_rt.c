@@ -0,0 +1,195 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_rt.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Real-time mode for the bit-bang transfers.
+ *
+ *               mm_rt_enter()/mm_rt_leave() bracket one word transfer
+ *               (the instruction counts to the first word). They do
+ *               nothing until mm_rt_init() was called. The priority is
+ *               only raised inside the bracket, so a long scan doesn't
+ *               keep a CPU from the rest of the system. A transfer is
+ *               counted as preempted if the thread had an involuntary
+ *               context switch inside the bracket, as overrun if it took
+ *               longer than twice its bit delays plus MM_RT_SLACK_NS.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <pthread.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "mm_eeprom.h"
+#include "mm_timing.h"
+#include "mm_rt.h"
+
+static int       G_rtOn;
+static int       G_rtPrio;
+static MM_RT_CNT G_rtCnt;
+
+static __thread uint64_t G_rtT0;		/* start of current transfer */
+static __thread long     G_rtCsw;		/* involuntary switches at start */
+
+/******************************* _rt_csw ***********************************/
+/**   Involuntary context switches of the calling thread.
+ ****************************************************************************/
+static long _rt_csw( void )
+{
+	struct rusage ru;
+
+	if( getrusage( RUSAGE_THREAD, &ru ) )
+		return 0;
+	return ru.ru_nivcsw;
+}
+
+/******************************* _rt_sched *********************************/
+/**   Set the scheduling of the calling thread.
+ *---------------------------------------------------------------------------
+ *  \param prio			\IN SCHED_FIFO priority, 0=SCHED_OTHER
+ *  \return 0=ok, else error number
+ ****************************************************************************/
+static int _rt_sched( int prio )
+{
+	struct sched_param sp;
+
+	memset( &sp, 0, sizeof(sp) );
+	sp.sched_priority = prio;
+	return pthread_setschedparam( pthread_self(),
+								  prio ? SCHED_FIFO : SCHED_OTHER, &sp );
+}
+
+/******************************* mm_rt_init ********************************/
+/**   Enable the real-time mode.
+ *
+ *    Locks all current and future memory, prefaults MM_RT_STACK of the
+ *    calling thread's stack and pins the process to cfg->cpu. Threads
+ *    started later inherit the CPU. Must be called before the worker
+ *    threads are started.
+ *---------------------------------------------------------------------------
+ *  \param cfg			\IN configuration
+ *  \return 0=ok, -1=error (errno set, e.g. EPERM)
+ ****************************************************************************/
+int mm_rt_init( const MM_RT_CFG *cfg )
+{
+	volatile char stack[MM_RT_STACK];
+	cpu_set_t set;
+	int err;
+
+	if( mlockall( MCL_CURRENT | MCL_FUTURE ) )
+		return -1;
+	memset( (char *)stack, 0, sizeof(stack) );
+
+	if( cfg->cpu >= 0 ){
+		CPU_ZERO( &set );
+		CPU_SET( cfg->cpu, &set );
+		if( sched_setaffinity( 0, sizeof(set), &set ) )
+			return -1;
+	}
+
+	/* check that we may raise the priority at all */
+	if( cfg->prio ){
+		if( (err = _rt_sched( cfg->prio )) ){
+			errno = err;
+			return -1;
+		}
+		_rt_sched( 0 );
+	}
+
+	G_rtPrio = cfg->prio;
+	G_rtOn   = 1;
+	return 0;
+}
+
+/******************************* mm_rt_prefault ****************************/
+/**   Touch the MODREG of slots, so their first transfer doesn't fault.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN addresses as passed to m_read() & co.
+ *  \param n			\IN number of slots
+ ****************************************************************************/
+void mm_rt_prefault( const uintptr_t *base, int n )
+{
+	const MM_BUS_OPS *bus = mm_bus_get();
+	int i;
+
+	for( i=0; i<n; i++ )
+		(void)bus->read16( base[i], MODREG );
+}
+
+/******************************* mm_rt_enter *******************************/
+/**   Start a word transfer.
+ ****************************************************************************/
+void mm_rt_enter( void )
+{
+	if( !G_rtOn )
+		return;
+	if( G_rtPrio )
+		_rt_sched( G_rtPrio );
+	G_rtCsw = _rt_csw();
+	G_rtT0  = mm_time_ns();
+}
+
+/******************************* mm_rt_leave *******************************/
+/**   End a word transfer.
+ *---------------------------------------------------------------------------
+ *  \param expectNs		\IN sum of the bit delays of the transfer
+ ****************************************************************************/
+void mm_rt_leave( uint64_t expectNs )
+{
+	uint64_t ns, max;
+	long csw;
+
+	if( !G_rtOn )
+		return;
+	ns  = mm_time_ns() - G_rtT0;
+	csw = _rt_csw();
+	if( G_rtPrio )
+		_rt_sched( 0 );
+
+	__atomic_add_fetch( &G_rtCnt.words, 1, __ATOMIC_RELAXED );
+	if( csw != G_rtCsw )
+		__atomic_add_fetch( &G_rtCnt.preempt, 1, __ATOMIC_RELAXED );
+	if( ns > 2 * expectNs + MM_RT_SLACK_NS )
+		__atomic_add_fetch( &G_rtCnt.overrun, 1, __ATOMIC_RELAXED );
+
+	max = __atomic_load_n( &G_rtCnt.maxNs, __ATOMIC_RELAXED );
+	while( ns > max &&
+		   !__atomic_compare_exchange_n( &G_rtCnt.maxNs, &max, ns, 0,
+										 __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+		;
+}
+
+/******************************* mm_rt_get_cnt *****************************/
+/**   Get the real-time counters.
+ *---------------------------------------------------------------------------
+ *  \param cnt			\OUT counters
+ ****************************************************************************/
+void mm_rt_get_cnt( MM_RT_CNT *cnt )
+{
+	cnt->words   = __atomic_load_n( &G_rtCnt.words, __ATOMIC_RELAXED );
+	cnt->preempt = __atomic_load_n( &G_rtCnt.preempt, __ATOMIC_RELAXED );
+	cnt->overrun = __atomic_load_n( &G_rtCnt.overrun, __ATOMIC_RELAXED );
+	cnt->maxNs   = __atomic_load_n( &G_rtCnt.maxNs, __ATOMIC_RELAXED );
+}
@@ -0,0 +1,64 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_rt.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Real-time mode for the bit-bang transfers.
+ *
+ *               Memory is locked, the process is pinned to one CPU and
+ *               each word transfer runs with SCHED_FIFO priority; between
+ *               words the threads drop back to normal scheduling.
+ *               Preemptions and overruns of the word transfers are
+ *               counted.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_RT_H
+#define _MM_RT_H
+
+#include <stdint.h>
+
+#define MM_RT_PRIO_DEFAULT	50		/* SCHED_FIFO priority of transfers */
+#define MM_RT_STACK			(64 * 1024)	/* stack prefaulted by mm_rt_init() */
+#define MM_RT_SLACK_NS		20000	/* transfer may exceed twice its bit
+									   delays by this before it overruns */
+
+/** real-time configuration */
+typedef struct MM_RT_CFG {
+	int cpu;					/**< CPU to run on, -1=any */
+	int prio;					/**< SCHED_FIFO priority, 0=don't raise */
+} MM_RT_CFG;
+
+/** real-time counters */
+typedef struct MM_RT_CNT {
+	uint64_t words;				/**< word transfers */
+	uint64_t preempt;			/**< transfers that were preempted */
+	uint64_t overrun;			/**< transfers that took too long */
+	uint64_t maxNs;				/**< longest transfer */
+} MM_RT_CNT;
+
+int mm_rt_init( const MM_RT_CFG *cfg );
+void mm_rt_prefault( const uintptr_t *base, int n );
+void mm_rt_enter( void );
+void mm_rt_leave( uint64_t expectNs );
+void mm_rt_get_cnt( MM_RT_CNT *cnt );
+
+#endif /* _MM_RT_H */
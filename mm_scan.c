@@ -0,0 +1,787 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_scan.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Identify a list of M-Module slots with one shared mapping
+ *               per carrier page.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "mm_eeprom.h"
+#include "mm_scan.h"
+#include "mm_lock.h"
+
+/******************************* mm_scan_init ******************************/
+/**   Initialize an empty scan list.
+ *---------------------------------------------------------------------------
+ *  \param scan			\OUT scan list
+ ****************************************************************************/
+void mm_scan_init( MM_SCAN *scan )
+{
+	memset( scan, 0, sizeof(*scan) );
+	scan->memFd = -1;
+}
+
+/******************************* mm_scan_exit ******************************/
+/**   Unmap all carrier pages and free the scan list.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ ****************************************************************************/
+void mm_scan_exit( MM_SCAN *scan )
+{
+	int i;
+
+	for( i=0; i<scan->nslots; i++ )
+		if( scan->slot[i].mapped )
+			mm_lock_detach( scan->slot[i].base );
+	for( i=0; i<scan->nmaps; i++ )
+		if( scan->map[i].vaddr )
+			munmap( scan->map[i].vaddr, scan->map[i].size );
+	if( scan->memFd >= 0 )
+		close( scan->memFd );
+
+	for( i=0; i<scan->ncarriers; i++ )
+		free( scan->carrier[i].res );
+
+	free( scan->slot );
+	free( scan->map );
+	free( scan->carrier );
+	mm_scan_init( scan );
+}
+
+/******************************* mm_scan_add *******************************/
+/**   Add a slot to the scan list.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param phys			\IN physical slot address (BAR + offset)
+ *  \return 0=ok, -1=out of memory
+ ****************************************************************************/
+int mm_scan_add( MM_SCAN *scan, uint64_t phys )
+{
+	MM_SCAN_SLOT *slot;
+
+	if( scan->nslots == scan->maxslots ){
+		int max = scan->maxslots ? 2 * scan->maxslots : 16;
+
+		if( !(slot = realloc( scan->slot, max * sizeof(*slot) )) )
+			return -1;
+		scan->slot     = slot;
+		scan->maxslots = max;
+	}
+
+	slot = &scan->slot[scan->nslots++];
+	memset( slot, 0, sizeof(*slot) );
+	slot->phys    = phys;
+	slot->timing  = *mm_timing_get();
+	slot->carrier = -1;
+	slot->map     = -1;
+	slot->err  = 1;
+	return 0;
+}
+
+/******************************* mm_scan_add_carrier ***********************/
+/**   Add all M-Module slots of an F204/F205 carrier.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param bar			\IN carrier BAR
+ *  \return 0=ok, -1=out of memory
+ ****************************************************************************/
+int mm_scan_add_carrier( MM_SCAN *scan, uint64_t bar )
+{
+	if( mm_scan_add( scan, bar + MM_F204_SLOT0 ) ||
+		mm_scan_add( scan, bar + MM_F204_SLOT1 ) )
+		return -1;
+	return 0;
+}
+
+/******************************* mm_scan_add_carrier_res *******************/
+/**   Add all slots of a carrier that is mapped through a resource file.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param type			\IN carrier name
+ *  \param pci			\IN PCI device name
+ *  \param res			\IN sysfs resource file of the BAR
+ *  \param bar			\IN physical BAR address
+ *  \param nslots		\IN number of slots
+ *  \param slotOff		\IN slot offsets in BAR
+ *  \return 0=ok, -1=out of memory
+ ****************************************************************************/
+int mm_scan_add_carrier_res( MM_SCAN *scan, const char *type, const char *pci,
+							 const char *res, uint64_t bar, int nslots,
+							 const uint32_t *slotOff )
+{
+	MM_SCAN_CARRIER *car;
+	int i;
+
+	if( !(car = realloc( scan->carrier,
+						 (scan->ncarriers + 1) * sizeof(*car) )) )
+		return -1;
+	scan->carrier = car;
+	car = &scan->carrier[scan->ncarriers];
+	memset( car, 0, sizeof(*car) );
+	car->type = type;
+	car->bar  = bar;
+	snprintf( car->pci, sizeof(car->pci), "%s", pci );
+	if( !(car->res = strdup( res )) )
+		return -1;
+	scan->ncarriers++;
+
+	for( i=0; i<nslots; i++ ){
+		if( mm_scan_add( scan, bar + slotOff[i] ) )
+			return -1;
+		scan->slot[scan->nslots-1].carrier = scan->ncarriers - 1;
+		scan->slot[scan->nslots-1].slotNo  = i;
+	}
+	return 0;
+}
+
+/******************************* _scan_page ********************************/
+/**   Get the mapping entry for a carrier page, create it if necessary.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param carrier		\IN discovered carrier or -1
+ *  \param pageaddr		\IN physical page address
+ *  \param size			\IN required size
+ *  \return mapping index or -1
+ ****************************************************************************/
+static int _scan_page( MM_SCAN *scan, int carrier, uint64_t pageaddr,
+					   uint32_t size )
+{
+	MM_SCAN_MAP *map;
+	int i;
+
+	for( i=0; i<scan->nmaps; i++ )
+		if( scan->map[i].carrier == carrier &&
+			scan->map[i].pageaddr == pageaddr && scan->map[i].size >= size )
+			return i;
+
+	if( scan->nmaps == scan->maxmaps ){
+		int max = scan->maxmaps ? 2 * scan->maxmaps : 8;
+
+		if( !(map = realloc( scan->map, max * sizeof(*map) )) )
+			return -1;
+		scan->map     = map;
+		scan->maxmaps = max;
+	}
+
+	map = &scan->map[scan->nmaps];
+	map->carrier  = carrier;
+	map->pageaddr = pageaddr;
+	map->size     = size;
+	map->vaddr    = NULL;
+	return scan->nmaps++;
+}
+
+/******************************* _scan_mmap ********************************/
+/**   Map a carrier page.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param map			\IN mapping entry
+ *  \return 0=ok, -1=error
+ ****************************************************************************/
+static int _scan_mmap( MM_SCAN *scan, MM_SCAN_MAP *map )
+{
+	MM_SCAN_CARRIER *car;
+	void *vmem;
+	int fd;
+
+	if( map->carrier >= 0 ){
+		/* sysfs resource file, offset is relative to the BAR */
+		car = &scan->carrier[map->carrier];
+		if( (fd = open( car->res, O_RDWR|O_SYNC )) < 0 )
+			return -1;
+		vmem = mmap( 0, map->size, PROT_READ|PROT_WRITE,
+					 MAP_SHARED, fd, (off_t)(map->pageaddr - car->bar) );
+		close( fd );
+	}
+	else {
+		if( scan->memFd < 0 &&
+			(scan->memFd = open( "/dev/mem", O_RDWR|O_SYNC )) < 0 )
+			return -1;
+		vmem = mmap( 0, map->size, PROT_READ|PROT_WRITE,
+					 MAP_SHARED, scan->memFd, (off_t)map->pageaddr );
+	}
+
+	if( vmem == MAP_FAILED )
+		return -1;
+	map->vaddr = vmem;
+	return 0;
+}
+
+/******************************* mm_scan_map *******************************/
+/**   Map the carrier pages of all slots.
+ *
+ *    Every page is mapped only once, /dev/mem is opened only once and
+ *    only if slots without a discovered carrier are in the list.
+ *    Slots that can't be mapped keep err set.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param direct		\IN don't map, use physical address as base
+ *							(simulation backend)
+ *  \return number of mapped slots
+ ****************************************************************************/
+int mm_scan_map( MM_SCAN *scan, int direct )
+{
+	uint64_t pagesize = getpagesize();
+	uint64_t pageaddr;
+	uint32_t size;
+	MM_SCAN_SLOT *slot;
+	MM_SCAN_MAP *map;
+	uint64_t t0 = mm_time_ns();
+	int i, n = 0;
+
+	for( i=0; i<scan->nslots; i++ ){
+		slot = &scan->slot[i];
+
+		/* mmap needs a page aligned address, MODREG may be in next page */
+		pageaddr = slot->phys & ~(pagesize-1);
+		size = (uint32_t)(((slot->phys - pageaddr) + MODREG + 4 +
+						   pagesize - 1) & ~(pagesize-1));
+
+		if( (slot->map = _scan_page( scan, slot->carrier,
+									 pageaddr, size )) < 0 )
+			continue;
+		map = &scan->map[slot->map];
+
+		if( direct ){
+			slot->base = (uintptr_t)slot->phys;
+		}
+		else {
+			if( !map->vaddr && _scan_mmap( scan, map ) )
+				continue;
+			slot->base = (uintptr_t)map->vaddr +
+				(uintptr_t)(slot->phys - pageaddr);
+		}
+		slot->mapped = 1;
+		slot->err    = 0;
+		mm_lock_attach( slot->base, slot->phys );
+		n++;
+	}
+	scan->mapNs += mm_time_ns() - t0;
+	return n;
+}
+
+/******************************* _scan_stats *******************************/
+/**   Let the calling thread count into the statistics of a slot.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param slot			\IN slot or NULL (stop counting)
+ *  \return start time of the phase if counting, else 0
+ ****************************************************************************/
+static uint64_t _scan_stats( MM_SCAN *scan, MM_SCAN_SLOT *slot )
+{
+	if( !scan->stats )
+		return 0;
+	mm_stats_set( slot ? &slot->stats : NULL );
+	return mm_time_ns();
+}
+
+/******************************* _scan_stats_share *************************/
+/**   Add the n-th part of group statistics to a slot.
+ *---------------------------------------------------------------------------
+ *  \param dst			\INOUT slot statistics
+ *  \param grp			\IN group statistics
+ *  \param n			\IN number of slots in group
+ ****************************************************************************/
+static void _scan_stats_share( MM_STATS *dst, const MM_STATS *grp, int n )
+{
+	MM_STATS part = *grp;
+
+	part.reads   /= n;
+	part.writes  /= n;
+	part.clocks  /= n;
+	part.words   /= n;
+	part.readNs  /= n;
+	part.polls   /= n;
+	mm_stats_add( dst, &part );
+}
+
+/******************************* _scan_ident *******************************/
+/**   Identify one slot with its own timing.
+ *
+ *    With MM_SCAN.verifyNs the identification reads at
+ *    MM_SCAN.verifyFastNs, the only reads that detect errors.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param slot			\IN slot
+ ****************************************************************************/
+static void _scan_ident( MM_SCAN *scan, MM_SCAN_SLOT *slot )
+{
+	const MM_TIMING *saved = mm_timing_get();
+	uint64_t t0 = _scan_stats( scan, slot );
+	MM_TIMING fast;
+
+	mm_timing_set( &slot->timing );
+	if( scan->verifyNs ){
+		fast = slot->timing;
+		if( scan->verifyFastNs )
+			fast.halfNs = scan->verifyFastNs;
+		mm_timing_set( &fast );
+		slot->err = mm_verify_modinfo( slot->base, scan->verifyNs,
+									   slot->words, &slot->probe,
+									   &slot->modtype, &slot->devid,
+									   &slot->devrev, slot->devname,
+									   &slot->verify );
+	}
+	else
+		slot->err = m_getmodinfo_probe( slot->base, slot->words,
+										&slot->probe, &slot->modtype,
+										&slot->devid, &slot->devrev,
+										slot->devname );
+	mm_timing_set( saved );
+
+	if( t0 ){
+		slot->stats.identNs += mm_time_ns() - t0;
+		_scan_stats( scan, NULL );
+	}
+}
+
+/******************************* mm_scan_cache_check ***********************/
+/**   Revalidate cached results with a single word read per slot.
+ *
+ *    For every slot with a cache entry word MM_CACHE_CHECK_WORD (mod-id)
+ *    is read with presence probe and compared. Slots cached as empty are
+ *    checked with m_probe() instead. Busy slots (locked by another
+ *    process) are not revalidated. On a match the cached result is taken and the
+ *    slot is not identified again, otherwise the slot gets a full read.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param cache		\IN cache
+ *  \return number of slots taken from the cache
+ ****************************************************************************/
+int mm_scan_cache_check( MM_SCAN *scan, MM_CACHE *cache )
+{
+	const MM_TIMING *saved = mm_timing_get();
+	MM_SCAN_SLOT *slot;
+	MM_CACHE_ENT *ent;
+	uint64_t t0;
+	uint16_t w;
+	int i, n = 0, probe, same;
+
+	for( i=0; i<scan->nslots; i++ ){
+		slot = &scan->slot[i];
+		if( !slot->mapped || slot->done ||
+			!(ent = mm_cache_find( cache, slot->phys )) )
+			continue;
+
+		t0 = _scan_stats( scan, slot );
+		mm_timing_set( &slot->timing );
+		if( ent->modtype == 0 &&
+			(ent->words[0] == 0xffff || ent->words[0] == 0) ){
+			probe = m_probe( slot->base );
+			same  = (probe == MM_PROBE_EMPTY && ent->words[0] == 0xffff) ||
+				(probe == MM_PROBE_STUCK0 && ent->words[0] == 0);
+		}
+		else {
+			m_read_range_probe( slot->base, MM_CACHE_CHECK_WORD, 1, &w,
+								&probe );
+			same = probe == MM_PROBE_PRESENT &&
+				w == ent->words[MM_CACHE_CHECK_WORD];
+		}
+		mm_timing_set( saved );
+		if( t0 ){
+			slot->stats.identNs += mm_time_ns() - t0;
+			_scan_stats( scan, NULL );
+		}
+		/* a busy slot tells nothing, the full read reports it */
+		if( !same || probe == MM_PROBE_BUSY )
+			continue;
+
+		slot->modtype = ent->modtype;
+		slot->devid   = ent->devid;
+		slot->devrev  = ent->devrev;
+		memcpy( slot->devname, ent->devname, sizeof(slot->devname) );
+		memcpy( slot->words, ent->words, sizeof(slot->words) );
+		slot->probe  = probe;
+		slot->err    = 0;
+		slot->done   = 1;
+		slot->cached = 1;
+		n++;
+	}
+	return n;
+}
+
+/******************************* mm_scan_cache_update **********************/
+/**   Store the results of all identified slots in the cache.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param cache		\IN cache
+ *  \return 0=ok, -1=out of memory
+ ****************************************************************************/
+int mm_scan_cache_update( MM_SCAN *scan, MM_CACHE *cache )
+{
+	MM_SCAN_SLOT *slot;
+	MM_CACHE_ENT ent;
+	int i;
+
+	for( i=0; i<scan->nslots; i++ ){
+		slot = &scan->slot[i];
+		if( !slot->mapped || slot->err || slot->cached )
+			continue;
+
+		memset( &ent, 0, sizeof(ent) );
+		ent.phys    = slot->phys;
+		ent.modtype = slot->modtype;
+		ent.devid   = slot->devid;
+		ent.devrev  = slot->devrev;
+		memcpy( ent.devname, slot->devname, sizeof(ent.devname) );
+		memcpy( ent.words, slot->words, sizeof(ent.words) );
+		if( mm_cache_put( cache, &ent ) )
+			return -1;
+	}
+	return 0;
+}
+
+/******************************* mm_scan_autotune **************************/
+/**   Find the fastest reliable bit period of every mapped slot.
+ *
+ *    Slots that can be tuned use the tuned timing from now on, the
+ *    others (e.g. empty slots) keep their timing.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ ****************************************************************************/
+void mm_scan_autotune( MM_SCAN *scan )
+{
+	MM_SCAN_SLOT *slot;
+	uint64_t t0;
+	int i;
+
+	for( i=0; i<scan->nslots; i++ ){
+		slot = &scan->slot[i];
+		if( !slot->mapped )
+			continue;
+		t0 = _scan_stats( scan, slot );
+		if( mm_autotune( slot->base, &slot->timing, &slot->tune ) == 0 ){
+			slot->timing.halfNs = slot->tune.halfNs;
+			slot->tuned = 1;
+		}
+		if( t0 ){
+			slot->stats.tuneNs += mm_time_ns() - t0;
+			_scan_stats( scan, NULL );
+		}
+	}
+}
+
+/******************************* mm_scan_query *****************************/
+/**   Get fields of all mapped slots, see mm_query().
+ *
+ *    Only the words needed for the fields are read, the results are
+ *    stored in MM_SCAN_SLOT.qres. Time is counted as identification.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param fields		\IN MM_QF_xxx flags
+ ****************************************************************************/
+void mm_scan_query( MM_SCAN *scan, uint32_t fields )
+{
+	const MM_TIMING *saved = mm_timing_get();
+	MM_SCAN_SLOT *slot;
+	uint64_t t0;
+	int i;
+
+	for( i=0; i<scan->nslots; i++ ){
+		slot = &scan->slot[i];
+		if( !slot->mapped )
+			continue;
+
+		t0 = _scan_stats( scan, slot );
+		mm_timing_set( &slot->timing );
+		slot->err = mm_query( &slot->query, slot->base, fields, &slot->qres );
+		mm_timing_set( saved );
+
+		if( t0 ){
+			slot->stats.identNs += mm_time_ns() - t0;
+			_scan_stats( scan, NULL );
+		}
+	}
+}
+
+/******************************* mm_scan_run *******************************/
+/**   Identify all mapped slots.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ ****************************************************************************/
+void mm_scan_run( MM_SCAN *scan )
+{
+	int i;
+
+	for( i=0; i<scan->nslots; i++ )
+		if( scan->slot[i].mapped && !scan->slot[i].done )
+			_scan_ident( scan, &scan->slot[i] );
+}
+
+/******************************* mm_scan_run_lockstep **********************/
+/**   Identify all mapped slots, the slots of a carrier in lockstep.
+ *
+ *    The slots sharing a carrier page are bit-banged together from the
+ *    calling thread (see m_read_lockstep()), carriers one after another.
+ *    Statistics of a group are split evenly between its slots, every
+ *    slot gets the identification time of the whole group.
+ *    With MM_SCAN.verifyNs the slots are identified one after another,
+ *    the re-reads are per slot.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ ****************************************************************************/
+void mm_scan_run_lockstep( MM_SCAN *scan )
+{
+	uintptr_t base[MM_LOCKSTEP_MAX];
+	int idx[MM_LOCKSTEP_MAX];
+	uintptr_t vbase[MM_LOCKSTEP_MAX];
+	int probe[MM_LOCKSTEP_MAX], vidx[MM_LOCKSTEP_MAX];
+	uint16_t head[MM_LOCKSTEP_MAX * 3], var[MM_LOCKSTEP_MAX];
+	uint16_t vw[MM_LOCKSTEP_MAX];
+	const MM_TIMING *saved = mm_timing_get();
+	MM_TIMING tm;
+	MM_STATS st;
+	MM_SCAN_SLOT *slot;
+	uint64_t t0 = 0;
+	int m, i, j, n, nv, err, busy;
+
+	if( scan->verifyNs ){
+		mm_scan_run( scan );
+		return;
+	}
+
+	for( m=0; m<scan->nmaps; m++ ){
+		for( i=0; i<scan->nslots; ){
+			/*
+			 * collect the next group of slots of this carrier page with
+			 * the same access profile, the group runs at the speed of
+			 * its slowest slot
+			 */
+			memset( &tm, 0, sizeof(tm) );
+			for( n=0; i<scan->nslots && n<MM_LOCKSTEP_MAX; i++ ){
+				slot = &scan->slot[i];
+				if( slot->mapped && !slot->done && slot->map == m ){
+					if( n && slot->timing.access != tm.access )
+						break;			/* next group */
+					tm.access = slot->timing.access;
+					idx[n]    = i;
+					base[n++] = slot->base;
+					if( slot->timing.halfNs > tm.halfNs )
+						tm.halfNs = slot->timing.halfNs;
+					tm.flush |= slot->timing.flush;
+				}
+			}
+			if( n == 0 )
+				continue;
+
+			if( scan->stats ){
+				memset( &st, 0, sizeof(st) );
+				mm_stats_set( &st );
+				t0 = mm_time_ns();
+			}
+			mm_timing_set( &tm );
+
+			/* both reads of the group in one lock */
+			busy = mm_lock_take_n( base, n );
+			err  = busy || m_read_lockstep_probe( base, n, 0, 3, head, probe );
+
+			/* product variant only from slots that answered */
+			for( j=0, nv=0; !err && j<n; j++ ){
+				var[j] = head[j*3];
+				if( probe[j] == MM_PROBE_PRESENT ){
+					vidx[nv]    = j;
+					vbase[nv++] = base[j];
+				}
+			}
+			if( !err && nv ){
+				err = m_read_lockstep( vbase, nv, 8, 1, vw );
+				for( j=0; !err && j<nv; j++ )
+					var[vidx[j]] = vw[j];
+			}
+			if( !busy )
+				mm_lock_give_n( base, n );
+			mm_timing_set( saved );
+			if( scan->stats ){
+				st.identNs = mm_time_ns() - t0;
+				mm_stats_set( NULL );
+			}
+
+			for( j=0; j<n; j++ ){
+				slot = &scan->slot[idx[j]];
+				if( scan->stats )
+					_scan_stats_share( &slot->stats, &st, n );
+				if( err ){
+					slot->err = 1;
+					if( busy )
+						slot->probe = MM_PROBE_BUSY;
+					continue;
+				}
+				slot->words[0] = head[j*3];
+				slot->words[1] = head[j*3+1];
+				slot->words[2] = head[j*3+2];
+				slot->words[3] = var[j];
+				slot->probe    = probe[j];
+				slot->err = m_decode_modinfo( slot->words, &slot->modtype,
+							&slot->devid, &slot->devrev, slot->devname );
+			}
+		}
+	}
+}
+
+/** shared state of the parallel scan workers */
+typedef struct {
+	MM_SCAN         *scan;
+	pthread_mutex_t  lock;
+	pthread_cond_t   cond;
+	int             *active;		/* running workers per carrier page */
+	char            *state;			/* per slot: 0=pending 1=running 2=done */
+	int              perCarrier;	/* max. workers per carrier page */
+	int              next;			/* first slot that may be pending */
+} SCAN_POOL;
+
+/******************************* _scan_pick ********************************/
+/**   Get the next slot a worker may identify (pool locked).
+ *
+ *    Slots are taken in list order, but a slot is skipped while its
+ *    carrier page already has perCarrier workers.
+ *---------------------------------------------------------------------------
+ *  \param pool			\IN worker pool
+ *  \param pending		\OUT slots left to do
+ *  \return slot index or -1
+ ****************************************************************************/
+static int _scan_pick( SCAN_POOL *pool, int *pending )
+{
+	MM_SCAN *scan = pool->scan;
+	int i;
+
+	*pending = 0;
+	while( pool->next < scan->nslots && pool->state[pool->next] )
+		pool->next++;
+
+	for( i=pool->next; i<scan->nslots; i++ ){
+		if( pool->state[i] )
+			continue;
+		(*pending)++;
+		if( pool->active[scan->slot[i].map] < pool->perCarrier )
+			return i;
+	}
+	return -1;
+}
+
+/******************************* _scan_worker ******************************/
+/**   Worker thread: identify slots until none is left.
+ ****************************************************************************/
+static void *_scan_worker( void *arg )
+{
+	SCAN_POOL *pool = arg;
+	MM_SCAN_SLOT *slot;
+	int i, pending;
+
+	pthread_mutex_lock( &pool->lock );
+	for(;;){
+		if( (i = _scan_pick( pool, &pending )) < 0 ){
+			if( !pending )
+				break;
+			pthread_cond_wait( &pool->cond, &pool->lock );
+			continue;
+		}
+
+		slot = &pool->scan->slot[i];
+		pool->state[i] = 1;
+		pool->active[slot->map]++;
+		pthread_mutex_unlock( &pool->lock );
+
+		_scan_ident( pool->scan, slot );
+
+		pthread_mutex_lock( &pool->lock );
+		pool->state[i] = 2;
+		pool->active[slot->map]--;
+		pthread_cond_broadcast( &pool->cond );
+	}
+	pthread_mutex_unlock( &pool->lock );
+	return NULL;
+}
+
+/******************************* mm_scan_run_parallel **********************/
+/**   Identify all mapped slots with a pool of worker threads.
+ *
+ *    Every slot has its own MODREG interface, so slots are independent.
+ *    perCarrier limits the number of slots of one carrier page that are
+ *    bit-banged at the same time.
+ *    Falls back to mm_scan_run() if threads can't be used.
+ *---------------------------------------------------------------------------
+ *  \param scan			\IN scan list
+ *  \param workers		\IN number of worker threads
+ *  \param perCarrier	\IN max. concurrent workers per carrier (>=1)
+ ****************************************************************************/
+void mm_scan_run_parallel( MM_SCAN *scan, int workers, int perCarrier )
+{
+	SCAN_POOL pool;
+	pthread_t *tid;
+	int i, started = 0;
+
+	if( workers > scan->nslots )
+		workers = scan->nslots;
+	if( workers <= 1 ){
+		mm_scan_run( scan );
+		return;
+	}
+
+	memset( &pool, 0, sizeof(pool) );
+	pool.scan       = scan;
+	pool.perCarrier = perCarrier < 1 ? 1 : perCarrier;
+	pool.active     = calloc( scan->nmaps + 1, sizeof(*pool.active) );
+	pool.state      = calloc( scan->nslots, sizeof(*pool.state) );
+	tid             = calloc( workers, sizeof(*tid) );
+	if( !pool.active || !pool.state || !tid )
+		goto FALLBACK;
+
+	/* unmapped and cached slots are done already */
+	for( i=0; i<scan->nslots; i++ )
+		if( !scan->slot[i].mapped || scan->slot[i].done )
+			pool.state[i] = 2;
+
+	pthread_mutex_init( &pool.lock, NULL );
+	pthread_cond_init( &pool.cond, NULL );
+
+	for( i=0; i<workers; i++ )
+		if( pthread_create( &tid[started], NULL, _scan_worker, &pool ) == 0 )
+			started++;
+
+	if( started == 0 )
+		_scan_worker( &pool );
+	for( i=0; i<started; i++ )
+		pthread_join( tid[i], NULL );
+
+	pthread_cond_destroy( &pool.cond );
+	pthread_mutex_destroy( &pool.lock );
+	free( pool.active );
+	free( pool.state );
+	free( tid );
+	return;
+
+FALLBACK:
+	free( pool.active );
+	free( pool.state );
+	free( tid );
+	mm_scan_run( scan );
+}
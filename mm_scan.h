@@ -0,0 +1,131 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_scan.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Identification of many M-Module slots in one run.
+ *
+ *               Slots are collected first, then every carrier page is
+ *               mapped once and shared by all slots located in it.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_SCAN_H
+#define _MM_SCAN_H
+
+#include <stdint.h>
+#include "mm_timing.h"
+#include "mm_cache.h"
+#include "mm_stats.h"
+#include "mm_query.h"
+#include "mm_verify.h"
+
+/* M-Module slots of the F204/F205 carrier (A08 space offsets in BAR) */
+#define MM_F204_SLOT0	0x200
+#define MM_F204_SLOT1	0x600
+
+#define MM_DEVNAME_LEN	25		/* size of the m_getmodinfo() name buffer */
+
+/** one M-Module slot */
+typedef struct MM_SCAN_SLOT {
+	uint64_t phys;				/**< physical slot address (BAR+offset) */
+	uintptr_t base;				/**< address passed to m_read() & co. */
+	int      carrier;			/**< index of discovered carrier or -1 */
+	int      slotNo;			/**< slot number on carrier */
+	int      map;				/**< index of mapping (carrier page) */
+	int      mapped;			/**< base is valid */
+	int      err;				/**< 0=ok, 1=not mapped/read error */
+	MM_TIMING timing;			/**< bit timing used for this slot */
+	int      tuned;				/**< auto-tuning succeeded */
+	MM_TUNE  tune;				/**< auto-tuning result */
+	uint32_t modtype;			/**< m_getmodinfo() results */
+	uint32_t devid;
+	uint32_t devrev;
+	char     devname[MM_DEVNAME_LEN];
+	uint16_t words[4];			/**< raw words 0, 1, 2, 8 */
+	int      probe;				/**< MM_PROBE_xxx of the EEPROM */
+	int      done;				/**< result known, skip identification */
+	int      cached;			/**< result taken from the cache */
+	MM_QUERY query;				/**< words read by mm_scan_query() */
+	MM_QUERY_RES qres;			/**< mm_scan_query() result */
+	MM_VERIFY_CNT verify;		/**< error-detecting read counters */
+	int      programmed;		/**< mm_batch_run() results valid */
+	int      progErr;			/**< MM_PROG_xxx */
+	MM_PROG_REPORT progRep;		/**< programming report */
+	uint32_t serial;			/**< serial number programmed */
+	MM_STATS stats;				/**< counters (if MM_SCAN.stats) */
+} MM_SCAN_SLOT;
+
+/** discovered carrier, slots are mapped through a sysfs resource file */
+typedef struct MM_SCAN_CARRIER {
+	const char *type;			/**< carrier name */
+	char        pci[32];		/**< PCI device name */
+	char       *res;			/**< resource file of BAR */
+	uint64_t    bar;			/**< physical BAR address */
+} MM_SCAN_CARRIER;
+
+/** one mapped carrier page */
+typedef struct MM_SCAN_MAP {
+	int       carrier;			/**< discovered carrier or -1 (/dev/mem) */
+	uint64_t  pageaddr;			/**< physical page address */
+	uint32_t  size;				/**< mapped size */
+	void     *vaddr;			/**< mapping or NULL */
+} MM_SCAN_MAP;
+
+/** scan list */
+typedef struct MM_SCAN {
+	MM_SCAN_SLOT *slot;
+	int           nslots;
+	int           maxslots;
+	MM_SCAN_MAP  *map;
+	int           nmaps;
+	int           maxmaps;
+	MM_SCAN_CARRIER *carrier;
+	int           ncarriers;
+	int           memFd;
+	int           stats;		/**< collect MM_SCAN_SLOT.stats */
+	uint32_t      verifyNs;		/**< identify with error-detecting reads,
+									 safe half bit period of re-reads
+									 (0=off), see mm_verify.h */
+	uint32_t      verifyFastNs;	/**< half bit period of the first read of
+									 the verified identification (0=slot
+									 timing), only there errors are
+									 detected */
+	uint64_t      mapNs;		/**< phase: mapping */
+} MM_SCAN;
+
+void mm_scan_init( MM_SCAN *scan );
+void mm_scan_exit( MM_SCAN *scan );
+int mm_scan_add( MM_SCAN *scan, uint64_t phys );
+int mm_scan_add_carrier( MM_SCAN *scan, uint64_t bar );
+int mm_scan_add_carrier_res( MM_SCAN *scan, const char *type, const char *pci,
+							 const char *res, uint64_t bar, int nslots,
+							 const uint32_t *slotOff );
+int mm_scan_map( MM_SCAN *scan, int direct );
+void mm_scan_autotune( MM_SCAN *scan );
+int mm_scan_cache_check( MM_SCAN *scan, MM_CACHE *cache );
+int mm_scan_cache_update( MM_SCAN *scan, MM_CACHE *cache );
+void mm_scan_query( MM_SCAN *scan, uint32_t fields );
+void mm_scan_run( MM_SCAN *scan );
+void mm_scan_run_lockstep( MM_SCAN *scan );
+void mm_scan_run_parallel( MM_SCAN *scan, int workers, int perCarrier );
+
+#endif /* _MM_SCAN_H */
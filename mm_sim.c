@@ -0,0 +1,551 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_sim.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Software model of the 93C46 serial EEPROM (x16 organisation)
+ *               as seen through the M-Module MODREG register.
+ *
+ *               The model tracks the levels written to CS/CLK/DI and acts
+ *               on the rising CLK edge exactly like the device:
+ *               - leading zeros are ignored until the start bit
+ *               - 8 bit instruction (2 bit opcode, 6 bit address)
+ *               - READ drives a dummy zero, then D15..D0 and continues
+ *                 with the next word as long as CS stays high
+ *               - ERASE/WRITE/ERAL/WRAL start the self timed cycle on the
+ *                 falling CS edge; while CS is high again, DO shows
+ *                 the ready/busy status
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mm_sim.h"
+
+#define SIM_HIZ		1		/* level read from a floating DO (pull-up) */
+
+/* device state */
+#define ST_IDLE		0		/* deselected */
+#define ST_START	1		/* waiting for start bit */
+#define ST_CMD		2		/* shifting in instruction */
+#define ST_READ		3		/* shifting out data */
+#define ST_DATA		4		/* shifting in WRITE/WRAL data */
+#define ST_DONE		5		/* instruction complete, wait for CS low */
+
+/* pending self timed operation */
+#define OP_NONE		0
+#define OP_ERASE	1
+#define OP_WRITE	2
+#define OP_ERAL		3
+#define OP_WRAL		4
+
+struct MM_SIM_DEV {
+	uintptr_t	base;		/* attached slot address (0=detached) */
+	int			attached;
+	uint16_t	mem[MM_EE_WORDS];
+	uint16_t	reg;		/* last value written to MODREG */
+	int			state;
+	int			nbits;		/* bits shifted in current state */
+	uint8_t		cmd;		/* instruction shift register */
+	uint8_t		addr;		/* current word address */
+	uint16_t	sr;			/* data shift register */
+	int			doLvl;		/* driven DO level, -1=Hi-Z */
+	int			prevDo;		/* DO level before last clock edge */
+	uint64_t	riseNs;		/* time of last rising clock edge */
+	uint32_t	tpdNs;		/* clock to DO delay (0=immediate) */
+	int			we;			/* erase/write enabled */
+	int			op;			/* pending self timed operation */
+	int			status;		/* DO shows ready/busy */
+	int			busy;		/* self timed cycle running */
+	uint64_t	busyUntil;	/* end of cycle (ns) */
+	uint32_t	busyUs;		/* cycle time (us) */
+	uint32_t	busyClocks;	/* clocks seen during cycle */
+	MM_SIM_FAULT fault;
+	MM_SIM_CNT	cnt;
+};
+
+static MM_SIM_DEV *G_simDev[MM_SIM_MAX];
+
+/******************************* _sim_now **********************************/
+/**   Monotonic time in ns.
+ *---------------------------------------------------------------------------
+ *  \return current time
+ ****************************************************************************/
+static uint64_t _sim_now( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/******************************* _sim_find *********************************/
+/**   Find the device attached at a slot address.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN slot address
+ *  \return device or NULL (empty slot)
+ ****************************************************************************/
+static MM_SIM_DEV *_sim_find( uintptr_t base )
+{
+	int i;
+
+	for( i=0; i<MM_SIM_MAX; i++ )
+		if( G_simDev[i] && G_simDev[i]->base == base )
+			return G_simDev[i];
+	return NULL;
+}
+
+/******************************* _sim_word *********************************/
+/**   Fetch an array word for shifting out, apply injected bit flips.
+ *---------------------------------------------------------------------------
+ *  \param d			\IN device
+ *  \param index		\IN word address
+ *  \return word
+ ****************************************************************************/
+static uint16_t _sim_word( MM_SIM_DEV *d, uint8_t index )
+{
+	uint16_t w = d->mem[index];
+
+	if( d->fault.flipWord == index && d->fault.flipCount != 0 ){
+		w ^= d->fault.flipMask;
+		if( d->fault.flipCount > 0 )
+			d->fault.flipCount--;
+	}
+	return w;
+}
+
+/******************************* _sim_busy *********************************/
+/**   Update the state of a running erase/write cycle.
+ *
+ *    The cycle lasts at least busyUs and until the second status clock,
+ *    so a poller always samples the busy level after its first clock.
+ *---------------------------------------------------------------------------
+ *  \param d			\IN device
+ ****************************************************************************/
+static void _sim_busy( MM_SIM_DEV *d )
+{
+	if( d->busy && !d->fault.busyStuck &&
+		d->busyClocks > 1 && _sim_now() >= d->busyUntil )
+		d->busy = 0;
+}
+
+/******************************* _sim_decode *******************************/
+/**   Execute a completely shifted in instruction.
+ *---------------------------------------------------------------------------
+ *  \param d			\IN device
+ ****************************************************************************/
+static void _sim_decode( MM_SIM_DEV *d )
+{
+	uint8_t index = d->cmd & MM_EE_ADDR_MASK;
+
+	d->cnt.cmds++;
+	d->state = ST_DONE;
+
+	switch( d->cmd & 0xc0 ){
+	case _READ_:
+		d->addr  = index;
+		d->sr    = _sim_word( d, index );
+		d->nbits = 0;
+		d->doLvl = d->fault.noDummy ? -1 : 0;	/* dummy zero */
+		d->state = ST_READ;
+		break;
+	case _WRITE_:
+		d->addr  = index;
+		d->nbits = 0;
+		d->state = ST_DATA;
+		d->op    = OP_WRITE;
+		break;
+	case ERASE:
+		d->addr = index;
+		d->op   = OP_ERASE;
+		break;
+	default:
+		switch( d->cmd & 0x30 ){
+		case EWEN:	d->we = 1;				break;
+		case EWDS:	d->we = 0;				break;
+		case ERAL:	d->op = OP_ERAL;		break;
+		case WRAL:
+			d->nbits = 0;
+			d->state = ST_DATA;
+			d->op    = OP_WRAL;
+			break;
+		}
+	}
+}
+
+/******************************* _sim_rise *********************************/
+/**   Rising CLK edge while selected.
+ *---------------------------------------------------------------------------
+ *  \param d			\IN device
+ *  \param di			\IN level of DI
+ ****************************************************************************/
+static void _sim_rise( MM_SIM_DEV *d, int di )
+{
+	d->cnt.clocks++;
+
+	if( d->tpdNs ){					/* DO switches tpd after the edge */
+		d->prevDo = d->doLvl;
+		d->riseNs = _sim_now();
+	}
+
+	if( d->busy ){
+		d->busyClocks++;			/* status polling only */
+		return;
+	}
+
+	switch( d->state ){
+	case ST_START:
+		if( di ){
+			d->status = 0;
+			d->state  = ST_CMD;
+			d->nbits  = 0;
+			d->cmd    = 0;
+		}
+		break;
+	case ST_CMD:
+		d->cmd = (uint8_t)((d->cmd << 1) | di);
+		if( ++d->nbits == 8 )
+			_sim_decode( d );
+		break;
+	case ST_READ:
+		d->doLvl = (d->sr >> 15) & 1;
+		d->sr <<= 1;
+		if( ++d->nbits == 16 ){		/* sequential read */
+			d->addr  = (uint8_t)((d->addr + 1) & MM_EE_ADDR_MASK);
+			d->sr    = _sim_word( d, d->addr );
+			d->nbits = 0;
+		}
+		break;
+	case ST_DATA:
+		d->sr = (uint16_t)((d->sr << 1) | di);
+		if( ++d->nbits == 16 )
+			d->state = ST_DONE;
+		break;
+	default:
+		break;
+	}
+}
+
+/******************************* _sim_program ******************************/
+/**   Falling CS edge: start a pending self timed operation.
+ *---------------------------------------------------------------------------
+ *  \param d			\IN device
+ ****************************************************************************/
+static void _sim_program( MM_SIM_DEV *d )
+{
+	int i, op = d->op;
+
+	d->op = OP_NONE;
+	/* instruction incomplete or write protected */
+	if( op == OP_NONE || d->state != ST_DONE || !d->we || d->busy )
+		return;
+
+	if( !d->fault.ignoreWrite ){
+		switch( op ){
+		case OP_ERASE:	d->mem[d->addr] = 0xffff;		break;
+		case OP_WRITE:	d->mem[d->addr] = d->sr;		break;
+		case OP_ERAL:
+			for( i=0; i<MM_EE_WORDS; i++ ) d->mem[i] = 0xffff;
+			break;
+		case OP_WRAL:
+			for( i=0; i<MM_EE_WORDS; i++ ) d->mem[i] = d->sr;
+			break;
+		}
+	}
+	d->cnt.programs++;
+	d->busy       = 1;
+	d->busyClocks = 0;
+	d->busyUntil  = _sim_now() + (uint64_t)d->busyUs * 1000;
+}
+
+/******************************* _sim_write16 ******************************/
+/**   MM_BUS_OPS write: decode the new CS/CLK/DI levels.
+ ****************************************************************************/
+static void _sim_write16( uintptr_t base, uint32_t offset, uint16_t val )
+{
+	MM_SIM_DEV *d = _sim_find( base );
+	uint16_t old;
+
+	if( !d || offset != MODREG )
+		return;
+
+	d->cnt.writes++;
+	old    = d->reg;
+	d->reg = val;
+
+	if( (old & B_SEL) && !(val & B_SEL) ){			/* CS falling */
+		_sim_program( d );
+		d->state  = ST_IDLE;
+		d->status = 0;
+		d->doLvl  = -1;
+	}
+	else if( !(old & B_SEL) && (val & B_SEL) ){		/* CS rising */
+		if( val & B_CLK )
+			d->cnt.errors++;		/* CLK must be low while selecting */
+		d->state  = ST_START;
+		d->status = d->busy;
+		d->doLvl  = -1;
+	}
+	else if( (val & B_SEL) && !(old & B_CLK) && (val & B_CLK) ){
+		_sim_rise( d, val & B_DAT );
+	}
+	else if( !(val & B_SEL) && !(old & B_CLK) && (val & B_CLK) ){
+		d->cnt.errors++;			/* clocking a deselected device */
+	}
+}
+
+/******************************* _sim_read16 *******************************/
+/**   MM_BUS_OPS read: current DO level in B_DAT.
+ ****************************************************************************/
+static uint16_t _sim_read16( uintptr_t base, uint32_t offset )
+{
+	MM_SIM_DEV *d = _sim_find( base );
+	int lvl;
+
+	if( !d )
+		return 0xffff;				/* empty slot */
+	if( offset != MODREG )
+		return 0xffff;
+
+	d->cnt.reads++;
+	_sim_busy( d );
+
+	if( d->fault.stuckDo >= 0 )
+		lvl = d->fault.stuckDo;
+	else if( !(d->reg & B_SEL) )
+		lvl = SIM_HIZ;
+	else if( d->status )
+		lvl = !d->busy;
+	else if( d->tpdNs && _sim_now() - d->riseNs < d->tpdNs )
+		lvl = d->prevDo < 0 ? SIM_HIZ : d->prevDo;	/* sampled too early */
+	else
+		lvl = d->doLvl < 0 ? SIM_HIZ : d->doLvl;
+
+	return (uint16_t)((d->reg & (B_CLK|B_SEL)) | (lvl ? B_DAT : 0));
+}
+
+const MM_BUS_OPS MM_BusSim = {
+	"sim",
+	_sim_write16,
+	_sim_read16
+};
+
+/******************************* mm_sim_fault_init *************************/
+/**   Initialize a fault descriptor to "no faults".
+ *---------------------------------------------------------------------------
+ *  \param fault		\OUT fault descriptor
+ ****************************************************************************/
+void mm_sim_fault_init( MM_SIM_FAULT *fault )
+{
+	memset( fault, 0, sizeof(*fault) );
+	fault->stuckDo  = -1;
+	fault->flipWord = -1;
+}
+
+/******************************* mm_sim_create *****************************/
+/**   Create a simulated EEPROM.
+ *---------------------------------------------------------------------------
+ *  \param image		\IN initial contents (NULL=erased)
+ *  \param nwords		\IN number of words in image (max. MM_EE_WORDS),
+ *							remaining words are erased (0xffff)
+ *  \return device or NULL
+ ****************************************************************************/
+MM_SIM_DEV *mm_sim_create( const uint16_t *image, int nwords )
+{
+	MM_SIM_DEV *d;
+	int i;
+
+	if( !(d = calloc( 1, sizeof(*d) )) )
+		return NULL;
+
+	for( i=0; i<MM_EE_WORDS; i++ )
+		d->mem[i] = (image && i < nwords) ? image[i] : 0xffff;
+
+	d->doLvl  = -1;
+	d->busyUs = MM_SIM_BUSY_US;
+	mm_sim_fault_init( &d->fault );
+	return d;
+}
+
+/******************************* mm_sim_destroy ****************************/
+/**   Detach and free a simulated EEPROM.
+ *---------------------------------------------------------------------------
+ *  \param dev			\IN device
+ ****************************************************************************/
+void mm_sim_destroy( MM_SIM_DEV *dev )
+{
+	if( !dev )
+		return;
+	mm_sim_detach( dev );
+	free( dev );
+}
+
+/******************************* mm_sim_attach *****************************/
+/**   Attach a device at a slot address.
+ *---------------------------------------------------------------------------
+ *  \param dev			\IN device
+ *  \param base			\IN slot address used with m_read() & co.
+ *  \return 0=ok, -1=address in use or too many devices
+ ****************************************************************************/
+int mm_sim_attach( MM_SIM_DEV *dev, uintptr_t base )
+{
+	int i, slot = -1;
+
+	if( _sim_find( base ) )
+		return -1;
+
+	for( i=0; i<MM_SIM_MAX; i++ )
+		if( !G_simDev[i] ){
+			slot = i;
+			break;
+		}
+	if( slot < 0 )
+		return -1;
+
+	mm_sim_detach( dev );
+	dev->base     = base;
+	dev->attached = 1;
+	G_simDev[slot] = dev;
+	return 0;
+}
+
+/******************************* mm_sim_detach *****************************/
+/**   Remove a device from its slot.
+ *---------------------------------------------------------------------------
+ *  \param dev			\IN device
+ ****************************************************************************/
+void mm_sim_detach( MM_SIM_DEV *dev )
+{
+	int i;
+
+	for( i=0; i<MM_SIM_MAX; i++ )
+		if( G_simDev[i] == dev )
+			G_simDev[i] = NULL;
+	dev->attached = 0;
+}
+
+/******************************* mm_sim_set_busy ***************************/
+/**   Set the duration of the self timed erase/write cycle.
+ *---------------------------------------------------------------------------
+ *  \param dev			\IN device
+ *  \param busyUs		\IN cycle time (us)
+ ****************************************************************************/
+void mm_sim_set_busy( MM_SIM_DEV *dev, uint32_t busyUs )
+{
+	dev->busyUs = busyUs;
+}
+
+/******************************* mm_sim_set_tpd ****************************/
+/**   Set the clock to data out delay.
+ *
+ *    DO is sampled correctly only if the read happens at least tpdNs
+ *    after the rising clock edge, earlier reads return the old level.
+ *---------------------------------------------------------------------------
+ *  \param dev			\IN device
+ *  \param tpdNs		\IN delay (ns), 0=immediate
+ ****************************************************************************/
+void mm_sim_set_tpd( MM_SIM_DEV *dev, uint32_t tpdNs )
+{
+	dev->tpdNs = tpdNs;
+}
+
+/******************************* mm_sim_set_fault **************************/
+/**   Inject faults.
+ *---------------------------------------------------------------------------
+ *  \param dev			\IN device
+ *  \param fault		\IN faults to inject
+ ****************************************************************************/
+void mm_sim_set_fault( MM_SIM_DEV *dev, const MM_SIM_FAULT *fault )
+{
+	dev->fault = *fault;
+}
+
+/******************************* mm_sim_parse_fault ************************/
+/**   Parse a comma separated fault list.
+ *
+ *    Known faults: stuck0, stuck1, nodummy, busystuck, nowrite,
+ *    flip=<word>:<mask>[:<count>]
+ *---------------------------------------------------------------------------
+ *  \param spec			\IN fault list
+ *  \param fault		\INOUT fault descriptor
+ *  \return 0=ok, -1=syntax error
+ ****************************************************************************/
+int mm_sim_parse_fault( const char *spec, MM_SIM_FAULT *fault )
+{
+	char buf[128], *tok, *save = NULL;
+	unsigned int word, mask;
+	int count;
+
+	if( strlen( spec ) >= sizeof(buf) )
+		return -1;
+	strcpy( buf, spec );
+
+	for( tok = strtok_r( buf, ",", &save ); tok;
+		 tok = strtok_r( NULL, ",", &save ) ){
+		if( !strcmp( tok, "stuck0" ) )
+			fault->stuckDo = 0;
+		else if( !strcmp( tok, "stuck1" ) )
+			fault->stuckDo = 1;
+		else if( !strcmp( tok, "nodummy" ) )
+			fault->noDummy = 1;
+		else if( !strcmp( tok, "busystuck" ) )
+			fault->busyStuck = 1;
+		else if( !strcmp( tok, "nowrite" ) )
+			fault->ignoreWrite = 1;
+		else if( !strncmp( tok, "flip=", 5 ) ){
+			count = -1;
+			if( sscanf( tok + 5, "%u:%x:%d", &word, &mask, &count ) < 2 ||
+				word >= MM_EE_WORDS )
+				return -1;
+			fault->flipWord  = (int)word;
+			fault->flipMask  = (uint16_t)mask;
+			fault->flipCount = count;
+		}
+		else
+			return -1;
+	}
+	return 0;
+}
+
+/******************************* mm_sim_get_image **************************/
+/**   Get the current array contents.
+ *---------------------------------------------------------------------------
+ *  \param dev			\IN device
+ *  \param image		\OUT MM_EE_WORDS words
+ ****************************************************************************/
+void mm_sim_get_image( const MM_SIM_DEV *dev, uint16_t *image )
+{
+	memcpy( image, dev->mem, sizeof(dev->mem) );
+}
+
+/******************************* mm_sim_get_cnt ****************************/
+/**   Get the bus activity counters.
+ *---------------------------------------------------------------------------
+ *  \param dev			\IN device
+ *  \param cnt			\OUT counters
+ ****************************************************************************/
+void mm_sim_get_cnt( const MM_SIM_DEV *dev, MM_SIM_CNT *cnt )
+{
+	*cnt = dev->cnt;
+}
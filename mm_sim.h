@@ -0,0 +1,79 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_sim.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Software model of the 93C46 Microwire EEPROM behind the
+ *               M-Module MODREG interface.
+ *
+ *               The model decodes CS/CLK/DI as written to MODREG, drives
+ *               DO (including the dummy zero, sequential read and the
+ *               ready/busy status) and models the self timed erase/write
+ *               cycle. Devices are attached at a slot address and are
+ *               accessed through the MM_BusSim backend.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_SIM_H
+#define _MM_SIM_H
+
+#include <stdint.h>
+#include "mm_eeprom.h"
+
+#define MM_SIM_MAX		64		/* max. number of attached devices */
+#define MM_SIM_BUSY_US	2000	/* default erase/write cycle time (us) */
+
+/** injectable faults */
+typedef struct MM_SIM_FAULT {
+	int      stuckDo;		/**< -1=off, 0/1=DO stuck at this level */
+	int      noDummy;		/**< don't drive the dummy zero on READ */
+	int      flipWord;		/**< word corrupted on read (-1=off) */
+	uint16_t flipMask;		/**< bits inverted in flipWord */
+	int      flipCount;		/**< number of corrupted reads (-1=always) */
+	int      busyStuck;		/**< erase/write cycles never complete */
+	int      ignoreWrite;	/**< erase/write cycles don't alter the array */
+} MM_SIM_FAULT;
+
+/** bus activity seen by a device */
+typedef struct MM_SIM_CNT {
+	uint64_t writes;		/**< MODREG writes */
+	uint64_t reads;			/**< MODREG reads */
+	uint64_t clocks;		/**< rising CLK edges while selected */
+	uint64_t cmds;			/**< decoded instructions */
+	uint64_t programs;		/**< started erase/write cycles */
+	uint64_t errors;		/**< protocol violations */
+} MM_SIM_CNT;
+
+typedef struct MM_SIM_DEV MM_SIM_DEV;
+
+MM_SIM_DEV *mm_sim_create( const uint16_t *image, int nwords );
+void mm_sim_destroy( MM_SIM_DEV *dev );
+int mm_sim_attach( MM_SIM_DEV *dev, uintptr_t base );
+void mm_sim_detach( MM_SIM_DEV *dev );
+void mm_sim_set_busy( MM_SIM_DEV *dev, uint32_t busyUs );
+void mm_sim_set_tpd( MM_SIM_DEV *dev, uint32_t tpdNs );
+void mm_sim_fault_init( MM_SIM_FAULT *fault );
+void mm_sim_set_fault( MM_SIM_DEV *dev, const MM_SIM_FAULT *fault );
+int mm_sim_parse_fault( const char *spec, MM_SIM_FAULT *fault );
+void mm_sim_get_image( const MM_SIM_DEV *dev, uint16_t *image );
+void mm_sim_get_cnt( const MM_SIM_DEV *dev, MM_SIM_CNT *cnt );
+
+#endif /* _MM_SIM_H */
@@ -0,0 +1,117 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_stats.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Bus transaction counters and phase timings.
+ *
+ *               The register access and bit-bang functions count into
+ *               the MM_STATS of the calling thread. Like the timing, the
+ *               statistics pointer is thread local, so parallel workers
+ *               count into the slot they are working on without locking.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "mm_stats.h"
+
+__thread MM_STATS *MM_StatsCur;
+
+/******************************* mm_stats_set ******************************/
+/**   Set the statistics the calling thread counts into.
+ *---------------------------------------------------------------------------
+ *  \param st			\IN statistics (must stay valid), NULL=off
+ ****************************************************************************/
+void mm_stats_set( MM_STATS *st )
+{
+	MM_StatsCur = st;
+}
+
+/******************************* mm_stats_get ******************************/
+/**   Get the statistics of the calling thread.
+ *---------------------------------------------------------------------------
+ *  \return statistics or NULL
+ ****************************************************************************/
+MM_STATS *mm_stats_get( void )
+{
+	return MM_StatsCur;
+}
+
+/******************************* mm_stats_add ******************************/
+/**   Add statistics.
+ *---------------------------------------------------------------------------
+ *  \param dst			\INOUT sum
+ *  \param src			\IN statistics to add
+ ****************************************************************************/
+void mm_stats_add( MM_STATS *dst, const MM_STATS *src )
+{
+	dst->reads    += src->reads;
+	dst->writes   += src->writes;
+	dst->clocks   += src->clocks;
+	dst->delays   += src->delays;
+	dst->delayNs  += src->delayNs;
+	dst->polls    += src->polls;
+	dst->words    += src->words;
+	dst->readNs   += src->readNs;
+	dst->cycles   += src->cycles;
+	dst->waitNs   += src->waitNs;
+	if( src->waitMaxNs > dst->waitMaxNs )
+		dst->waitMaxNs = src->waitMaxNs;
+	dst->tuneNs   += src->tuneNs;
+	dst->progNs   += src->progNs;
+	dst->identNs  += src->identNs;
+}
+
+/******************************* mm_hist_init ******************************/
+/**   Clear a histogram.
+ *---------------------------------------------------------------------------
+ *  \param h			\OUT histogram
+ ****************************************************************************/
+void mm_hist_init( MM_HIST *h )
+{
+	memset( h, 0, sizeof(*h) );
+}
+
+/******************************* mm_hist_add *******************************/
+/**   Add a value to a histogram.
+ *
+ *    Values below 1 us go into bucket 0.
+ *---------------------------------------------------------------------------
+ *  \param h			\INOUT histogram
+ *  \param ns			\IN value
+ ****************************************************************************/
+void mm_hist_add( MM_HIST *h, uint64_t ns )
+{
+	uint64_t us = ns / 1000;
+	int b = 0;
+
+	while( b < MM_HIST_BUCKETS - 1 && (us >> (b + 1)) )
+		b++;
+
+	if( h->n == 0 || us < h->minUs )
+		h->minUs = us;
+	if( us > h->maxUs )
+		h->maxUs = us;
+	h->sumUs += us;
+	h->n++;
+	h->bucket[b]++;
+}
@@ -0,0 +1,84 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_stats.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Bus transaction counters and phase timings.
+ *
+ *               Counters are collected into the MM_STATS of the calling
+ *               thread (mm_stats_set()), nothing is counted if none is
+ *               set. Build with -DMM_NO_STATS to remove the counting.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_STATS_H
+#define _MM_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define MM_HIST_BUCKETS	32		/* log2 buckets, 1 us .. 2^31 us */
+
+/** counters and phase times of one slot */
+typedef struct MM_STATS {
+	uint64_t reads;				/**< MODREG reads */
+	uint64_t writes;			/**< MODREG writes */
+	uint64_t clocks;			/**< clock cycles */
+	uint64_t delays;			/**< half bit delays */
+	uint64_t delayNs;			/**< time spent in delays */
+	uint64_t polls;				/**< ready/busy status polls */
+	uint64_t words;				/**< words read */
+	uint64_t readNs;			/**< time spent in word reads */
+	uint64_t cycles;			/**< erase/write cycles */
+	uint64_t waitNs;			/**< time spent waiting for ready */
+	uint64_t waitMaxNs;			/**< longest erase/write cycle */
+	uint64_t tuneNs;			/**< phase: auto-tuning */
+	uint64_t progNs;			/**< phase: programming */
+	uint64_t identNs;			/**< phase: identification */
+} MM_STATS;
+
+/** latency histogram, bucket i counts values in [2^i, 2^(i+1)) us */
+typedef struct MM_HIST {
+	uint32_t n;
+	uint64_t minUs;
+	uint64_t maxUs;
+	uint64_t sumUs;
+	uint32_t bucket[MM_HIST_BUCKETS];
+} MM_HIST;
+
+extern __thread MM_STATS *MM_StatsCur;
+
+#ifdef MM_NO_STATS
+# define MM_STATS_ON		0
+# define MM_STATS_ADD(field, n)	do { } while(0)
+#else
+# define MM_STATS_ON		(MM_StatsCur != NULL)
+# define MM_STATS_ADD(field, n) \
+	do { if( MM_StatsCur ) MM_StatsCur->field += (n); } while(0)
+#endif
+
+void mm_stats_set( MM_STATS *st );
+MM_STATS *mm_stats_get( void );
+void mm_stats_add( MM_STATS *dst, const MM_STATS *src );
+void mm_hist_init( MM_HIST *h );
+void mm_hist_add( MM_HIST *h, uint64_t ns );
+
+#endif /* _MM_STATS_H */
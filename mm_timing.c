@@ -0,0 +1,212 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_timing.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Bit timing of the serial EEPROM interface.
+ *
+ *               Delays are measured with CLOCK_MONOTONIC (vDSO, TSC based
+ *               on x86) instead of counting loop iterations, so they are
+ *               independent of CPU model, frequency scaling and compiler
+ *               flags. The timing in use is thread local, so parallel
+ *               workers can run every slot at its own speed.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "mm_eeprom.h"
+#include "mm_timing.h"
+
+static MM_TIMING G_tmDefault = { MM_HALF_NS_DEFAULT, 1, MM_ACCESS_F204 };
+static __thread const MM_TIMING *G_tmCur;
+
+static uint32_t G_clockCostNs;		/* cost of one mm_time_ns() call */
+
+/******************************* mm_time_ns ********************************/
+/**   Monotonic time in ns.
+ *---------------------------------------------------------------------------
+ *  \return current time
+ ****************************************************************************/
+uint64_t mm_time_ns( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/******************************* mm_timing_calibrate ***********************/
+/**   Measure the cost of reading the clock.
+ *
+ *    mm_delay_ns() subtracts half of it, so short delays don't get
+ *    stretched by the clock reads themselves.
+ ****************************************************************************/
+void mm_timing_calibrate( void )
+{
+	uint64_t t0, t1, best = ~0ULL;
+	int i;
+
+	for( i=0; i<64; i++ ){
+		t0 = mm_time_ns();
+		t1 = mm_time_ns();
+		if( t1 - t0 < best )
+			best = t1 - t0;
+	}
+	G_clockCostNs = (uint32_t)best;
+}
+
+/******************************* mm_delay_ns *******************************/
+/**   Busy wait (at least) ns nanoseconds.
+ *---------------------------------------------------------------------------
+ *  \param ns			\IN delay
+ *  \return time actually waited
+ ****************************************************************************/
+uint32_t mm_delay_ns( uint32_t ns )
+{
+	uint64_t start, now, end;
+
+	if( ns <= G_clockCostNs / 2 )
+		return 0;
+
+	start = mm_time_ns();
+	end = start + ns - G_clockCostNs / 2;
+	while( (now = mm_time_ns()) < end )
+		;
+	return (uint32_t)(now - start);
+}
+
+/******************************* mm_timing_set_default *********************/
+/**   Set the timing of threads without own timing.
+ *---------------------------------------------------------------------------
+ *  \param tm			\IN timing
+ ****************************************************************************/
+void mm_timing_set_default( const MM_TIMING *tm )
+{
+	G_tmDefault = *tm;
+}
+
+/******************************* mm_timing_set *****************************/
+/**   Set the timing of the calling thread.
+ *---------------------------------------------------------------------------
+ *  \param tm			\IN timing (must stay valid), NULL=default
+ ****************************************************************************/
+void mm_timing_set( const MM_TIMING *tm )
+{
+	G_tmCur = tm;
+}
+
+/******************************* mm_timing_get *****************************/
+/**   Get the timing of the calling thread.
+ *---------------------------------------------------------------------------
+ *  \return timing
+ ****************************************************************************/
+const MM_TIMING *mm_timing_get( void )
+{
+	return G_tmCur ? G_tmCur : &G_tmDefault;
+}
+
+/******************************* _tune_check *******************************/
+/**   Read the tuning words MM_TUNE_PASSES times with a given timing.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param tm			\IN timing to check
+ *  \param refWords		\IN expected contents
+ *  \return 1=all reads match, 0=error
+ ****************************************************************************/
+static int _tune_check( uintptr_t base, const MM_TIMING *tm,
+						const uint16_t *refWords )
+{
+	uint16_t buf[MM_TUNE_WORDS];
+	int i;
+
+	mm_timing_set( tm );
+	for( i=0; i<MM_TUNE_PASSES; i++ ){
+		if( m_read_range( base, 0, MM_TUNE_WORDS, buf ) ||
+			memcmp( buf, refWords, sizeof(buf) ) )
+			return 0;
+	}
+	return 1;
+}
+
+/******************************* mm_autotune *******************************/
+/**   Find the fastest reliable bit period of a slot.
+ *
+ *    The first MM_TUNE_WORDS words are read twice with the reference
+ *    timing; both reads must match and must not be all equal (no EEPROM).
+ *    Then a binary search looks for the shortest half period at which
+ *    MM_TUNE_PASSES reads return the same contents. The recommended
+ *    period adds MM_TUNE_MARGIN percent.
+ *    The calling thread's timing is restored on return.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param ref			\IN reference timing (known to be reliable)
+ *  \param tune			\OUT result
+ *  \return 0=ok, 1=no stable reference contents
+ ****************************************************************************/
+int mm_autotune( uintptr_t base, const MM_TIMING *ref, MM_TUNE *tune )
+{
+	const MM_TIMING *saved = G_tmCur;
+	uint16_t refWords[MM_TUNE_WORDS], chk[MM_TUNE_WORDS];
+	MM_TIMING tm = *ref;
+	uint32_t lo = MM_HALF_NS_MIN, hi = ref->halfNs, mid;
+	int i, equal = 1;
+
+	memset( tune, 0, sizeof(*tune) );
+
+	mm_timing_set( ref );
+	if( m_read_range( base, 0, MM_TUNE_WORDS, refWords ) ||
+		m_read_range( base, 0, MM_TUNE_WORDS, chk ) ||
+		memcmp( refWords, chk, sizeof(chk) ) )
+		goto FAIL;
+	for( i=1; i<MM_TUNE_WORDS; i++ )
+		if( refWords[i] != refWords[0] )
+			equal = 0;
+	if( equal )
+		goto FAIL;
+
+	if( lo > hi )
+		lo = hi;
+
+	/* binary search, stop at 5% resolution */
+	while( lo < hi && (hi - lo) * 20 > hi ){
+		mid = lo + (hi - lo) / 2;
+		tm.halfNs = mid;
+		tune->steps++;
+		if( _tune_check( base, &tm, refWords ) )
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	tune->limitNs = hi;
+	tune->halfNs  = hi * MM_TUNE_MARGIN / 100;
+	if( tune->halfNs > ref->halfNs )
+		tune->halfNs = ref->halfNs;
+
+	mm_timing_set( saved );
+	return 0;
+
+FAIL:
+	mm_timing_set( saved );
+	return 1;
+}
@@ -0,0 +1,64 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_timing.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Bit timing of the serial EEPROM interface, based on the
+ *               monotonic clock, and per slot speed auto-tuning.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_TIMING_H
+#define _MM_TIMING_H
+
+#include <stdint.h>
+
+#define MM_HALF_NS_DEFAULT	1000	/* default half bit period (ns) */
+#define MM_HALF_NS_MIN		20		/* fastest half bit period tried (ns) */
+#define MM_TUNE_WORDS		16		/* words compared by auto-tuning */
+#define MM_TUNE_PASSES		3		/* error free reads required */
+#define MM_TUNE_MARGIN		150		/* tuned period = limit * margin / 100 */
+
+/** bit timing and register access of a slot */
+typedef struct MM_TIMING {
+	uint32_t halfNs;			/**< delay after each clock edge (ns) */
+	int      flush;				/**< read back MODREG after each write so
+									 the delay starts when the posted
+									 write has reached the carrier */
+	int      access;			/**< MM_ACCESS_xxx profile of MMIO */
+} MM_TIMING;
+
+/** auto-tuning result */
+typedef struct MM_TUNE {
+	uint32_t limitNs;			/**< fastest error free half period (ns) */
+	uint32_t halfNs;			/**< recommended half period incl. margin */
+	int      steps;				/**< tried periods */
+} MM_TUNE;
+
+uint64_t mm_time_ns( void );
+void mm_timing_calibrate( void );
+uint32_t mm_delay_ns( uint32_t ns );
+void mm_timing_set_default( const MM_TIMING *tm );
+void mm_timing_set( const MM_TIMING *tm );
+const MM_TIMING *mm_timing_get( void );
+int mm_autotune( uintptr_t base, const MM_TIMING *ref, MM_TUNE *tune );
+
+#endif /* _MM_TIMING_H */
@@ -0,0 +1,506 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_trace.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief MODREG bus tracer and trace replay.
+ *
+ *               Tracing: MM_BusTrace is put in front of the backend in
+ *               use. Each access costs a clock read and a store into a
+ *               ring buffer that is allocated before tracing starts;
+ *               the slot in the ring is claimed with an atomic increment,
+ *               so parallel workers don't lock. When the ring is full the
+ *               oldest events are overwritten.
+ *
+ *               Trace file (text, one access per line):
+ *
+ *               <ns> <phys> <R|W> <offset> <value>
+ *
+ *               ns is relative to the first event, all other numbers are
+ *               hex.
+ *
+ *               Replay: MM_BusReplay answers every read of a slot with
+ *               the next value read from it in the trace, independent of
+ *               timing. Writes are compared with the trace; accesses that
+ *               don't match are counted as divergence.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mm_timing.h"
+#include "mm_trace.h"
+
+#define TRACE_HEADER	"# mm_ident trace v1"
+#define VCD_SIGNALS		4		/* cs, clk, di, do per slot */
+
+/* tracer */
+static MM_TRACE_EV      *G_ring;
+static uint32_t          G_ringSize;
+static uint64_t          G_seq;			/* events recorded so far */
+static const MM_BUS_OPS *G_inner;		/* traced backend */
+
+/** replayed slot */
+typedef struct {
+	uint64_t     phys;
+	MM_TRACE_EV *ev;
+	uint32_t     n;
+	uint32_t     max;
+	uint32_t     pos;			/* next event */
+} REPLAY_DEV;
+
+/* replay */
+static REPLAY_DEV   *G_rdev;
+static int           G_nrdev;
+static MM_REPLAY_CNT G_rcnt;
+
+/******************************* _trace_rec ********************************/
+/**   Record an access.
+ ****************************************************************************/
+static void _trace_rec( uint64_t ns, uintptr_t base, uint32_t offset,
+						uint16_t val, int write )
+{
+	uint64_t seq = __atomic_fetch_add( &G_seq, 1, __ATOMIC_RELAXED );
+	MM_TRACE_EV *ev = &G_ring[seq % G_ringSize];
+
+	ev->ns     = ns;
+	ev->base   = base;
+	ev->offset = offset;
+	ev->val    = val;
+	ev->write  = (uint8_t)write;
+}
+
+static void _trace_write16( uintptr_t base, uint32_t offset, uint16_t val )
+{
+	_trace_rec( mm_time_ns(), base, offset, val, 1 );
+	G_inner->write16( base, offset, val );
+}
+
+static uint16_t _trace_read16( uintptr_t base, uint32_t offset )
+{
+	uint64_t ns = mm_time_ns();
+	uint16_t val = G_inner->read16( base, offset );
+
+	_trace_rec( ns, base, offset, val, 0 );
+	return val;
+}
+
+const MM_BUS_OPS MM_BusTrace = {
+	"trace",
+	_trace_write16,
+	_trace_read16
+};
+
+/******************************* mm_trace_start ****************************/
+/**   Start tracing all accesses of the backend in use.
+ *
+ *    Must not be called while other threads access the bus.
+ *---------------------------------------------------------------------------
+ *  \param nEvents		\IN ring buffer size (0=MM_TRACE_EVENTS)
+ *  \return 0=ok, -1=out of memory
+ ****************************************************************************/
+int mm_trace_start( uint32_t nEvents )
+{
+	if( mm_bus_get() == &MM_BusTrace )
+		return 0;
+
+	mm_trace_free();
+	G_ringSize = nEvents ? nEvents : MM_TRACE_EVENTS;
+	if( !(G_ring = calloc( G_ringSize, sizeof(*G_ring) )) )
+		return -1;
+	G_seq   = 0;
+	G_inner = mm_bus_get();
+	mm_bus_set( &MM_BusTrace );
+	return 0;
+}
+
+/******************************* mm_trace_stop *****************************/
+/**   Stop tracing, the recorded events stay available.
+ ****************************************************************************/
+void mm_trace_stop( void )
+{
+	if( mm_bus_get() == &MM_BusTrace )
+		mm_bus_set( G_inner );
+}
+
+/******************************* mm_trace_free *****************************/
+/**   Free the recorded events (stops tracing).
+ ****************************************************************************/
+void mm_trace_free( void )
+{
+	mm_trace_stop();
+	free( G_ring );
+	G_ring     = NULL;
+	G_ringSize = 0;
+	G_seq      = 0;
+}
+
+/******************************* mm_trace_get ******************************/
+/**   Get the recorded events, oldest first.
+ *---------------------------------------------------------------------------
+ *  \param ev			\OUT events (NULL=only count)
+ *  \param max			\IN size of ev
+ *  \param lost			\OUT overwritten events (may be NULL)
+ *  \return number of events available
+ ****************************************************************************/
+uint32_t mm_trace_get( MM_TRACE_EV *ev, uint32_t max, uint64_t *lost )
+{
+	uint64_t first = G_seq > G_ringSize ? G_seq - G_ringSize : 0;
+	uint32_t n = (uint32_t)(G_seq - first), i;
+
+	if( lost )
+		*lost = first;
+	for( i=0; ev && i<n && i<max; i++ )
+		ev[i] = G_ring[(first + i) % G_ringSize];
+	return n;
+}
+
+/******************************* _trace_phys *******************************/
+/**   Physical address of a traced slot.
+ ****************************************************************************/
+static uint64_t _trace_phys( uintptr_t base, const MM_TRACE_SLOT *slot,
+							 int nslots )
+{
+	int i;
+
+	for( i=0; i<nslots; i++ )
+		if( slot[i].base == base )
+			return slot[i].phys;
+	return base;
+}
+
+/******************************* _trace_events *****************************/
+/**   Copy of the recorded events in time order.
+ *---------------------------------------------------------------------------
+ *  \param n			\OUT number of events
+ *  \return events (free() them) or NULL
+ ****************************************************************************/
+static MM_TRACE_EV *_trace_events( uint32_t *n )
+{
+	MM_TRACE_EV *ev, tmp;
+	uint32_t i, j;
+
+	*n = mm_trace_get( NULL, 0, NULL );
+	if( !(ev = malloc( ((size_t)*n + 1) * sizeof(*ev) )) )
+		return NULL;
+	mm_trace_get( ev, *n, NULL );
+
+	/*
+	 * workers record concurrently, so the ring is only nearly in time
+	 * order; insertion sort is cheap for that and stable, which keeps
+	 * the recording order of each slot
+	 */
+	for( i=1; i<*n; i++ ){
+		tmp = ev[i];
+		for( j=i; j>0 && ev[j-1].ns > tmp.ns; j-- )
+			ev[j] = ev[j-1];
+		ev[j] = tmp;
+	}
+	return ev;
+}
+
+/******************************* mm_trace_save *****************************/
+/**   Save the recorded events as text (for mm_replay_load()).
+ *---------------------------------------------------------------------------
+ *  \param path			\IN file
+ *  \param slot			\IN physical addresses of the traced slots
+ *  \param nslots		\IN number of slots
+ *  \return 0=ok, -1=error
+ ****************************************************************************/
+int mm_trace_save( const char *path, const MM_TRACE_SLOT *slot, int nslots )
+{
+	MM_TRACE_EV *ev;
+	uint64_t lost;
+	uint32_t n, i;
+	FILE *fp;
+	int err;
+
+	if( !(ev = _trace_events( &n )) )
+		return -1;
+	if( !(fp = fopen( path, "w" )) ){
+		free( ev );
+		return -1;
+	}
+
+	mm_trace_get( NULL, 0, &lost );
+	fprintf( fp, "%s\n# %u events, %llu lost\n", TRACE_HEADER, n,
+			 (unsigned long long)lost );
+	for( i=0; i<n; i++ )
+		fprintf( fp, "%llu %llx %c %x %04x\n",
+				 (unsigned long long)(ev[i].ns - ev[0].ns),
+				 (unsigned long long)_trace_phys( ev[i].base, slot, nslots ),
+				 ev[i].write ? 'W' : 'R', ev[i].offset, ev[i].val );
+
+	free( ev );
+	err = ferror( fp );
+	return (fclose( fp ) || err) ? -1 : 0;
+}
+
+/******************************* _vcd_id ***********************************/
+/**   VCD identifier of signal k of the i-th slot.
+ ****************************************************************************/
+static void _vcd_id( int i, int k, char *id )
+{
+	int n = i * VCD_SIGNALS + k;
+
+	do {
+		*id++ = (char)('!' + n % 94);
+		n /= 94;
+	} while( n );
+	*id = '\0';
+}
+
+/******************************* mm_trace_vcd ******************************/
+/**   Export the recorded MODREG accesses as VCD.
+ *
+ *    Every slot gets the signals cs, clk, di (from writes) and do (from
+ *    reads). The time scale is 1 ns, time 0 is the first event.
+ *---------------------------------------------------------------------------
+ *  \param path			\IN file
+ *  \param slot			\IN physical addresses of the traced slots
+ *  \param nslots		\IN number of slots
+ *  \return 0=ok, -1=error
+ ****************************************************************************/
+int mm_trace_vcd( const char *path, const MM_TRACE_SLOT *slot, int nslots )
+{
+	static const char *sigName[VCD_SIGNALS] = { "cs", "clk", "di", "do" };
+	MM_TRACE_EV *ev;
+	uintptr_t *base = NULL, *nb;
+	char (*lvl)[VCD_SIGNALS] = NULL, id[8], v[VCD_SIGNALS];
+	uint64_t t = ~0ULL;
+	uint32_t n, i;
+	int nb_ = 0, s, k, err = -1;
+	FILE *fp = NULL;
+
+	if( !(ev = _trace_events( &n )) )
+		return -1;
+
+	/* slots in order of appearance */
+	for( i=0; i<n; i++ ){
+		for( s=0; s<nb_ && base[s] != ev[i].base; s++ )
+			;
+		if( s < nb_ )
+			continue;
+		if( !(nb = realloc( base, (nb_ + 1) * sizeof(*base) )) )
+			goto DONE;
+		base = nb;
+		base[nb_++] = ev[i].base;
+	}
+	if( !(lvl = calloc( nb_ + 1, sizeof(*lvl) )) ||
+		!(fp = fopen( path, "w" )) )
+		goto DONE;
+
+	fprintf( fp, "$version mm_ident MODREG trace $end\n"
+			 "$timescale 1ns $end\n$scope module mm_ident $end\n" );
+	for( s=0; s<nb_; s++ ){
+		fprintf( fp, "$scope module slot_%llx $end\n",
+				 (unsigned long long)_trace_phys( base[s], slot, nslots ) );
+		for( k=0; k<VCD_SIGNALS; k++ ){
+			_vcd_id( s, k, id );
+			fprintf( fp, "$var wire 1 %s %s $end\n", id, sigName[k] );
+		}
+		fprintf( fp, "$upscope $end\n" );
+		memset( lvl[s], 'x', VCD_SIGNALS );
+	}
+	fprintf( fp, "$upscope $end\n$enddefinitions $end\n" );
+
+	for( i=0; i<n; i++ ){
+		if( ev[i].offset != MODREG )
+			continue;
+		for( s=0; base[s] != ev[i].base; s++ )
+			;
+		memcpy( v, lvl[s], VCD_SIGNALS );
+		if( ev[i].write ){
+			v[0] = (ev[i].val & B_SEL) ? '1' : '0';
+			v[1] = (ev[i].val & B_CLK) ? '1' : '0';
+			v[2] = (ev[i].val & B_DAT) ? '1' : '0';
+		}
+		else
+			v[3] = (ev[i].val & B_DAT) ? '1' : '0';
+		if( !memcmp( v, lvl[s], VCD_SIGNALS ) )
+			continue;
+
+		if( ev[i].ns - ev[0].ns != t ){
+			t = ev[i].ns - ev[0].ns;
+			fprintf( fp, "#%llu\n", (unsigned long long)t );
+		}
+		for( k=0; k<VCD_SIGNALS; k++ ){
+			if( v[k] == lvl[s][k] )
+				continue;
+			_vcd_id( s, k, id );
+			fprintf( fp, "%c%s\n", v[k], id );
+		}
+		memcpy( lvl[s], v, VCD_SIGNALS );
+	}
+	err = ferror( fp ) ? -1 : 0;
+
+DONE:
+	if( fp && fclose( fp ) )
+		err = -1;
+	free( lvl );
+	free( base );
+	free( ev );
+	return err;
+}
+
+/******************************* _replay_find ******************************/
+/**   Get the replayed slot at 'base'.
+ ****************************************************************************/
+static REPLAY_DEV *_replay_find( uintptr_t base )
+{
+	int i;
+
+	for( i=0; i<G_nrdev; i++ )
+		if( G_rdev[i].phys == (uint64_t)base )
+			return &G_rdev[i];
+	return NULL;
+}
+
+static void _replay_write16( uintptr_t base, uint32_t offset, uint16_t val )
+{
+	REPLAY_DEV *d = _replay_find( base );
+	MM_TRACE_EV *ev;
+
+	if( !d || d->pos == d->n || !d->ev[d->pos].write ){
+		__atomic_add_fetch( &G_rcnt.diverged, 1, __ATOMIC_RELAXED );
+		return;
+	}
+	ev = &d->ev[d->pos++];
+	if( ev->offset == offset && ev->val == val )
+		__atomic_add_fetch( &G_rcnt.writes, 1, __ATOMIC_RELAXED );
+	else
+		__atomic_add_fetch( &G_rcnt.diverged, 1, __ATOMIC_RELAXED );
+}
+
+static uint16_t _replay_read16( uintptr_t base, uint32_t offset )
+{
+	REPLAY_DEV *d = _replay_find( base );
+
+	if( !d )
+		return 0xffff;				/* empty slot */
+
+	/* recorded writes that didn't happen */
+	while( d->pos < d->n && d->ev[d->pos].write ){
+		d->pos++;
+		__atomic_add_fetch( &G_rcnt.diverged, 1, __ATOMIC_RELAXED );
+	}
+	if( d->pos == d->n || d->ev[d->pos].offset != offset ){
+		__atomic_add_fetch( &G_rcnt.diverged, 1, __ATOMIC_RELAXED );
+		return 0xffff;
+	}
+	__atomic_add_fetch( &G_rcnt.reads, 1, __ATOMIC_RELAXED );
+	return d->ev[d->pos++].val;
+}
+
+const MM_BUS_OPS MM_BusReplay = {
+	"replay",
+	_replay_write16,
+	_replay_read16
+};
+
+/******************************* mm_replay_load ****************************/
+/**   Load a trace file for MM_BusReplay.
+ *
+ *    The replayed slots are addressed by their physical address (use
+ *    mm_scan_map() with direct=1).
+ *---------------------------------------------------------------------------
+ *  \param path			\IN trace file written by mm_trace_save()
+ *  \return number of events, -1=error
+ ****************************************************************************/
+int mm_replay_load( const char *path )
+{
+	char line[128], rw;
+	unsigned long long ns, phys;
+	unsigned int offset, val;
+	REPLAY_DEV *d;
+	MM_TRACE_EV *ev;
+	FILE *fp;
+	int n = 0;
+
+	mm_replay_free();
+	if( !(fp = fopen( path, "r" )) )
+		return -1;
+
+	while( fgets( line, sizeof(line), fp ) ){
+		if( line[0] == '#' ||
+			sscanf( line, "%llu %llx %c %x %x", &ns, &phys, &rw, &offset,
+					&val ) != 5 )
+			continue;
+
+		if( !(d = _replay_find( (uintptr_t)phys )) ){
+			if( !(d = realloc( G_rdev, (G_nrdev + 1) * sizeof(*d) )) )
+				goto ERR;
+			G_rdev = d;
+			d = &G_rdev[G_nrdev++];
+			memset( d, 0, sizeof(*d) );
+			d->phys = phys;
+		}
+		if( d->n == d->max ){
+			uint32_t max = d->max ? 2 * d->max : 1024;
+
+			if( !(ev = realloc( d->ev, max * sizeof(*ev) )) )
+				goto ERR;
+			d->ev  = ev;
+			d->max = max;
+		}
+		ev = &d->ev[d->n++];
+		ev->ns     = ns;
+		ev->base   = (uintptr_t)phys;
+		ev->offset = offset;
+		ev->val    = (uint16_t)val;
+		ev->write  = (rw == 'W');
+		n++;
+	}
+	fclose( fp );
+	return n;
+
+ERR:
+	fclose( fp );
+	mm_replay_free();
+	return -1;
+}
+
+/******************************* mm_replay_get_cnt *************************/
+/**   Get the replay counters.
+ *---------------------------------------------------------------------------
+ *  \param cnt			\OUT counters
+ ****************************************************************************/
+void mm_replay_get_cnt( MM_REPLAY_CNT *cnt )
+{
+	*cnt = G_rcnt;
+}
+
+/******************************* mm_replay_free ****************************/
+/**   Free a loaded trace.
+ ****************************************************************************/
+void mm_replay_free( void )
+{
+	int i;
+
+	for( i=0; i<G_nrdev; i++ )
+		free( G_rdev[i].ev );
+	free( G_rdev );
+	G_rdev  = NULL;
+	G_nrdev = 0;
+	memset( &G_rcnt, 0, sizeof(G_rcnt) );
+}
@@ -0,0 +1,78 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_trace.h
+ *
+ *      \author  awe
+ *
+ *       \brief  MODREG bus tracer and trace replay.
+ *
+ *               The tracer is a bus backend that records every MODREG
+ *               access into a preallocated ring buffer and passes it on
+ *               to the backend in use. Traces can be exported as VCD or
+ *               saved as text; a saved trace can be replayed through the
+ *               MM_BusReplay backend as a deterministic device model.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_TRACE_H
+#define _MM_TRACE_H
+
+#include <stdint.h>
+#include "mm_eeprom.h"
+
+#define MM_TRACE_EVENTS	(1 << 20)	/* default ring buffer size */
+
+/** one recorded access */
+typedef struct MM_TRACE_EV {
+	uint64_t  ns;				/**< CLOCK_MONOTONIC time */
+	uintptr_t base;				/**< slot (as passed to the backend) */
+	uint32_t  offset;			/**< register offset */
+	uint16_t  val;				/**< written/read value */
+	uint8_t   write;			/**< 1=write, 0=read */
+} MM_TRACE_EV;
+
+/** name of a traced slot in exported files */
+typedef struct MM_TRACE_SLOT {
+	uintptr_t base;				/**< address passed to the backend */
+	uint64_t  phys;				/**< physical slot address */
+} MM_TRACE_SLOT;
+
+/** replay result */
+typedef struct MM_REPLAY_CNT {
+	uint64_t reads;				/**< reads answered from the trace */
+	uint64_t writes;			/**< writes matching the trace */
+	uint64_t diverged;			/**< accesses not matching the trace */
+} MM_REPLAY_CNT;
+
+extern const MM_BUS_OPS MM_BusTrace;	/* tracer, wraps the backend in use */
+extern const MM_BUS_OPS MM_BusReplay;	/* replays a loaded trace */
+
+int mm_trace_start( uint32_t nEvents );
+void mm_trace_stop( void );
+uint32_t mm_trace_get( MM_TRACE_EV *ev, uint32_t max, uint64_t *lost );
+int mm_trace_save( const char *path, const MM_TRACE_SLOT *slot, int nslots );
+int mm_trace_vcd( const char *path, const MM_TRACE_SLOT *slot, int nslots );
+void mm_trace_free( void );
+
+int mm_replay_load( const char *path );
+void mm_replay_get_cnt( MM_REPLAY_CNT *cnt );
+void mm_replay_free( void );
+
+#endif /* _MM_TRACE_H */
@@ -0,0 +1,230 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_verify.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Error-detecting EEPROM reads with per-word retry.
+ *
+ *               The CRC-16 detects every error burst of up to 16 bits
+ *               and every odd number of bit errors, also the same bit
+ *               flipped or stuck in several words, so a match validates
+ *               the image whether the writer meant to store a checksum or
+ *               not (1 in 65536 images matches by chance). The second
+ *               read runs at twice the period, so an error that repeats
+ *               at the fast period shows up as well.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "mm_eeprom.h"
+#include "mm_timing.h"
+#include "mm_lock.h"
+#include "mm_verify.h"
+
+#define W(n)	((uint32_t)1 << (n))
+#define CRC_POLY	0x1021		/* CRC-16/CCITT x^16 + x^12 + x^5 + 1 */
+#define CRC_INIT	0xffff
+
+/* words of the id evaluated by m_decode_modinfo() */
+#define NEED_MODINFO	(W(MM_EE_MAGIC) | W(MM_EE_MODID) | W(MM_EE_LAYOUT) | \
+						 W(MM_EE_VARIANT))
+
+/******************************* mm_verify_crc *****************************/
+/**   Checksum of an image.
+ *
+ *    CRC-16/CCITT (polynomial 0x1021, start value 0xffff) of the words,
+ *    each word MSB first.
+ *---------------------------------------------------------------------------
+ *  \param words		\IN words 0..MM_EE_CHKSUM-1
+ *  \return CRC of the words, the value MM_EE_CHKSUM must hold
+ ****************************************************************************/
+uint16_t mm_verify_crc( const uint16_t *words )
+{
+	uint16_t crc = CRC_INIT;
+	int i, b;
+
+	for( i=0; i<MM_EE_CHKSUM; i++ ){
+		crc ^= words[i];
+		for( b=0; b<16; b++ )
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ CRC_POLY) :
+				(uint16_t)(crc << 1);
+	}
+	return crc;
+}
+
+/******************************* _verify_period ****************************/
+/**   Switch the calling thread to another half bit period.
+ ****************************************************************************/
+static void _verify_period( MM_TIMING *tm, const MM_TIMING *fast,
+							uint32_t halfNs )
+{
+	*tm = *fast;
+	tm->halfNs = halfNs;
+	mm_timing_set( tm );
+}
+
+/******************************* _verify_word ******************************/
+/**   Re-read a word in pairs at slower periods until a pair agrees.
+ *
+ *    The period doubles with each pair, starting from 'halfNs', the last
+ *    pair runs at 'slowNs'.
+ *---------------------------------------------------------------------------
+ *  \return 0=ok, 1=no pair agreed
+ ****************************************************************************/
+static int _verify_word( uintptr_t base, uint8_t index, uint16_t *word,
+						 const MM_TIMING *fast, uint32_t halfNs,
+						 uint32_t slowNs, MM_VERIFY_CNT *cnt )
+{
+	MM_TIMING tm;
+	uint16_t a, b;
+	int k;
+
+	for( k=0; k<MM_VERIFY_RETRIES; k++ ){
+		halfNs = (k == MM_VERIFY_RETRIES - 1 || halfNs * 2 > slowNs) ?
+			slowNs : halfNs * 2;
+		_verify_period( &tm, fast, halfNs );
+		a = (uint16_t)m_read( base, index );
+		b = (uint16_t)m_read( base, index );
+		mm_timing_set( fast );
+		cnt->retries += 2;
+		if( a == b ){
+			*word = a;
+			return 0;
+		}
+	}
+	cnt->failed++;
+	return 1;
+}
+
+/******************************* mm_verify_read ****************************/
+/**   Read words 0..MM_VERIFY_WORDS-1 and validate them.
+ *
+ *    All words are read at the period of the calling thread. If the
+ *    checksum matches, they are valid. Otherwise the words in 'need' are
+ *    read again at twice the period and compared, words that differ get
+ *    slower re-reads (see mm_verify.h); the other words stay unverified.
+ *    A slot that doesn't answer is probed again at 'slowNs' before it is
+ *    reported empty or stuck.
+ *
+ *    The slot is locked for the whole read.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN base address pointer
+ *  \param need			\IN bit n: word n must be valid (n < MM_VERIFY_WORDS)
+ *  \param slowNs		\IN safe half bit period for re-reads (ns)
+ *  \param words		\OUT MM_VERIFY_WORDS words
+ *  \param probe		\OUT MM_PROBE_xxx
+ *  \param cnt			\INOUT counters
+ *  \return 0=ok, 1=error (slot busy or word without two equal reads)
+ ****************************************************************************/
+int mm_verify_read( uintptr_t base, uint32_t need, uint32_t slowNs,
+					uint16_t *words, int *probe, MM_VERIFY_CNT *cnt )
+{
+	const MM_TIMING *saved = mm_timing_get(), *fast = saved;
+	MM_TIMING tm, slow;
+	uint16_t chk[MM_VERIFY_WORDS];
+	uint32_t checkNs;
+	int first, count, i, err = 0;
+
+	if( mm_lock_take( base ) ){
+		for( i=0; i<MM_VERIFY_WORDS; i++ )
+			words[i] = 0xffff;
+		*probe = MM_PROBE_BUSY;
+		return 1;
+	}
+	cnt->reads++;
+	if( slowNs < fast->halfNs )
+		slowNs = fast->halfNs;
+
+	m_read_range_probe( base, 0, MM_VERIFY_WORDS, words, probe );
+	if( *probe != MM_PROBE_PRESENT ){
+		/* a marginal edge can miss the dummy zero */
+		_verify_period( &slow, fast, slowNs );
+		m_read_range_probe( base, 0, MM_VERIFY_WORDS, words, probe );
+		cnt->retries++;
+		if( *probe != MM_PROBE_PRESENT )
+			goto DONE;
+		cnt->errors++;
+		fast = &slow;				/* read the rest slowly */
+	}
+
+	if( mm_verify_crc( words ) == words[MM_EE_CHKSUM] ){
+		cnt->chkOk++;
+		goto DONE;
+	}
+
+	/* second read of the needed words, by runs */
+	checkNs = fast->halfNs * 2 < slowNs ? fast->halfNs * 2 : slowNs;
+	_verify_period( &tm, fast, checkNs );
+	for( first=0; first<MM_VERIFY_WORDS; first += count ){
+		for( count=0; first + count < MM_VERIFY_WORDS &&
+				 (need & W(first + count)); count++ )
+			;
+		if( count )
+			m_read_range( base, (uint8_t)first, (uint8_t)count, &chk[first] );
+		else
+			count = 1;
+	}
+	mm_timing_set( fast );
+	cnt->reread++;
+
+	for( i=0; i<MM_VERIFY_WORDS; i++ ){
+		if( !(need & W(i)) || chk[i] == words[i] )
+			continue;
+		cnt->errors++;
+		err |= _verify_word( base, (uint8_t)i, &words[i], fast, checkNs,
+							 slowNs, cnt );
+	}
+
+DONE:
+	mm_timing_set( saved );
+	mm_lock_give( base );
+	return err;
+}
+
+/******************************* mm_verify_modinfo *************************/
+/**   m_getmodinfo_probe() with error-detecting reads.
+ *---------------------------------------------------------------------------
+ *  \param base			\IN	base address pointer
+ *  \param slowNs		\IN safe half bit period for re-reads (ns)
+ *  \param words		\OUT magic-id, mod-id, layout-rev, product-variant
+ *  \param probe		\OUT MM_PROBE_xxx
+ *  \param modtype		\OUT module type (0, MODCOM_MOD_MEN, MODCOM_MOD_THIRD)
+ *  \param devid		\OUT device id
+ *  \param devrev		\OUT device revision
+ *  \param devname		\OUT device name
+ *  \param cnt			\INOUT counters
+ *  \return 0=ok, 1=error (slot busy or unreliable read)
+ ****************************************************************************/
+int mm_verify_modinfo( uintptr_t base, uint32_t slowNs, uint16_t *words,
+					   int *probe, uint32_t *modtype, uint32_t *devid,
+					   uint32_t *devrev, char *devname, MM_VERIFY_CNT *cnt )
+{
+	uint16_t w[MM_VERIFY_WORDS];
+	int err;
+
+	err = mm_verify_read( base, NEED_MODINFO, slowNs, w, probe, cnt );
+	words[0] = w[MM_EE_MAGIC];
+	words[1] = w[MM_EE_MODID];
+	words[2] = w[MM_EE_LAYOUT];
+	words[3] = w[MM_EE_VARIANT];
+	return m_decode_modinfo( words, modtype, devid, devrev, devname ) || err;
+}
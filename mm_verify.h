@@ -0,0 +1,63 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_verify.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Error-detecting EEPROM reads.
+ *
+ *               Reads the id words at the fast bit period of the slot and
+ *               validates them: by the checksum word (MM_EE_CHKSUM,
+ *               CRC-16 of words 0..14) if it matches, else by a second
+ *               read of the needed words at twice the period. Only the
+ *               words that differ are read again, in pairs at slower
+ *               periods up to the safe one, until both reads of a pair
+ *               agree. A flipped bit is detected instead of trusted, so
+ *               the bus can run much faster than the conservative default.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_VERIFY_H
+#define _MM_VERIFY_H
+
+#include <stdint.h>
+
+#define MM_VERIFY_WORDS		16		/* words read, covered by the checksum */
+#define MM_VERIFY_HALF_NS	250		/* default half bit period (ns) */
+#define MM_VERIFY_RETRIES	3		/* slower re-read pairs of a word */
+
+/** counters of error-detecting reads, accumulated */
+typedef struct MM_VERIFY_CNT {
+	uint32_t reads;				/**< validated reads */
+	uint32_t chkOk;				/**< validated by the checksum word */
+	uint32_t reread;			/**< validated by a second read */
+	uint32_t errors;			/**< words that differed between reads */
+	uint32_t retries;			/**< slow re-reads (words or probes) */
+	uint32_t failed;			/**< words without two equal reads */
+} MM_VERIFY_CNT;
+
+uint16_t mm_verify_crc( const uint16_t *words );
+int mm_verify_read( uintptr_t base, uint32_t need, uint32_t slowNs,
+					uint16_t *words, int *probe, MM_VERIFY_CNT *cnt );
+int mm_verify_modinfo( uintptr_t base, uint32_t slowNs, uint16_t *words,
+					   int *probe, uint32_t *modtype, uint32_t *devid,
+					   uint32_t *devrev, char *devname, MM_VERIFY_CNT *cnt );
+
+#endif /* _MM_VERIFY_H */
@@ -0,0 +1,352 @@
+/*********************  P r o g r a m  -  M o d u l e **********************/
+/*!
+ *         \file mm_xfer.c
+ *      Project: native linux M-Module ident tool
+ *
+ *       \author awe
+ *
+ *        \brief Non-blocking EEPROM transactions as state machines.
+ *
+ *               Programming works word by word like m_program() without
+ *               ERAL/WRAL: a word is erased (unless it is erased already
+ *               or MM_PROG_AUTOERASE is set) and written if it differs,
+ *               then everything is verified with one sequential read.
+ *               While a cycle runs, the EEPROM stays selected and its
+ *               ready/busy status is polled every pollNs.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "mm_eeprom.h"
+#include "mm_timing.h"
+#include "mm_lock.h"
+#include "mm_xfer.h"
+
+/* states */
+#define X_LOCK		0		/* wait for the slot lock */
+#define X_READ		1		/* sequential read, then 'next' */
+#define X_PLAN		2		/* program: current words known */
+#define X_NEXT		3		/* program: start next cycle or finish */
+#define X_WAIT		4		/* program: erase/write cycle running */
+#define X_CHECK		5		/* program: verify words read */
+#define X_DONE		6
+
+/******************************* _xfer_init ********************************/
+/**   Common part of starting a transaction.
+ ****************************************************************************/
+static void _xfer_init( MM_XFER *x, uintptr_t base, uint8_t first,
+						uint8_t count )
+{
+	memset( x, 0, sizeof(*x) );
+	x->pollNs = MM_XFER_POLL_NS;
+	x->base   = base;
+	x->first  = first;
+	x->count  = count;
+	x->state  = X_LOCK;
+	x->t0     = mm_time_ns();
+	x->rep.nwords  = count;
+	x->rep.badWord = -1;
+}
+
+/******************************* mm_xfer_set_timing ************************/
+/**   Set the bit timing and poll interval of a started transaction.
+ *---------------------------------------------------------------------------
+ *  \param x			\IN transaction
+ *  \param tm			\IN timing of the slot (NULL=of the stepping thread),
+ *						    must stay valid
+ *  \param pollNs		\IN ready/busy poll interval (0=MM_XFER_POLL_NS)
+ ****************************************************************************/
+void mm_xfer_set_timing( MM_XFER *x, const MM_TIMING *tm, uint32_t pollNs )
+{
+	x->timing = tm;
+	x->pollNs = pollNs ? pollNs : MM_XFER_POLL_NS;
+}
+
+/******************************* mm_xfer_read ******************************/
+/**   Start reading consecutive words.
+ *---------------------------------------------------------------------------
+ *  \param x			\OUT transaction
+ *  \param base			\IN base address pointer
+ *  \param first		\IN index of first word
+ *  \param count		\IN number of words (first+count <= MM_EE_WORDS)
+ *  \param buf			\OUT words, valid when done without error
+ ****************************************************************************/
+void mm_xfer_read( MM_XFER *x, uintptr_t base, uint8_t first, uint8_t count,
+				   uint16_t *buf )
+{
+	_xfer_init( x, base, first, count );
+	x->rdBuf = buf;
+	x->next  = X_DONE;
+	if( count == 0 || first + count > MM_EE_WORDS ){
+		x->err   = MM_PROG_PARAM;
+		x->state = X_DONE;
+		x->done  = 1;
+	}
+}
+
+/******************************* mm_xfer_program ***************************/
+/**   Start programming consecutive words.
+ *---------------------------------------------------------------------------
+ *  \param x			\OUT transaction
+ *  \param base			\IN base address pointer
+ *  \param first		\IN index of first word
+ *  \param image		\IN words to program (copied)
+ *  \param nwords		\IN number of words (first+nwords <= MM_EE_WORDS)
+ *  \param flags		\IN MM_PROG_AUTOERASE
+ ****************************************************************************/
+void mm_xfer_program( MM_XFER *x, uintptr_t base, uint8_t first,
+					  const uint16_t *image, int nwords, uint32_t flags )
+{
+	_xfer_init( x, base, first, (uint8_t)nwords );
+	if( nwords < 1 || first + nwords > MM_EE_WORDS ){
+		x->err   = MM_PROG_PARAM;
+		x->state = X_DONE;
+		x->done  = 1;
+		return;
+	}
+	memcpy( x->img, image, nwords * sizeof(uint16_t) );
+	x->flags = flags;
+	x->rdBuf = x->cur;
+	x->next  = X_PLAN;
+}
+
+/******************************* _xfer_finish ******************************/
+/**   End a transaction and release the slot.
+ ****************************************************************************/
+static void _xfer_finish( MM_XFER *x, int err )
+{
+	if( x->state != X_LOCK )
+		mm_lock_give_tx( x->base );
+	x->err   = err;
+	x->state = X_DONE;
+	x->done  = 1;
+	x->deadline = 0;
+	x->rep.totalNs = mm_time_ns() - x->t0;
+}
+
+/******************************* _xfer_cycle *******************************/
+/**   Start an erase/write cycle of the current word.
+ ****************************************************************************/
+static void _xfer_cycle( MM_XFER *x )
+{
+	uint8_t  i   = (uint8_t)(x->first + x->pos);
+	uint16_t dst = x->img[x->pos];
+
+	if( dst == 0xffff ||
+		(x->cur[x->pos] != 0xffff && !(x->flags & MM_PROG_AUTOERASE)) ){
+		m_instr( x->base, (uint8_t)(ERASE + i) );
+		x->cur[x->pos] = 0xffff;
+		x->rep.erase++;
+	}
+	else {
+		m_instr( x->base, (uint8_t)(_WRITE_ + i) );
+		m_data_out( x->base, dst );
+		x->cur[x->pos] = dst;
+		x->rep.write++;
+	}
+	m_deselect( x->base );					/* starts the cycle */
+
+	x->cycleT0  = mm_time_ns();
+	x->busySeen = !m_status( x->base, 1 );
+	x->state    = X_WAIT;
+}
+
+/******************************* _xfer_run *********************************/
+/**   Advance the state machine, see mm_xfer_step().
+ ****************************************************************************/
+static int _xfer_run( MM_XFER *x )
+{
+	uint64_t now;
+	int i;
+
+	switch( x->state ){
+	case X_LOCK:
+		now = mm_time_ns();
+		if( mm_lock_try_tx( x->base ) ){
+			if( now - x->t0 > (uint64_t)mm_lock_timeout_ms() * 1000000 ){
+				_xfer_finish( x, MM_PROG_BUSY );
+				return 0;
+			}
+			x->deadline = now + MM_XFER_LOCK_NS;
+			return 1;
+		}
+		x->state = X_READ;
+		/* fall through */
+
+	case X_READ:
+		/* one word per step, so other slots get their turn */
+		if( x->pos == 0 )
+			m_instr( x->base, (uint8_t)(_READ_ + x->first) );
+		x->rdBuf[x->pos++] = m_data_in( x->base );
+		if( x->pos < x->count ){
+			x->deadline = 0;
+			return 1;
+		}
+		m_deselect( x->base );
+		x->pos   = 0;
+		x->state = x->next;
+		if( x->state == X_DONE ){
+			_xfer_finish( x, MM_PROG_OK );
+			return 0;
+		}
+		return _xfer_run( x );
+
+	case X_PLAN:
+		for( i=0; i<x->count; i++ )
+			if( x->cur[i] != x->img[i] )
+				x->rep.changed++;
+		if( x->rep.changed == 0 ){
+			_xfer_finish( x, MM_PROG_OK );
+			return 0;
+		}
+		m_instr( x->base, EWEN );			/* write enable */
+		m_deselect( x->base );
+		x->state = X_NEXT;
+		/* fall through */
+
+	case X_NEXT:
+		while( x->pos < x->count && x->cur[x->pos] == x->img[x->pos] )
+			x->pos++;
+		if( x->pos < x->count ){
+			_xfer_cycle( x );
+			x->deadline = mm_time_ns() + x->pollNs;
+			return 1;
+		}
+		m_instr( x->base, EWDS );			/* write disable */
+		m_deselect( x->base );
+		x->pos   = 0;
+		x->state = X_READ;
+		x->next  = X_CHECK;
+		x->deadline = 0;
+		return 1;
+
+	case X_WAIT:
+		now = mm_time_ns();
+		if( m_status( x->base, 0 ) ){
+			if( x->busySeen ){
+				m_deselect( x->base );		/* ready */
+				x->rep.waitNs += now - x->cycleT0;
+				x->state = X_NEXT;
+				return _xfer_run( x );
+			}
+		}
+		else
+			x->busySeen = 1;
+
+		if( now - x->cycleT0 > MM_XFER_CYCLE_NS ){
+			m_deselect( x->base );
+			m_instr( x->base, EWDS );
+			m_deselect( x->base );
+			_xfer_finish( x, MM_PROG_TIMEOUT );
+			return 0;
+		}
+		x->deadline = now + x->pollNs;
+		return 1;
+
+	case X_CHECK:
+		for( i=0; i<x->count; i++ ){
+			if( x->cur[i] != x->img[i] ){
+				x->rep.badWord = x->first + i;
+				_xfer_finish( x, MM_PROG_VERIFY );
+				return 0;
+			}
+		}
+		_xfer_finish( x, MM_PROG_OK );
+		return 0;
+	}
+	return 0;
+}
+
+/******************************* mm_xfer_step ******************************/
+/**   Advance a transaction until it has to wait.
+ *
+ *    Transfers at most one word plus a few short instructions. Calling it
+ *    before MM_XFER.deadline is allowed, it just polls earlier.
+ *---------------------------------------------------------------------------
+ *  \param x			\IN transaction
+ *  \return 1=call again at x->deadline, 0=done (x->err)
+ ****************************************************************************/
+int mm_xfer_step( MM_XFER *x )
+{
+	const MM_TIMING *saved = mm_timing_get();
+	int ret;
+
+	if( x->done )
+		return 0;
+	if( x->timing )
+		mm_timing_set( x->timing );
+	ret = _xfer_run( x );
+	if( x->timing )
+		mm_timing_set( saved );
+	return ret;
+}
+
+/******************************* mm_xfer_next ******************************/
+/**   Earliest deadline of unfinished transactions.
+ *---------------------------------------------------------------------------
+ *  \param x			\IN transactions
+ *  \param n			\IN number of transactions
+ *  \return deadline (0=one is due now), UINT64_MAX if all are done
+ ****************************************************************************/
+uint64_t mm_xfer_next( MM_XFER *const *x, int n )
+{
+	uint64_t next = UINT64_MAX;
+	int i;
+
+	for( i=0; i<n; i++ )
+		if( !x[i]->done && x[i]->deadline < next )
+			next = x[i]->deadline;
+	return next;
+}
+
+/******************************* mm_xfer_run *******************************/
+/**   Run transactions to their end from the calling thread.
+ *
+ *    Sleeps while all of them wait.
+ *---------------------------------------------------------------------------
+ *  \param x			\IN started transactions
+ *  \param n			\IN number of transactions
+ *  \return number of transactions that failed
+ ****************************************************************************/
+int mm_xfer_run( MM_XFER *const *x, int n )
+{
+	struct timespec ts;
+	uint64_t next, now;
+	int i, failed = 0;
+
+	while( (next = mm_xfer_next( x, n )) != UINT64_MAX ){
+		now = mm_time_ns();
+		if( next > now ){
+			ts.tv_sec  = (time_t)(next / 1000000000ULL);
+			ts.tv_nsec = (long)(next % 1000000000ULL);
+			clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL );
+			now = mm_time_ns();
+		}
+		for( i=0; i<n; i++ )
+			if( !x[i]->done && x[i]->deadline <= now )
+				mm_xfer_step( x[i] );
+	}
+
+	for( i=0; i<n; i++ )
+		if( x[i]->err )
+			failed++;
+	return failed;
+}
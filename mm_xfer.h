@@ -0,0 +1,98 @@
+/***********************  I n c l u d e  -  F i l e  ************************/
+/*!
+ *        \file  mm_xfer.h
+ *
+ *      \author  awe
+ *
+ *       \brief  Non-blocking EEPROM transactions.
+ *
+ *               A transaction (read words, program words) is a state
+ *               machine that mm_xfer_step() advances until it has to wait:
+ *               for the self timed erase/write cycle of the EEPROM or for
+ *               a slot locked by another process. It then returns with
+ *               the time of the next step in MM_XFER.deadline, so an
+ *               event loop can drive many slots from one thread and sleep
+ *               (e.g. timerfd with TFD_TIMER_ABSTIME on CLOCK_MONOTONIC)
+ *               instead of polling the busy EEPROMs:
+ *
+ *               mm_xfer_program( &x[i], base[i], 0, image, n, 0 );
+ *               ...
+ *               while( not all done ){
+ *                   sleep until mm_xfer_next( x, nslots )
+ *                   call mm_xfer_step() for every x[i] that is due
+ *               }
+ *
+ *               or just mm_xfer_run( x, nslots ). Bit transfers are not
+ *               split: a step transfers at most one word plus a few short
+ *               instructions and never waits for a cycle.
+ *               All steps of a transaction must run in the same thread
+ *               (it holds the slot lock, see mm_lock_try_tx()). There is
+ *               no limit on the number of transactions a thread runs at
+ *               a time, but it must not access a slot otherwise while
+ *               a transaction on it is running.
+ *
+ *---------------------------------------------------------------------------
+ * Copyright 2014-2020, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+
+ /*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MM_XFER_H
+#define _MM_XFER_H
+
+#include <stdint.h>
+#include "mm_eeprom.h"
+#include "mm_timing.h"
+
+#define MM_XFER_POLL_NS		250000		/* ready/busy poll interval */
+#define MM_XFER_CYCLE_NS	10000000	/* max. erase/write cycle time */
+#define MM_XFER_LOCK_NS		1000000		/* retry interval for a busy slot */
+
+/** transaction, the fields up to rep are read-only for the caller */
+typedef struct MM_XFER {
+	int       done;				/**< finished, err is valid */
+	int       err;				/**< MM_PROG_OK or MM_PROG_xxx */
+	uint64_t  deadline;			/**< mm_time_ns() of next step, 0=now */
+	MM_PROG_REPORT rep;			/**< program: counters, badWord */
+
+	/* private */
+	uintptr_t base;
+	const MM_TIMING *timing;	/* NULL=timing of the stepping thread */
+	uint32_t  pollNs;
+	uint32_t  flags;
+	int       state;
+	int       next;				/* state after a read */
+	int       busySeen;			/* cycle: DO went low */
+	uint8_t   first;			/* first word */
+	uint8_t   count;			/* number of words */
+	uint8_t   pos;				/* current word */
+	uint16_t *rdBuf;			/* read destination */
+	uint16_t  img[MM_EE_WORDS];	/* program: target words */
+	uint16_t  cur[MM_EE_WORDS];	/* program: current words */
+	uint64_t  t0;				/* start of transaction */
+	uint64_t  cycleT0;			/* start of erase/write cycle */
+} MM_XFER;
+
+void mm_xfer_read( MM_XFER *x, uintptr_t base, uint8_t first, uint8_t count,
+				   uint16_t *buf );
+void mm_xfer_program( MM_XFER *x, uintptr_t base, uint8_t first,
+					  const uint16_t *image, int nwords, uint32_t flags );
+void mm_xfer_set_timing( MM_XFER *x, const MM_TIMING *tm, uint32_t pollNs );
+int mm_xfer_step( MM_XFER *x );
+uint64_t mm_xfer_next( MM_XFER *const *x, int n );
+int mm_xfer_run( MM_XFER *const *x, int n );
+
+#endif /* _MM_XFER_H */
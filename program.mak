@@ -25,6 +25,61 @@ STAMPED_REVISION="7f98380_2019-06-07"
 DEF_REVISION=MAK_REVISION=$(STAMPED_REVISION)
 MAK_SWITCH=$(SW_PREFIX)$(DEF_REVISION)
 
+MAK_INCL=$(MEN_MOD_DIR)/mm_eeprom.h \
+         $(MEN_MOD_DIR)/mm_sim.h \
+         $(MEN_MOD_DIR)/mm_scan.h \
+         $(MEN_MOD_DIR)/mm_pci.h \
+         $(MEN_MOD_DIR)/mm_timing.h \
+         $(MEN_MOD_DIR)/mm_cache.h \
+         $(MEN_MOD_DIR)/mm_stats.h \
+         $(MEN_MOD_DIR)/mm_ctx.h \
+         $(MEN_MOD_DIR)/mm_daemon.h \
+         $(MEN_MOD_DIR)/mm_trace.h \
+         $(MEN_MOD_DIR)/mm_prod.h \
+         $(MEN_MOD_DIR)/mm_rt.h \
+         $(MEN_MOD_DIR)/mm_query.h \
+         $(MEN_MOD_DIR)/mm_lock.h \
+         $(MEN_MOD_DIR)/mm_xfer.h \
+         $(MEN_MOD_DIR)/mm_inv.h \
+         $(MEN_MOD_DIR)/mm_verify.h \
+         $(MEN_MOD_DIR)/mm_batch.h
+
 MAK_INP1=mm_ident$(INP_SUFFIX)
+MAK_INP2=mm_sim$(INP_SUFFIX)
+MAK_INP3=mm_scan$(INP_SUFFIX)
+MAK_INP4=mm_pci$(INP_SUFFIX)
+MAK_INP5=mm_timing$(INP_SUFFIX)
+MAK_INP6=mm_cache$(INP_SUFFIX)
+MAK_INP7=mm_stats$(INP_SUFFIX)
+MAK_INP8=mm_eeprom$(INP_SUFFIX)
+MAK_INP9=mm_ctx$(INP_SUFFIX)
+MAK_INP10=mm_daemon$(INP_SUFFIX)
+MAK_INP11=mm_trace$(INP_SUFFIX)
+MAK_INP12=mm_prod$(INP_SUFFIX)
+MAK_INP13=mm_rt$(INP_SUFFIX)
+MAK_INP14=mm_query$(INP_SUFFIX)
+MAK_INP15=mm_lock$(INP_SUFFIX)
+MAK_INP16=mm_xfer$(INP_SUFFIX)
+MAK_INP17=mm_inv$(INP_SUFFIX)
+MAK_INP18=mm_verify$(INP_SUFFIX)
+MAK_INP19=mm_batch$(INP_SUFFIX)
 
-MAK_INP=$(MAK_INP1)
+MAK_INP=$(MAK_INP1) \
+        $(MAK_INP2) \
+        $(MAK_INP3) \
+        $(MAK_INP4) \
+        $(MAK_INP5) \
+        $(MAK_INP6) \
+        $(MAK_INP7) \
+        $(MAK_INP8) \
+        $(MAK_INP9) \
+        $(MAK_INP10) \
+        $(MAK_INP11) \
+        $(MAK_INP12) \
+        $(MAK_INP13) \
+        $(MAK_INP14) \
+        $(MAK_INP15) \
+        $(MAK_INP16) \
+        $(MAK_INP17) \
+        $(MAK_INP18) \
+        $(MAK_INP19)